@@ -1,25 +1,80 @@
 #ifndef DATABASEMANAGER_H
 #define DATABASEMANAGER_H
 
+#include <QMutex>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QString>
+#include <QThreadStorage>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
 
+// How every connection to the (read-only) USDA database is opened
+struct ConnectionProfile {
+  // Opens through an immutable=1 URI: SQLite skips locking and change
+  // detection, so the file must not be modified while the app runs
+  bool immutable = true;
+  qint64 mmapSize = qint64(256) << 20; // PRAGMA mmap_size, bytes
+  int cacheSizeKiB = 64 * 1024;        // PRAGMA cache_size (as -KiB)
+  bool tempStoreMemory = true;         // PRAGMA temp_store = MEMORY
+  bool queryOnly = true;               // PRAGMA query_only
+};
+
+// Hands out one connection per thread, since a QSqlDatabase may only be used
+// by the thread that opened it. The connecting thread's connection is opened
+// by connect(); any other thread's on its first call, and closed when that
+// thread finishes.
 class DatabaseManager {
 public:
   static DatabaseManager &instance();
-  bool connect(const QString &path);
+  bool connect(const QString &path,
+               const ConnectionProfile &profile = ConnectionProfile());
   [[nodiscard]] bool isOpen() const;
+  // File passed to connect()
+  [[nodiscard]] QString path() const;
+  // The calling thread's connection
   [[nodiscard]] QSqlDatabase database() const;
 
+  // The settings in effect on the calling thread's connection, as reported
+  // by SQLite (e.g. mmap_size is 0 if the build does not support it)
+  [[nodiscard]] QString settingsReport() const;
+  // Connections currently open across all threads
+  [[nodiscard]] int connectionCount() const;
+
+  // Prepared statements are cached by SQL text, so each is parsed once. The
+  // returned query is reset and ready to bind; null (after logging) if it
+  // fails to prepare. Each thread has its own cache.
+  QSqlQuery *cachedQuery(const QString &sql);
+
+  // Runs sql, which must contain one "IN (%1)", over all of ids. The ids are
+  // bound in fixed-size batches of placeholders, so the statement is
+  // prepared once whatever ids are passed. onRow sees every result row.
+  bool forEachRowIn(const QString &sql, const std::vector<int> &ids,
+                    const std::function<void(const QSqlQuery &)> &onRow);
+
   DatabaseManager(const DatabaseManager &) = delete;
   DatabaseManager &operator=(const DatabaseManager &) = delete;
 
 private:
+  struct ThreadConnection;
+
   DatabaseManager();
   ~DatabaseManager();
 
-  QSqlDatabase m_db;
+  // The calling thread's connection, opened on first use and reopened while
+  // opening fails
+  ThreadConnection *localConnection() const;
+  QSqlQuery *cachedStatement(const QString &key,
+                             const std::function<QString()> &sql);
+
+  mutable QMutex m_mutex; // Guards m_path and m_profile
+  QString m_path;
+  ConnectionProfile m_profile;
+  std::atomic<bool> m_open{false};
+  mutable std::atomic<int> m_connectionCount{0};
+  mutable QThreadStorage<ThreadConnection *> m_connections;
 };
 
 #endif // DATABASEMANAGER_H
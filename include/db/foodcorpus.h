@@ -0,0 +1,58 @@
+#ifndef FOODCORPUS_H
+#define FOODCORPUS_H
+
+#include "utils/packed_array.h"
+#include "utils/string_utils.h"
+#include <QByteArray>
+#include <QString>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Compact, read-mostly store of every food's basic info for searching.
+// Laid out as parallel arrays; descriptions (as shown and lowercased) and
+// their token spans live in shared arenas instead of one QString per food.
+// The lowercased arena is mirrored in 8 bits for the ASCII search kernels.
+// Can also be read in place from a mapped snapshot file.
+class FoodCorpus {
+public:
+  void clear();
+  void append(int id, const QString &description, int foodGroupId);
+  // Release spare capacity once loading is done
+  void squeeze();
+
+  void writeTo(SnapshotWriter &writer) const;
+  // Borrows the reader's memory instead of copying it
+  bool readFrom(SnapshotReader &reader);
+
+  [[nodiscard]] int size() const { return static_cast<int>(m_ids.size()); }
+  [[nodiscard]] bool isEmpty() const { return m_ids.empty(); }
+
+  [[nodiscard]] int id(int index) const { return m_ids[index]; }
+  // Index of the food with this id, or -1. Foods must be appended in
+  // ascending id order.
+  [[nodiscard]] int indexOf(int id) const;
+  [[nodiscard]] int foodGroupId(int index) const {
+    return m_foodGroupIds[index];
+  }
+  [[nodiscard]] QString description(int index) const;
+
+  // Lowercased description and tokens, pointing into the arenas
+  [[nodiscard]] Utils::FoldedTextView folded(int index) const;
+
+private:
+  Utils::PackedArray<int> m_ids;
+  Utils::PackedArray<int> m_foodGroupIds;
+
+  // Offsets are per food, with one trailing entry marking the end
+  QString m_descriptions;
+  Utils::PackedArray<int> m_descriptionOffsets{0};
+  QString m_folded;
+  Utils::PackedArray<int> m_foldedOffsets{0};
+  QByteArray m_foldedAscii; // m_folded narrowed to 8 bits, same offsets
+  Utils::PackedArray<Utils::TokenSpan> m_tokens;
+  Utils::PackedArray<int> m_tokenOffsets{0};
+  std::vector<Utils::TokenSpan> m_scratchTokens; // Only used by append
+};
+
+#endif // FOODCORPUS_H
@@ -0,0 +1,23 @@
+#ifndef FOODGROUPS_H
+#define FOODGROUPS_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QString>
+
+// Every row of fdgrp, loaded once: the names behind food_des.fdgrp_id
+class FoodGroups {
+public:
+  // Returns false (and leaves the table empty) if the query fails
+  bool load(const QSqlDatabase &db);
+
+  [[nodiscard]] bool isEmpty() const { return m_names.isEmpty(); }
+
+  // Falls back to "Group <id>" for ids without a row
+  [[nodiscard]] QString name(int groupId) const;
+
+private:
+  QHash<int, QString> m_names;
+};
+
+#endif // FOODGROUPS_H
@@ -1,16 +1,79 @@
 #ifndef FOODREPOSITORY_H
 #define FOODREPOSITORY_H
 
+#include "db/foodgroups.h"
+#include "db/foodsnapshot.h"
+#include "db/nutrientranking.h"
+#include "db/nutrientsimilarity.h"
+#include "db/searchbackend.h"
+#include "db/searchcache.h"
+#include <QMutex>
 #include <QString>
 #include <QVariantMap>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
 #include <vector>
 
+// One nutrient value of a food. Name, unit and USDA id are looked up through
+// FoodRepository::nutrientDefinitions().
 struct Nutrient {
-  int id;
-  QString description;
-  double amount;
-  QString unit;
-  double rdaPercentage; // Calculated
+  quint16 index; // Into NutrientDefinitions
+  double amount; // Per 100 g
+};
+
+// The nutrients of one food, as returned by
+// FoodRepository::getFoodNutrients. Reads the snapshot's nutrient store in
+// place and keeps that snapshot alive, so lookups copy nothing; only lazy
+// mode owns the values it queried. Copies share the same arrays.
+class FoodNutrients {
+public:
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Nutrient;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Nutrient;
+
+    Iterator(const FoodNutrients *nutrients, int i)
+        : m_nutrients(nutrients), m_i(i) {}
+
+    Nutrient operator*() const { return (*m_nutrients)[m_i]; }
+    Iterator &operator++() {
+      ++m_i;
+      return *this;
+    }
+    Iterator operator++(int) { return {m_nutrients, m_i++}; }
+    bool operator==(const Iterator &other) const { return m_i == other.m_i; }
+    bool operator!=(const Iterator &other) const { return m_i != other.m_i; }
+
+  private:
+    const FoodNutrients *m_nutrients;
+    int m_i;
+  };
+
+  FoodNutrients() = default;
+  // row points into memory that owner keeps alive
+  FoodNutrients(std::shared_ptr<const void> owner, NutrientRow row)
+      : m_owner(std::move(owner)), m_row(row) {}
+
+  [[nodiscard]] int size() const { return m_row.count; }
+  [[nodiscard]] bool empty() const { return m_row.isEmpty(); }
+  Nutrient operator[](int i) const {
+    return {m_row.indices[i], m_row.amounts[i]};
+  }
+  [[nodiscard]] Iterator begin() const { return {this, 0}; }
+  [[nodiscard]] Iterator end() const { return {this, m_row.count}; }
+  // The underlying arrays, valid for as long as this view
+  [[nodiscard]] const NutrientRow &row() const { return m_row; }
+
+private:
+  std::shared_ptr<const void> m_owner;
+  NutrientRow m_row;
 };
 
 struct FoodItem {
@@ -24,27 +87,176 @@ struct FoodItem {
   std::vector<Nutrient> nutrients; // Full details for results
 };
 
+// Hooks for a search running on another thread
+struct SearchControl {
+  // Polled between blocks of candidates; returning true abandons the search
+  std::function<bool()> isCancelled;
+  // Now and then receives the best matches found so far, while the full
+  // ranking is still running
+  std::function<void(const std::vector<FoodItem> &)> onPartialResults;
+  // Threads to score with, overriding setSearchThreadCount when > 0 (e.g.
+  // 1 when many searches already run side by side)
+  int threadCount = 0;
+};
+
+// Narrows a search to one food group and reports how matches spread
+// across groups
+struct SearchScope {
+  // Foods of other groups are dropped before scoring; -1 for every group
+  int foodGroupId = -1;
+  // If set, receives the match count of each group with any matches. Within
+  // a group filter, only that group is counted.
+  std::vector<SearchFacet> *facets = nullptr;
+};
+
+// Milliseconds spent in each phase of a cache load; -1 for phases that did
+// not run (a mapped snapshot skips everything but the mapping)
+struct LoadTimings {
+  qint64 snapshotMapMs = -1;
+  qint64 nutrientLoadMs = -1;
+  qint64 foodLoadMs = -1;
+  qint64 indexBuildMs = -1;
+  qint64 snapshotSaveMs = -1;
+
+  [[nodiscard]] QString summary() const;
+};
+
+// Called as each loading step starts, and once more with step == stepCount
+using LoadProgress =
+    std::function<void(int step, int stepCount, const QString &label)>;
+
+// Searching is safe from any thread once the cache is loaded: readers work
+// on an immutable FoodSnapshot and never take a lock.
 class FoodRepository {
 public:
+  // The process-wide repository shared by every widget
+  static FoodRepository &instance();
+
+  // Separate instances (own settings and result cache) are only meant for
+  // tests and tools
   explicit FoodRepository();
 
-  // Search foods by keyword
-  std::vector<FoodItem> searchFoods(const QString &query);
+  FoodRepository(const FoodRepository &) = delete;
+  FoodRepository &operator=(const FoodRepository &) = delete;
+
+  // Load the search cache now rather than on the first search. Works from
+  // any thread; a caller arriving while another thread loads waits for it
+  // instead of loading again. progress only hears from the loading thread.
+  void ensureCacheLoaded(const LoadProgress &progress = LoadProgress());
+  // Phases of the most recent load
+  [[nodiscard]] LoadTimings loadTimings();
+
+  // Currently published data, or null before the first load
+  [[nodiscard]] std::shared_ptr<const FoodSnapshot> snapshot() const;
+
+  // Search foods by keyword. With a session, a query that extends the
+  // previous one is refined from the previous pass instead of a full scan.
+  std::vector<FoodItem> searchFoods(const QString &query,
+                                    SearchSession *session = nullptr,
+                                    const SearchScope *scope = nullptr);
+
+  // The ranking part of searchFoods, without nutrient details. Touches no
+  // database once the cache is loaded (beyond what the search backend
+  // needs), so it can run on a worker thread. Returns nothing if the search
+  // was cancelled.
+  std::vector<FoodItem> rankFoods(const QString &query,
+                                  SearchSession *session = nullptr,
+                                  const SearchControl *control = nullptr,
+                                  const SearchScope *scope = nullptr);
+
+  // How searches are ranked; the in-memory fuzzy scorer by default.
+  // Can be switched at any time, which also drops cached rankings.
+  void setSearchBackend(std::shared_ptr<SearchBackend> backend);
+  [[nodiscard]] std::shared_ptr<SearchBackend> searchBackend() const;
+
+  // Threads used to score search candidates: 0 (default) uses every core,
+  // 1 keeps scoring on the calling thread. Results are identical either way.
+  void setSearchThreadCount(int count);
 
-  // Get detailed nutrients for a generic food (100g)
-  // Returns a list of nutrients
-  std::vector<Nutrient> getFoodNutrients(int foodId);
+  // Rankings of recent queries are kept in an LRU cache; 0 disables it.
+  // resultCache() exposes its hit/miss counters.
+  void setResultCacheCapacity(int capacity);
+  [[nodiscard]] const SearchCache &resultCache() const;
+
+  // Nutrient data is normally loaded into memory with the search cache.
+  // Lazy mode (for memory-constrained installs) skips that and queries the
+  // database per lookup instead. Takes effect on the next load.
+  void setLazyNutrients(bool lazy);
+  [[nodiscard]] bool lazyNutrients() const;
+
+  // Where to keep a binary snapshot of the search cache between launches.
+  // A matching snapshot is mapped and used in place instead of reading the
+  // database; a missing or stale one is rebuilt after loading. Empty (the
+  // default) disables it. Takes effect on the next load.
+  void setSnapshotPath(const QString &path);
+
+  // Names and units of the nutrients referenced by Nutrient::index. Loaded
+  // once on first use and never replaced, so the reference stays valid.
+  // Empty if the database could not be read.
+  const NutrientDefinitions &nutrientDefinitions();
+  // Names of the food groups in FoodItem::foodGroupId, loaded the same way.
+  // Empty (but still naming every group by id) if they could not be read.
+  const FoodGroups &foodGroups();
+
+  // Ids (ascending) of the foods that report every one of these USDA
+  // nutrient ids, e.g. {430, 421} for vitamin K and choline. Answered from
+  // the presence bits, without touching the database once loaded.
+  std::vector<int> foodsReporting(const std::vector<int> &nutrientIds);
+
+  // The foods richest in one nutrient, best first. Each nutrient's column
+  // is built on first use (from memory, or one query in lazy mode) and kept
+  // until the snapshot changes, so later rankings take milliseconds.
+  std::vector<RankedFood>
+  topFoodsByNutrient(const NutrientRankingQuery &query);
+
+  // Foods whose nutrient profile is closest to query.foodId's, closest
+  // first. The profiles for each basis are built on first use (with an IVF
+  // index once branded foods make the corpus large, which takes seconds,
+  // so call this off the GUI thread) and kept until the snapshot changes;
+  // queries then take milliseconds.
+  std::vector<SimilarFood> similarFoods(const SimilarityQuery &query);
+
+  // Get detailed nutrients for a generic food (100g). A view of the
+  // snapshot's store, without copying, unless nutrients are loaded lazily.
+  FoodNutrients getFoodNutrients(int foodId);
 
   // Helper to get nutrient definition basics if needed
   // QString getNutrientName(int nutrientId);
 
 private:
-  // Internal helper methods
-  void ensureCacheLoaded();
+  std::shared_ptr<const FoodSnapshot>
+  loadSnapshot(const LoadProgress &progress);
+  // Requires m_loadMutex
+  const NutrientDefinitions &loadDefinitions();
+  // Forgets columns and profiles of an older snapshot. Requires
+  // m_columnMutex.
+  void dropStaleColumns(const FoodSnapshot &snap);
+  // Null for definitions outside the table
+  std::shared_ptr<const NutrientColumn> nutrientColumn(const FoodSnapshot &snap,
+                                                       int definition);
+  // Null if the nutrient data could not be read. Takes m_columnMutex only
+  // to look up and store, not while building.
+  std::shared_ptr<const NutrientProfiles>
+  nutrientProfiles(const FoodSnapshot &snap, NutrientBasis basis);
+
+  // Only taken by writers; readers go through std::atomic_load
+  QMutex m_loadMutex;
+  std::shared_ptr<const FoodSnapshot> m_snapshot;
+  std::shared_ptr<const NutrientDefinitions> m_definitions;
+  std::shared_ptr<const FoodGroups> m_foodGroups;
+  std::shared_ptr<SearchBackend> m_backend; // Accessed atomically
+  std::atomic<int> m_searchThreadCount{0};
+  std::atomic<bool> m_lazyNutrients{false};
+  QString m_snapshotPath;     // Guarded by m_loadMutex
+  LoadTimings m_loadTimings; // Guarded by m_loadMutex
+  SearchCache m_resultCache;
 
-  bool m_cacheLoaded = false;
-  // Cache stores basic food info
-  std::vector<FoodItem> m_cache;
+  QMutex m_columnMutex;
+  quint64 m_columnGeneration = 0; // Guarded by m_columnMutex
+  // By definition index, for m_columnGeneration. Guarded by m_columnMutex.
+  std::map<int, std::shared_ptr<const NutrientColumn>> m_columns;
+  // By basis, likewise
+  std::map<NutrientBasis, std::shared_ptr<const NutrientProfiles>> m_profiles;
 };
 
 #endif // FOODREPOSITORY_H
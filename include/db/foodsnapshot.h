@@ -0,0 +1,80 @@
+#ifndef FOODSNAPSHOT_H
+#define FOODSNAPSHOT_H
+
+#include "db/foodcorpus.h"
+#include "db/nutrientpresence.h"
+#include "db/nutrientstore.h"
+#include "utils/packed_array.h"
+#include "utils/string_utils.h"
+#include <QByteArray>
+#include <QString>
+#include <memory>
+#include <vector>
+
+// Identifies the database a snapshot file was built from
+struct SnapshotKey {
+  quint64 fileSize = 0;
+  qint64 modifiedMs = 0;
+  // SHA-1 of the first and last 64 KiB rather than the whole file. The
+  // first block holds the SQLite header, whose change counter moves on
+  // every write.
+  QByteArray hash;
+  int definitionCount = 0;
+
+  // Empty hash if the file cannot be read
+  static SnapshotKey forDatabase(const QString &path, int definitionCount);
+  bool operator==(const SnapshotKey &other) const;
+};
+
+// Everything loaded from the database for searching. Built once, then only
+// read: FoodRepository publishes it through an atomically swapped pointer so
+// any number of threads can use it without locking.
+struct FoodSnapshot {
+  // Distinguishes snapshots, so per-snapshot state (corpus indices kept by
+  // sessions and caches) can tell when it has gone stale
+  quint64 generation = 0;
+  FoodCorpus corpus;
+  // Empty when nutrients are loaded lazily
+  NutrientStore nutrients;
+  // Which nutrients each food reports, by corpus index. Always loaded.
+  NutrientPresence presence;
+  // Trigram index in CSR form: sorted keys, and for each key a slice of
+  // ascending corpus indices
+  Utils::PackedArray<quint64> trigramKeys;
+  Utils::PackedArray<int> trigramOffsets{0};
+  Utils::PackedArray<int> trigramPostings;
+  // Food group index in the same form: sorted group ids, and for each the
+  // ascending corpus indices of its foods
+  Utils::PackedArray<int> groupIds;
+  Utils::PackedArray<int> groupOffsets{0};
+  Utils::PackedArray<int> groupPostings;
+  // Set when the arrays above borrow a mapped snapshot file
+  std::shared_ptr<void> mapping;
+
+  // Builds the trigram and food group indices
+  void buildSearchIndex();
+  // Fills candidates with the ascending indices into corpus of every food
+  // that can score above threshold, i.e. that shares at least
+  // Utils::minSharedTrigrams trigrams with the query. Returns false (every
+  // food is a candidate) when no such bound exists, as at the result
+  // threshold of 40.
+  bool collectCandidates(const Utils::FuzzyQuery &query, int threshold,
+                         std::vector<int> &candidates) const;
+
+  // Position of a group in groupIds, or -1 if no food belongs to it
+  [[nodiscard]] int groupSlot(int foodGroupId) const;
+  // Ascending corpus indices of the group's foods
+  [[nodiscard]] std::vector<int> groupMembers(int foodGroupId) const;
+
+  // Snapshot files hold everything above in a versioned binary format that
+  // is used in place once mapped. Saving replaces the file atomically.
+  bool save(const QString &path, const SnapshotKey &key) const;
+  // Null if the file is missing, was built from another database or by
+  // another version, or is damaged. Without nutrients, the nutrient data
+  // is left out (and files saved without any are accepted).
+  static std::shared_ptr<FoodSnapshot> map(const QString &path,
+                                           const SnapshotKey &key,
+                                           bool withNutrients);
+};
+
+#endif // FOODSNAPSHOT_H
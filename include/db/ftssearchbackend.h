@@ -0,0 +1,52 @@
+#ifndef FTSSEARCHBACKEND_H
+#define FTSSEARCHBACKEND_H
+
+#include "db/searchbackend.h"
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QThreadStorage>
+#include <atomic>
+
+// Ranks with an SQLite FTS5 index over the food descriptions: every query
+// token is matched as a prefix, and results are ordered by bm25. Needs far
+// less memory than fuzzy scoring, but does not forgive typos.
+//
+// The USDA database is opened read-only, so the index lives in a sidecar
+// database file, along with each food's group for filters and facet counts.
+// It is (re)built from the snapshot whenever it is missing or was built from
+// a different version of the USDA database.
+class FtsSearchBackend : public SearchBackend {
+public:
+  explicit FtsSearchBackend(QString indexPath);
+  ~FtsSearchBackend() override;
+
+  FtsSearchBackend(const FtsSearchBackend &) = delete;
+  FtsSearchBackend &operator=(const FtsSearchBackend &) = delete;
+
+  [[nodiscard]] QString name() const override { return "fts5"; }
+  bool rank(const SearchRequest &request,
+            std::vector<SearchMatch> &matches) override;
+
+  // FTS5 MATCH expression for a normalized query: each token quoted, as a
+  // prefix, all of them required. Empty if there is nothing to match.
+  static QString matchExpression(const QString &query);
+
+private:
+  struct ThreadConnection;
+
+  QSqlDatabase connection();
+  // Builds the index if it does not match the snapshot. False on failure.
+  bool ensureIndex(const FoodSnapshot &snapshot);
+  bool buildIndex(QSqlDatabase &db, const FoodSnapshot &snapshot,
+                  const QString &source);
+  // Warns (the first time only) and returns false, failing the search
+  bool unavailable(const QString &reason);
+
+  QString m_path;
+  QMutex m_buildMutex;
+  std::atomic<quint64> m_indexedGeneration{0};
+  std::atomic<bool> m_warned{false};
+  QThreadStorage<ThreadConnection *> m_connections;
+};
+
+#endif // FTSSEARCHBACKEND_H
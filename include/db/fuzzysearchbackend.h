@@ -0,0 +1,20 @@
+#ifndef FUZZYSEARCHBACKEND_H
+#define FUZZYSEARCHBACKEND_H
+
+#include "db/searchbackend.h"
+
+// Scores candidates in memory with Utils::calculateFuzzyScore, in parallel.
+// Candidates come from the session when the query extends the previous one
+// so little that no other food can have risen above the threshold (see
+// Utils::maxExtendedScore), and every food otherwise. The snapshot's trigram
+// index first narrows them to the foods that can score above 80; only when
+// those do not fill the results with such scores is everything scored.
+// Tolerates typos.
+class FuzzySearchBackend : public SearchBackend {
+public:
+  [[nodiscard]] QString name() const override { return "fuzzy"; }
+  bool rank(const SearchRequest &request,
+            std::vector<SearchMatch> &matches) override;
+};
+
+#endif // FUZZYSEARCHBACKEND_H
@@ -0,0 +1,81 @@
+#ifndef MEALJOURNAL_H
+#define MEALJOURNAL_H
+
+#include <QDate>
+#include <QFile>
+#include <QString>
+#include <vector>
+
+// One food eaten on one day, with the nutrients it provided. Nutrients are
+// stored by USDA id rather than definition index, so the journal does not
+// depend on the food database it was logged against.
+struct JournalEntry {
+  QDate day;
+  qint64 loggedAtMs = 0; // Since the epoch, UTC
+  int foodId = 0;
+  QString description;
+  double grams = 0.0;
+  std::vector<quint16> nutrientIds;
+  std::vector<float> amounts; // For the grams eaten, same order
+};
+
+// What a range of days added up to
+struct JournalTotals {
+  int calendarDays = 0;
+  int loggedDays = 0; // Days with at least one entry
+  int entryCount = 0;
+  std::vector<int> nutrientIds;
+  std::vector<double> amounts; // Summed over the range, same order
+};
+
+// An append-only log of meal entries in a binary file. Each record carries
+// its length and a checksum and is written with a single write followed by
+// a sync, so a crash can at worst leave one torn record at the end; opening
+// the journal cuts such a tail off. A damaged record anywhere else makes
+// opening fail instead, so the entries after it are never lost.
+//
+// The entries themselves are not kept in memory, only a day x nutrient
+// matrix of totals and its running (prefix) sums, so totals over any range
+// of days are one subtraction per nutrient.
+class MealJournal {
+public:
+  // Reads the whole log at path, creating it if missing. Returns false (and
+  // stays closed) if the file cannot be opened, is not a journal or is
+  // damaged before its last record.
+  bool open(const QString &path);
+  void close();
+  [[nodiscard]] bool isOpen() const { return m_file.isOpen(); }
+
+  // Adds the entries to the log and the day totals; nothing is added if the
+  // write fails
+  bool append(const std::vector<JournalEntry> &entries);
+
+  [[nodiscard]] int entryCount() const;
+  // First and last days with an entry; invalid when empty
+  [[nodiscard]] QDate firstDay() const;
+  [[nodiscard]] QDate lastDay() const;
+  // Totals over from..to, both included
+  [[nodiscard]] JournalTotals totals(const QDate &from,
+                                     const QDate &to) const;
+
+private:
+  // Adds to the day totals; the prefix sums are brought up to date by
+  // updatePrefix. Returns the row of the entry's day.
+  int addToDay(const JournalEntry &entry);
+  // Recomputes the prefix sums from this day row on
+  void updatePrefix(int fromRow);
+  [[nodiscard]] int columnOf(int nutrientId);
+
+  QFile m_file;
+  std::vector<qint64> m_days; // Julian day numbers, ascending
+  std::vector<int> m_nutrientIds; // By column
+  std::vector<int> m_columns;     // By nutrient id, -1 if no column yet
+  // Row-major, one row per day
+  std::vector<double> m_dayTotals;
+  std::vector<int> m_dayEntries;
+  // One more row than m_days: row r sums the days before r
+  std::vector<double> m_prefix;
+  std::vector<int> m_entryPrefix;
+};
+
+#endif // MEALJOURNAL_H
@@ -0,0 +1,42 @@
+#ifndef NUTRIENTDEFINITIONS_H
+#define NUTRIENTDEFINITIONS_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QString>
+#include <vector>
+
+struct NutrientDefinition {
+  int id;
+  QString description;
+  QString unit;
+  double rda = 0.0; // Recommended daily amount in unit, 0 if none is known
+};
+
+// Every row of nutr_def, loaded once. Nutrient records refer to a definition
+// by its index here instead of carrying their own copies of the strings.
+// Indices follow ascending nutrient id, so sorting by index sorts by id.
+class NutrientDefinitions {
+public:
+  // Returns false (and leaves the table empty) if the query fails
+  bool load(const QSqlDatabase &db);
+
+  [[nodiscard]] int size() const {
+    return static_cast<int>(m_definitions.size());
+  }
+  [[nodiscard]] bool isEmpty() const { return m_definitions.empty(); }
+
+  [[nodiscard]] const NutrientDefinition &at(int index) const {
+    return m_definitions[index];
+  }
+  // -1 for unknown nutrient ids
+  [[nodiscard]] int indexOf(int nutrientId) const {
+    return m_indexById.value(nutrientId, -1);
+  }
+
+private:
+  std::vector<NutrientDefinition> m_definitions;
+  QHash<int, int> m_indexById;
+};
+
+#endif // NUTRIENTDEFINITIONS_H
@@ -0,0 +1,75 @@
+#ifndef NUTRIENTPRESENCE_H
+#define NUTRIENTPRESENCE_H
+
+#include "db/nutrientdefinitions.h"
+#include "utils/packed_array.h"
+#include <QtGlobal>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Which nutrients each food reports, one bit per NutrientDefinitions entry.
+// Kept twice: a fixed-width row per food (by corpus index), so counts are
+// popcounts of a few words, and a column per nutrient across the corpus, so
+// "foods reporting all of these" is a word-wise AND of a few columns.
+class NutrientPresence {
+public:
+  // USDA numbers amino acids 501-521 and the flavonoids (with isoflavones
+  // and proanthocyanidins) 710-799
+  static constexpr int kFirstAminoAcidId = 501;
+  static constexpr int kLastAminoAcidId = 521;
+  static constexpr int kFirstFlavonoidId = 710;
+  static constexpr int kLastFlavonoidId = 799;
+
+  // Starts over with foodCount foods reporting nothing, and precomputes the
+  // amino acid and flavonoid masks from definitions
+  void reset(int foodCount, const NutrientDefinitions &definitions);
+  // Marks a nutrient as reported by the food at this corpus index
+  void set(int food, int definition);
+  void clear();
+
+  void writeTo(SnapshotWriter &writer) const;
+  // Borrows the reader's memory instead of copying it. Fails unless the
+  // stored table has exactly these dimensions.
+  bool readFrom(SnapshotReader &reader, int foodCount, int definitionCount);
+
+  [[nodiscard]] bool isEmpty() const { return m_foodCount == 0; }
+  [[nodiscard]] int foodCount() const { return m_foodCount; }
+
+  [[nodiscard]] bool reports(int food, int definition) const;
+  // Number of nutrients the food reports at all
+  [[nodiscard]] int count(int food) const;
+  [[nodiscard]] int aminoAcidCount(int food) const {
+    return maskedCount(food, m_aminoAcidMask);
+  }
+  [[nodiscard]] int flavonoidCount(int food) const {
+    return maskedCount(food, m_flavonoidMask);
+  }
+
+  // Ascending corpus indices of the foods reporting every listed nutrient
+  // (every food if none are listed)
+  [[nodiscard]] std::vector<int>
+  foodsReportingAll(const std::vector<int> &definitions) const;
+  // Same as foodsReportingAll(definitions).size(), without the list
+  [[nodiscard]] int
+  countReportingAll(const std::vector<int> &definitions) const;
+
+private:
+  [[nodiscard]] int
+  maskedCount(int food, const Utils::PackedArray<quint64> &mask) const;
+  // AND of the listed columns, with bits past the last food cleared
+  [[nodiscard]] std::vector<quint64>
+  intersectColumns(const std::vector<int> &definitions) const;
+
+  int m_foodCount = 0;
+  int m_definitionCount = 0;
+  int m_rowWords = 0;    // Per food row, enough for every definition
+  int m_columnWords = 0; // Per nutrient column, enough for every food
+  Utils::PackedArray<quint64> m_rows;
+  Utils::PackedArray<quint64> m_columns;
+  Utils::PackedArray<quint64> m_aminoAcidMask; // m_rowWords words each
+  Utils::PackedArray<quint64> m_flavonoidMask;
+};
+
+#endif // NUTRIENTPRESENCE_H
@@ -0,0 +1,56 @@
+#ifndef NUTRIENTRANKING_H
+#define NUTRIENTRANKING_H
+
+#include "db/foodcorpus.h"
+#include <QString>
+#include <vector>
+
+// What "most" means when ranking foods by a nutrient
+enum class NutrientBasis {
+  Per100Grams,
+  // Amount per 100 kcal of energy (nutrient 208). Foods without a positive
+  // energy value are left out.
+  Per100Kcal,
+};
+
+struct NutrientRankingQuery {
+  int nutrientId = 0; // USDA nutrient id
+  NutrientBasis basis = NutrientBasis::Per100Grams;
+  int foodGroupId = -1; // Only rank foods of this group; -1 for every group
+  int limit = 50;
+};
+
+struct RankedFood {
+  int id;
+  QString description;
+  int foodGroupId;
+  double amount; // Per 100 g
+  double value;  // What the ranking is by, in the query's basis
+};
+
+// One nutrient's amount for every food of a corpus: a dense array by corpus
+// index (NaN for foods that do not report it), plus the reporting foods
+// presorted by descending amount so the top foods per 100 g are a prefix.
+class NutrientColumn {
+public:
+  explicit NutrientColumn(std::vector<double> amounts);
+
+  [[nodiscard]] bool reports(int food) const;
+  [[nodiscard]] double amount(int food) const { return m_amounts[food]; }
+  // Corpus indices, ties broken by index
+  [[nodiscard]] const std::vector<int> &byAmount() const { return m_byAmount; }
+
+private:
+  std::vector<double> m_amounts;
+  std::vector<int> m_byAmount;
+};
+
+// The best query.limit foods of corpus, best first. energy is the column of
+// nutrient 208 and only needed per kcal. Per 100 g walks the presorted
+// order; per kcal selects the top values with a partial sort.
+std::vector<RankedFood> rankByNutrient(const FoodCorpus &corpus,
+                                       const NutrientColumn &column,
+                                       const NutrientColumn *energy,
+                                       const NutrientRankingQuery &query);
+
+#endif // NUTRIENTRANKING_H
@@ -0,0 +1,112 @@
+#ifndef NUTRIENTSIMILARITY_H
+#define NUTRIENTSIMILARITY_H
+
+#include "db/foodcorpus.h"
+#include "db/nutrientranking.h"
+#include <QString>
+#include <vector>
+
+// How far apart two nutrient profiles are
+enum class SimilarityMetric {
+  // Angle between the profiles: same proportions, whatever the density
+  Cosine,
+  // Straight-line distance: also tells a food from a watered-down version
+  Euclidean,
+};
+
+struct SimilarityQuery {
+  int foodId = 0; // Find foods like this one
+  NutrientBasis basis = NutrientBasis::Per100Grams;
+  SimilarityMetric metric = SimilarityMetric::Cosine;
+  int foodGroupId = -1; // Only consider this group; -1 for every group
+  int limit = 20;
+  // Scan every food even when an index is built (for checking its recall)
+  bool exact = false;
+};
+
+struct SimilarFood {
+  int id;
+  QString description;
+  int foodGroupId;
+  double distance; // In the query's metric, smaller is closer
+};
+
+// A nutrient profile per food: a dense float row over a fixed set of
+// nutrients, by corpus index. Each amount is scaled by the nutrient's mean
+// over the foods reporting it and compressed with log1p, so nutrients in
+// mg and in g weigh alike and one outlier does not dominate; nutrients a
+// food does not report count as 0. Per 100 kcal rows are divided by the
+// food's energy first, and foods without positive energy have no profile.
+//
+// Queries score rows with the SIMD dot product kernel. Small corpora are
+// scanned in full. Large ones (branded foods) can also build an IVF index:
+// rows are clustered with k-means and stored cluster by cluster, and a
+// query only scans the clusters whose centroids are closest to it.
+class NutrientProfiles {
+public:
+  struct Neighbour {
+    int food; // Corpus index
+    float distance;
+  };
+
+  // Starts over with foodCount empty rows over these definition indices.
+  // energyDefinition is the index of nutrient 208 (-1 if unknown), needed
+  // per 100 kcal.
+  void reset(int foodCount, const std::vector<int> &definitions,
+             NutrientBasis basis, int energyDefinition);
+  // Records the amount per 100 g; definitions outside the set are ignored
+  void set(int food, int definition, double amount);
+  // Scales the recorded amounts into profiles. Call once, after every set.
+  void finish();
+  // Clusters the rows for approximate queries, with about sqrt(foods) / 2
+  // clusters. Only worth it from kIndexThreshold foods.
+  void buildIndex();
+
+  static constexpr int kIndexThreshold = 20000;
+
+  [[nodiscard]] int foodCount() const { return m_foodCount; }
+  [[nodiscard]] int dimensions() const {
+    return static_cast<int>(m_definitions.size());
+  }
+  [[nodiscard]] bool hasIndex() const { return !m_centroids.empty(); }
+  // False for foods without any profiled nutrient (or, per 100 kcal,
+  // without energy)
+  [[nodiscard]] bool contains(int food) const;
+
+  // The limit closest foods to food, closest first, leaving out food
+  // itself. Only considers candidates (corpus indices) when given, which
+  // are always scanned in full; otherwise uses the index unless exact.
+  [[nodiscard]] std::vector<Neighbour>
+  nearest(int food, SimilarityMetric metric, int limit,
+          const std::vector<int> *candidates = nullptr,
+          bool exact = false) const;
+
+private:
+  [[nodiscard]] const float *row(int slot) const {
+    return m_rows.data() + static_cast<size_t>(slot) * dimensions();
+  }
+  // Distances from the query row to count rows starting at slot
+  void score(const float *query, float queryNorm, SimilarityMetric metric,
+             int slot, int count, std::vector<Neighbour> &out) const;
+  void scoreSlots(const float *query, float queryNorm,
+                  SimilarityMetric metric, const std::vector<int> &slots,
+                  std::vector<Neighbour> &out) const;
+
+  int m_foodCount = 0;
+  std::vector<int> m_definitions;
+  std::vector<int> m_dimensionOf; // By definition index, -1 if not profiled
+  NutrientBasis m_basis = NutrientBasis::Per100Grams;
+  int m_energyDefinition = -1;
+  std::vector<float> m_energy; // Per food, per 100 kcal only
+
+  // Rows are stored by slot. Without an index the slot is the corpus
+  // index; with one, each cluster's rows are contiguous.
+  std::vector<float> m_rows;
+  std::vector<float> m_squaredNorms; // By slot
+  std::vector<int> m_slotOf;         // By corpus index, -1 without a profile
+  std::vector<int> m_foodAt;         // By slot
+  std::vector<float> m_centroids;    // Cluster-major, dimensions() each
+  std::vector<int> m_clusterOffsets; // First slot of each cluster, plus end
+};
+
+#endif // NUTRIENTSIMILARITY_H
@@ -0,0 +1,55 @@
+#ifndef NUTRIENTSTORE_H
+#define NUTRIENTSTORE_H
+
+#include "db/nutrientdefinitions.h"
+#include "utils/packed_array.h"
+#include <QSqlDatabase>
+#include <QtGlobal>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// The nutrients of one food: parallel arrays owned by a NutrientStore,
+// valid for as long as the store is
+struct NutrientRow {
+  const quint16 *indices = nullptr; // Into NutrientDefinitions
+  const double *amounts = nullptr;  // Per 100 g
+  int count = 0;
+
+  [[nodiscard]] bool isEmpty() const { return count == 0; }
+};
+
+// All of nut_data in compressed sparse row form: foods sorted by id, each
+// owning a contiguous slice of the nutrient index and amount arrays.
+class NutrientStore {
+public:
+  // Replaces the contents with every food's nutrients, as indices into
+  // definitions. Returns false (and leaves the store empty) if the query
+  // fails.
+  bool load(const QSqlDatabase &db, const NutrientDefinitions &definitions);
+  void clear();
+
+  void writeTo(SnapshotWriter &writer) const;
+  // Borrows the reader's memory instead of copying it. Fails if any index
+  // is outside a table of definitionCount entries.
+  bool readFrom(SnapshotReader &reader, int definitionCount);
+
+  [[nodiscard]] bool isEmpty() const { return m_foodIds.empty(); }
+  [[nodiscard]] int foodCount() const {
+    return static_cast<int>(m_foodIds.size());
+  }
+  [[nodiscard]] int valueCount() const {
+    return static_cast<int>(m_nutrientIndices.size());
+  }
+
+  // Empty for foods without nutrient data
+  [[nodiscard]] NutrientRow row(int foodId) const;
+
+private:
+  Utils::PackedArray<int> m_foodIds;
+  Utils::PackedArray<int> m_offsets{0}; // Per food, plus a trailing end offset
+  Utils::PackedArray<quint16> m_nutrientIndices;
+  Utils::PackedArray<double> m_amounts;
+};
+
+#endif // NUTRIENTSTORE_H
@@ -0,0 +1,56 @@
+#ifndef RECIPEIMPORTER_H
+#define RECIPEIMPORTER_H
+
+#include "db/foodrepository.h"
+#include <QIODevice>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <vector>
+
+// One ingredient line of a recipe, and the food it was matched to
+struct ImportedIngredient {
+  int lineNumber;
+  QString text; // As written in the file
+  double grams;
+  int foodId = -1; // -1 if nothing matched
+  QString foodName;
+  // Fuzzy score of text against the matched food's description, 0-100
+  int score = 0;
+  // Matched with a score below RecipeImportOptions::confidentScore, or not
+  // at all
+  bool lowConfidence = true;
+};
+
+struct RecipeImportOptions {
+  int chunkLines = 512; // Lines read (and resolved) at a time
+  int confidentScore = 75;
+  int threadCount = 0; // 0 = one per core
+};
+
+struct RecipeImportResult {
+  std::vector<ImportedIngredient> ingredients; // In file order
+  int lowConfidenceCount = 0;
+  // Lines that were skipped, with the reason
+  QStringList problems;
+};
+
+// Called after each chunk with the number of lines read so far
+using ImportProgress = std::function<void(int linesRead)>;
+
+// Reads ingredient lines from CSV and matches each ingredient to the best
+// search result. A header row naming an "ingredient" (or "food" or
+// "description") and a "grams" (or "g" or "amount") column picks the
+// columns; otherwise they are the first two. Blank lines and lines starting
+// with # are ignored.
+//
+// The file is read a chunk at a time, so only the results are kept whole.
+// Each chunk's distinct ingredients are searched on a thread pool, one
+// search per thread, and ingredients seen before reuse the earlier match.
+// Returns false if the device cannot be read.
+bool importRecipeCsv(QIODevice &device, FoodRepository &repository,
+                     RecipeImportResult &result,
+                     const RecipeImportOptions &options = {},
+                     const ImportProgress &progress = ImportProgress());
+
+#endif // RECIPEIMPORTER_H
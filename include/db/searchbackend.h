@@ -0,0 +1,63 @@
+#ifndef SEARCHBACKEND_H
+#define SEARCHBACKEND_H
+
+#include "db/foodsnapshot.h"
+#include "db/searchcache.h"
+#include <QString>
+#include <functional>
+#include <vector>
+
+using SearchMatch = SearchCache::Match;
+using SearchFacet = SearchCache::Facet;
+
+// Remembers what the previous query matched, so that typing more characters
+// only rescores those foods instead of the whole corpus
+struct SearchSession {
+  QString query;              // Lowercased
+  std::vector<int> survivors; // Corpus indices, ascending
+  int ceiling = 0;            // Highest score any other food can have
+  quint64 generation = 0;     // Snapshot the survivors index into
+  int foodGroupId = -1;       // Group the survivors were limited to
+  bool valid = false;
+
+  void reset();
+};
+
+// One search, as handed to a backend by FoodRepository
+struct SearchRequest {
+  const FoodSnapshot *snapshot = nullptr;
+  QString query; // Lowercased and trimmed, punctuation kept
+  int maxResults = 100;
+  int threadCount = 0; // Hint for backends that score in parallel
+  // Only foods of this group are considered at all; -1 for every group
+  int foodGroupId = -1;
+  // If set, receives how many foods of each group matched (those with any
+  // match, by ascending group id), counting every match the backend scored,
+  // not just the best maxResults. Backends that stop at the foods that can
+  // make the best maxResults leave out weaker matches.
+  std::vector<SearchFacet> *facets = nullptr;
+  // Backends are free to ignore it (and should then reset it)
+  SearchSession *session = nullptr;
+  // Null if the search cannot be cancelled
+  const std::function<bool()> *isCancelled = nullptr;
+  // If set, may receive the best matches found so far (at most maxResults,
+  // best first) while the ranking is still running
+  std::function<void(const std::vector<SearchMatch> &)> onPartialMatches;
+};
+
+// A way of ranking the foods of a snapshot against a query. Backends are
+// shared by every thread that searches, so rank() must be thread-safe.
+class SearchBackend {
+public:
+  virtual ~SearchBackend() = default;
+
+  // Short identifier, e.g. for settings and logs
+  [[nodiscard]] virtual QString name() const = 0;
+
+  // Fills matches with at most request.maxResults foods, best first, scored
+  // 0-100. Returns false if the search was cancelled or failed.
+  virtual bool rank(const SearchRequest &request,
+                    std::vector<SearchMatch> &matches) = 0;
+};
+
+#endif // SEARCHBACKEND_H
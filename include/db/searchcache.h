@@ -0,0 +1,66 @@
+#ifndef SEARCHCACHE_H
+#define SEARCHCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <list>
+#include <vector>
+
+// Bounded, thread-safe LRU map from a normalized query to its ranked matches
+class SearchCache {
+public:
+  struct Match {
+    int index; // Into the corpus
+    int id;
+    int score;
+  };
+  // How many foods of one group matched
+  struct Facet {
+    int foodGroupId;
+    int count;
+  };
+
+  explicit SearchCache(int capacity = 64);
+
+  // Evicts the least recently used entries beyond capacity; 0 disables
+  void setCapacity(int capacity);
+  [[nodiscard]] int capacity() const;
+
+  // Counts a hit or a miss; a hit also marks the entry most recently used.
+  // Entries only match the snapshot generation they were ranked against,
+  // and only match a lookup asking for facets if they were inserted with
+  // them.
+  bool lookup(const QString &key, quint64 generation,
+              std::vector<Match> &matches,
+              std::vector<Facet> *facets = nullptr);
+  // Null facets: not counted for this search
+  void insert(const QString &key, quint64 generation,
+              const std::vector<Match> &matches,
+              const std::vector<Facet> *facets = nullptr);
+  void clear();
+
+  [[nodiscard]] quint64 hits() const;
+  [[nodiscard]] quint64 misses() const;
+  void resetStatistics();
+
+private:
+  struct Entry {
+    QString key;
+    quint64 generation;
+    std::vector<Match> matches;
+    std::vector<Facet> facets;
+    bool hasFacets;
+  };
+
+  void evictExcess();
+
+  mutable QMutex m_mutex;
+  int m_capacity;
+  std::list<Entry> m_entries; // Most recently used first
+  QHash<QString, std::list<Entry>::iterator> m_index;
+  quint64 m_hits = 0;
+  quint64 m_misses = 0;
+};
+
+#endif // SEARCHCACHE_H
@@ -0,0 +1,50 @@
+#ifndef SEARCHWORKER_H
+#define SEARCHWORKER_H
+
+#include "db/foodrepository.h"
+#include <QMetaType>
+#include <QObject>
+#include <atomic>
+#include <vector>
+
+Q_DECLARE_METATYPE(std::vector<FoodItem>)
+Q_DECLARE_METATYPE(std::vector<SearchFacet>)
+
+// Runs searches on the thread it lives on. Every request carries a
+// generation number; starting a newer one abandons older ones, even mid-scan.
+// Matches per food group cost extra (a query of their own on FTS5), so they
+// are only counted when asked for.
+class SearchWorker : public QObject {
+  Q_OBJECT
+
+public:
+  explicit SearchWorker(FoodRepository &repository, QObject *parent = nullptr);
+
+  // Thread-safe. Returns the generation for a new request, making every
+  // request issued before it stale.
+  int nextGeneration();
+
+public slots:
+  // foodGroupId limits the search to one group; -1 searches every group
+  void search(int generation, const QString &query, int foodGroupId);
+  // Counts the matches of the query in every group, for the search of the
+  // same generation. Does not start a new generation.
+  void countFacets(int generation, const QString &query);
+
+signals:
+  // The best matches found so far arrive while a long scan runs (isFinal
+  // false), then the full ranking
+  void resultsReady(int generation, const std::vector<FoodItem> &results,
+                    bool isFinal);
+  // Matches per food group, in answer to countFacets
+  void facetsReady(int generation, const std::vector<SearchFacet> &facets);
+
+private:
+  [[nodiscard]] bool isStale(int generation) const;
+
+  FoodRepository &m_repository;
+  SearchSession m_session; // Only touched on the worker thread
+  std::atomic<int> m_generation{0};
+};
+
+#endif // SEARCHWORKER_H
@@ -0,0 +1,103 @@
+#ifndef SNAPSHOTIO_H
+#define SNAPSHOTIO_H
+
+#include "utils/packed_array.h"
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <cstring>
+
+// Sequential access to the values and arrays of a snapshot file. Each array
+// is stored 8-byte aligned as its element count followed by the raw elements,
+// so every array in a mapped file is suitably aligned to be used in place.
+class SnapshotWriter {
+public:
+  explicit SnapshotWriter(QIODevice *device) : m_device(device) {}
+
+  template <typename T> void writeValue(const T &value) {
+    writeRaw(&value, sizeof(T));
+  }
+  template <typename T> void writeArray(const T *data, size_t count) {
+    pad();
+    writeValue(quint64(count));
+    writeRaw(data, count * sizeof(T));
+    pad();
+  }
+  template <typename T> void writeArray(const Utils::PackedArray<T> &array) {
+    writeArray(array.data(), array.size());
+  }
+  void writeString(const QString &text) {
+    writeArray(text.constData(), static_cast<size_t>(text.size()));
+  }
+  void writeBytes(const QByteArray &bytes) {
+    writeArray(bytes.constData(), static_cast<size_t>(bytes.size()));
+  }
+
+  [[nodiscard]] bool ok() const { return m_ok; }
+
+private:
+  void writeRaw(const void *data, size_t size);
+  void pad();
+
+  QIODevice *m_device;
+  qint64 m_written = 0;
+  bool m_ok = true;
+};
+
+// Reads what SnapshotWriter wrote, from memory that must stay mapped for as
+// long as anything read from it is in use: arrays and strings borrow it.
+// Any read past the end fails, and so does every read after it.
+class SnapshotReader {
+public:
+  SnapshotReader(const uchar *data, qint64 size)
+      : m_data(data), m_size(size) {}
+
+  template <typename T> bool readValue(T &value) {
+    if (!has(sizeof(T)))
+      return false;
+    std::memcpy(&value, m_data + m_pos, sizeof(T));
+    m_pos += sizeof(T);
+    return true;
+  }
+  template <typename T> bool readArray(Utils::PackedArray<T> &array) {
+    const T *data = nullptr;
+    size_t count = 0;
+    if (!readArrayData(data, count))
+      return false;
+    array = Utils::PackedArray<T>::borrow(data, count);
+    return true;
+  }
+  bool readString(QString &text);
+  bool readBytes(QByteArray &bytes);
+
+  [[nodiscard]] bool atEnd() const { return m_ok && m_pos == m_size; }
+
+private:
+  template <typename T> bool readArrayData(const T *&data, size_t &count) {
+    quint64 storedCount = 0;
+    if (!skipPadding() || !readValue(storedCount) ||
+        storedCount > quint64(m_size - m_pos) / sizeof(T))
+      return fail();
+    count = static_cast<size_t>(storedCount);
+    data = reinterpret_cast<const T *>(m_data + m_pos);
+    m_pos += static_cast<qint64>(count * sizeof(T));
+    return skipPadding();
+  }
+  bool has(qint64 bytes) {
+    if (!m_ok || bytes > m_size - m_pos)
+      return fail();
+    return true;
+  }
+  bool skipPadding();
+  bool fail() {
+    m_ok = false;
+    return false;
+  }
+
+  const uchar *m_data;
+  qint64 m_size;
+  qint64 m_pos = 0;
+  bool m_ok = true;
+};
+
+#endif // SNAPSHOTIO_H
@@ -1,11 +1,16 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "db/mealjournal.h"
 #include "widgets/detailswidget.h"
+#include "widgets/historywidget.h"
 #include "widgets/mealwidget.h"
+#include "widgets/rankingwidget.h"
 #include "widgets/searchwidget.h"
 #include <QMainWindow>
+#include <QProgressBar>
 #include <QTabWidget>
+#include <QThread>
 
 class MainWindow : public QMainWindow {
   Q_OBJECT
@@ -14,13 +19,26 @@ public:
   MainWindow(QWidget *parent = nullptr);
   ~MainWindow() override;
 
+  // Load the search cache on a background thread, reporting progress in the
+  // status bar. Searches issued meanwhile wait for it to finish.
+  void startWarmup();
+  // Open the meal journal (creating it if needed) for logging and history
+  bool openJournal(const QString &path);
+
 private:
   void setupUi();
+  void onWarmupProgress(int step, int stepCount, const QString &label);
+  void onWarmupFinished();
 
   QTabWidget *tabs;
   SearchWidget *searchWidget;
   DetailsWidget *detailsWidget;
+  RankingWidget *rankingWidget;
   MealWidget *mealWidget;
+  HistoryWidget *historyWidget;
+  QProgressBar *warmupProgress;
+  QThread *warmupThread = nullptr;
+  MealJournal journal;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,53 @@
+#ifndef MEALOPTIMIZER_H
+#define MEALOPTIMIZER_H
+
+#include "meal/mealtotals.h"
+#include <vector>
+
+// What the meal should provide of one nutrient, in the nutrient's unit
+struct NutrientGoal {
+  int definition;          // Index into NutrientDefinitions
+  double target = 0.0;     // Aimed for when > 0
+  double upperLimit = 0.0; // Not to be exceeded when > 0
+};
+
+struct MealOptimizerOptions {
+  double maxGrams = 1000.0; // Per food
+  // Newton steps over all rounds
+  int maxIterations = 200;
+  // Stops once no food moves by more than this many grams in a step
+  double tolerance = 1e-3;
+  // Weight of a limit overshoot relative to missing a target by as much.
+  // While a limit is still exceeded by more than limitTolerance (relative),
+  // up to limitRounds more rounds solve again with 100 times the weight.
+  double limitWeight = 100.0;
+  int limitRounds = 3;
+  double limitTolerance = 1e-3;
+};
+
+struct MealSolution {
+  std::vector<double> grams; // One per food, in [0, maxGrams]
+  int iterations = 0;
+  bool converged = false;
+  // Sum of squared relative target misses plus limit overshoots weighted
+  // by options.limitWeight
+  double objective = 0.0;
+  // Definitions whose total still exceeds the upper limit by more than
+  // limitTolerance, ascending
+  std::vector<int> exceededLimits;
+};
+
+// Solves for the grams of each food that bring the meal's totals closest to
+// the targets, as a bounded least-squares problem over the dense goal x food
+// matrix. Misses are measured relative to each target, so nutrients in mg
+// and in g weigh the same, and overshooting an upper limit is penalized
+// quadratically, harder each round until no limit is exceeded. Uses
+// projected Newton steps from grams: each solves the food x food system of
+// the foods off their bounds, so 50 foods x 150 nutrients solve in a few
+// milliseconds whatever the scales of the nutrients.
+MealSolution optimizeMeal(const std::vector<const NutrientVector *> &foods,
+                          const std::vector<NutrientGoal> &goals,
+                          const std::vector<double> &grams,
+                          const MealOptimizerOptions &options = {});
+
+#endif // MEALOPTIMIZER_H
@@ -0,0 +1,49 @@
+#ifndef MEALTOTALS_H
+#define MEALTOTALS_H
+
+#include "db/foodrepository.h"
+#include <vector>
+
+// One food's nutrients per 100 g, both dense (for scale-and-add) and as the
+// definitions it reports (the only totals it can change)
+struct NutrientVector {
+  std::vector<double> amounts; // By definition index, 0 where not reported
+  std::vector<int> reported;   // Ascending definition indices
+
+  static NutrientVector fromNutrients(const std::vector<Nutrient> &nutrients,
+                                      int definitionCount);
+  static NutrientVector fromNutrients(const FoodNutrients &nutrients,
+                                      int definitionCount);
+  // Amount per 100 g, 0 if not reported or out of range
+  [[nodiscard]] double amount(int definition) const;
+};
+
+// Running nutrient totals of a meal, one dense slot per NutrientDefinitions
+// entry. Each edit applies the difference it makes instead of summing the
+// whole meal again, so its cost does not depend on the meal's size.
+class MealTotals {
+public:
+  void reset(int definitionCount);
+
+  void addFood(const NutrientVector &food, double grams);
+  void removeFood(const NutrientVector &food, double grams);
+  void changeGrams(const NutrientVector &food, double oldGrams,
+                   double newGrams);
+
+  [[nodiscard]] int size() const { return static_cast<int>(m_totals.size()); }
+  [[nodiscard]] double total(int definition) const {
+    return m_totals[definition];
+  }
+  // Whether any food in the meal reports the nutrient
+  [[nodiscard]] bool isReported(int definition) const {
+    return m_reporters[definition] > 0;
+  }
+
+private:
+  void scaleAdd(const NutrientVector &food, double factor);
+
+  std::vector<double> m_totals;
+  std::vector<int> m_reporters; // Foods reporting each nutrient
+};
+
+#endif // MEALTOTALS_H
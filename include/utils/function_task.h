@@ -0,0 +1,30 @@
+#ifndef FUNCTION_TASK_H
+#define FUNCTION_TASK_H
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <functional>
+#include <utility>
+
+namespace Utils {
+
+// Runs a function on a QThreadPool and releases done once it returns, so
+// the caller can wait for a batch of tasks. QRunnable::create() needs Qt
+// 5.15.
+class FunctionTask : public QRunnable {
+public:
+  FunctionTask(std::function<void()> work, QSemaphore &done)
+      : m_work(std::move(work)), m_done(done) {}
+  void run() override {
+    m_work();
+    m_done.release();
+  }
+
+private:
+  std::function<void()> m_work;
+  QSemaphore &m_done;
+};
+
+} // namespace Utils
+
+#endif // FUNCTION_TASK_H
@@ -0,0 +1,113 @@
+#ifndef PACKED_ARRAY_H
+#define PACKED_ARRAY_H
+
+#include <QtGlobal>
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
+
+namespace Utils {
+
+// Array of plain values that either owns its storage (while being built in
+// memory) or borrows memory owned elsewhere, e.g. a mapped snapshot file.
+// Reads look the same either way; only owning arrays can be appended to.
+// Copies of a borrowing array borrow the same memory.
+template <typename T> class PackedArray {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "PackedArray holds raw bytes that may come from a file");
+
+public:
+  PackedArray() = default;
+  PackedArray(std::initializer_list<T> values) : m_owned(values) { sync(); }
+
+  PackedArray(const PackedArray &other) { *this = other; }
+  PackedArray &operator=(const PackedArray &other) {
+    if (this != &other) {
+      m_owned = other.m_owned;
+      m_borrowed = other.m_borrowed;
+      if (m_borrowed) {
+        m_data = other.m_data;
+        m_size = other.m_size;
+      } else {
+        sync();
+      }
+    }
+    return *this;
+  }
+  PackedArray(PackedArray &&other) noexcept { *this = std::move(other); }
+  PackedArray &operator=(PackedArray &&other) noexcept {
+    m_owned = std::move(other.m_owned);
+    m_borrowed = other.m_borrowed;
+    m_data = other.m_data;
+    m_size = other.m_size;
+    if (!m_borrowed)
+      sync();
+    other.m_owned.clear();
+    other.m_borrowed = false;
+    other.sync();
+    return *this;
+  }
+  ~PackedArray() = default;
+
+  // data must outlive the array and every copy of it
+  static PackedArray borrow(const T *data, size_t size) {
+    PackedArray array;
+    array.m_borrowed = true;
+    array.m_data = data;
+    array.m_size = size;
+    return array;
+  }
+
+  [[nodiscard]] bool isBorrowed() const { return m_borrowed; }
+
+  void push_back(const T &value) {
+    Q_ASSERT(!m_borrowed);
+    m_owned.push_back(value);
+    sync();
+  }
+  template <typename It> void append(It first, It last) {
+    Q_ASSERT(!m_borrowed);
+    m_owned.insert(m_owned.end(), first, last);
+    sync();
+  }
+  void resize(size_t size) {
+    Q_ASSERT(!m_borrowed);
+    m_owned.resize(size);
+    sync();
+  }
+  void shrink_to_fit() {
+    m_owned.shrink_to_fit();
+    if (!m_borrowed)
+      sync();
+  }
+
+  // In-place writes, e.g. setting bits after a resize
+  T *mutableData() {
+    Q_ASSERT(!m_borrowed);
+    return m_owned.data();
+  }
+
+  [[nodiscard]] const T *data() const { return m_data; }
+  [[nodiscard]] size_t size() const { return m_size; }
+  [[nodiscard]] bool empty() const { return m_size == 0; }
+  const T &operator[](size_t index) const { return m_data[index]; }
+  [[nodiscard]] const T &back() const { return m_data[m_size - 1]; }
+  [[nodiscard]] const T *begin() const { return m_data; }
+  [[nodiscard]] const T *end() const { return m_data + m_size; }
+
+private:
+  void sync() {
+    m_data = m_owned.data();
+    m_size = m_owned.size();
+  }
+
+  std::vector<T> m_owned;
+  const T *m_data = nullptr;
+  size_t m_size = 0;
+  bool m_borrowed = false;
+};
+
+} // namespace Utils
+
+#endif // PACKED_ARRAY_H
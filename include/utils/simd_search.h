@@ -0,0 +1,22 @@
+#ifndef SIMD_SEARCH_H
+#define SIMD_SEARCH_H
+
+namespace Utils {
+
+// True if needle occurs in haystack (plain byte comparison).
+// Uses AVX2 or SSE2 on x86, picked at runtime, and scalar code elsewhere.
+bool asciiContains(const char *haystack, int haystackLen, const char *needle,
+                   int needleLen);
+
+// Name of the kernel asciiContains dispatches to, for diagnostics
+const char *asciiContainsKernel();
+
+// out[i] = dot product of query with rows[i], for rowCount rows of
+// dimensions floats stored one after another. Dispatches like
+// asciiContains (the same kernel name applies).
+void dotProducts(const float *query, const float *rows, int dimensions,
+                 int rowCount, float *out);
+
+} // namespace Utils
+
+#endif // SIMD_SEARCH_H
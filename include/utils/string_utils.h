@@ -1,18 +1,106 @@
 #ifndef STRING_UTILS_H
 #define STRING_UTILS_H
 
+#include <QByteArray>
 #include <QString>
+#include <QStringList>
 #include <algorithm>
 #include <vector>
 
 namespace Utils {
 
+// Position of a token inside a piece of text
+struct TokenSpan {
+  quint16 start;
+  quint16 length;
+};
+
+// Lowercased text and its token spans, e.g. one entry of the search corpus.
+// Does not own the data it points to.
+struct FoldedTextView {
+  const QChar *text;
+  int length;
+  const TokenSpan *tokens;
+  int tokenCount;
+  // The same text narrowed to 8 bits (see narrowToAscii), or null
+  const char *ascii;
+};
+
+// A query lowercased and tokenized once, to be scored against many targets
+struct FuzzyQuery {
+  QString text;
+  std::vector<TokenSpan> tokens;
+  QByteArray ascii; // 8-bit copy of text, empty unless text is pure ASCII
+
+  [[nodiscard]] FoldedTextView view() const;
+};
+
 // Calculate Levenshtein distance between two strings
+// (reference implementation, full DP matrix)
 int levenshteinDistance(const QString &s1, const QString &s2);
 
+// Same result as levenshteinDistance, computed bit-parallel (Myers/Hyyro)
+// when the shorter string has at most 64 characters
+int fastLevenshteinDistance(const QString &s1, const QString &s2);
+
+// Levenshtein distance, or maxDistance + 1 if it exceeds maxDistance.
+// Gives up early once the budget is blown; does not allocate as long as the
+// shorter string has at most 64 characters.
+int boundedLevenshteinDistance(const QString &s1, const QString &s2,
+                               int maxDistance);
+
 // Calculate a simple fuzzy match score (0-100)
-// Higher is better.
-int calculateFuzzyScore(const QString &query, const QString &target);
+// Higher is better. Scores at or below threshold are only guaranteed to be
+// reported as some value <= threshold, which lets hopeless targets bail out.
+int calculateFuzzyScore(const QString &query, const QString &target,
+                        int threshold = 0);
+
+// Same as above against pre-folded text; does not allocate
+int calculateFuzzyScore(const FuzzyQuery &query, const FoldedTextView &target,
+                        int threshold = 0);
+
+FuzzyQuery prepareFuzzyQuery(const QString &query);
+
+// Distinct padded trigrams (see appendTrigramKeys) of the query's tokens
+// that every target scoring above threshold is guaranteed to share, by the
+// q-gram lemma: an edit changes at most three trigrams of a token. 0 when
+// no bound exists, i.e. a target sharing none could still score above
+// threshold, as with the usual threshold of 40, where "cxocxlaxe" still
+// matches "chocolate".
+int minSharedTrigrams(const FuzzyQuery &query, int threshold);
+
+// Highest score a target scoring at most scoreBefore against before can get
+// against after, a query typed by adding to it. Bounds how far the last
+// token's edit distance can fall and its length grow, and assumes added
+// tokens match perfectly. 100 when after does not start with before.
+int maxExtendedScore(const FuzzyQuery &before, const FuzzyQuery &after,
+                     int scoreBefore);
+
+// Canonical form of a search query: lowercased, trimmed, with each run of
+// whitespace and separator punctuation (, ; : - / ( )) collapsed to a space
+QString normalizeQuery(const QString &query);
+
+// Split one CSV record into fields: separated by commas, optionally quoted,
+// with "" standing for a quote inside quotes. Returns false if a quoted
+// field is still open at the end, i.e. the record continues on the next
+// line (call again with both lines joined by a newline).
+bool splitCsvRecord(const QString &text, QStringList &fields);
+
+// Append the spans of the tokens used for fuzzy matching
+// (separated by whitespace, including Unicode spaces, commas and dashes)
+void appendTokenSpans(const QChar *text, int length,
+                      std::vector<TokenSpan> &spans);
+
+// Copy length UTF-16 units to out as bytes. Anything outside ASCII becomes
+// 0x80, which never equals an ASCII byte, so an ASCII needle matches the
+// narrowed text exactly where it matches the original. Returns false if any
+// such character was replaced.
+bool narrowToAscii(const QChar *text, int length, char *out);
+
+// Append the space-padded character trigrams of a single token to keys.
+// A token of length n yields n trigrams, e.g. "egg" -> " eg", "egg", "gg ".
+void appendTrigramKeys(const QChar *token, int n,
+                       std::vector<quint64> &keys);
 
 } // namespace Utils
 
@@ -2,9 +2,14 @@
 #define DETAILSWIDGET_H
 
 #include "db/foodrepository.h"
+#include "widgets/nutrientsmodel.h"
+#include "widgets/similarfoodsmodel.h"
+#include <QComboBox>
 #include <QLabel>
 #include <QPushButton>
-#include <QTableWidget>
+#include <QSortFilterProxyModel>
+#include <QTableView>
+#include <QThread>
 #include <QWidget>
 
 class DetailsWidget : public QWidget {
@@ -12,6 +17,7 @@ class DetailsWidget : public QWidget {
 
 public:
   explicit DetailsWidget(QWidget *parent = nullptr);
+  ~DetailsWidget() override;
 
   void loadFood(int foodId, const QString &foodName);
 
@@ -20,12 +26,30 @@ signals:
 
 private slots:
   void onAddClicked();
+  // Fill the similar foods table for the current food, once a worker thread
+  // has found them
+  void findSimilar();
+  void onSimilarDoubleClicked(const QModelIndex &index);
 
 private:
+  void showSimilar(std::vector<SimilarFood> similar);
+
   QLabel *nameLabel;
-  QTableWidget *nutrientsTable;
+  QTableView *nutrientsView;
+  NutrientsModel *nutrientsModel;
+  QSortFilterProxyModel *nutrientsProxy;
   QPushButton *addButton;
-  FoodRepository repository;
+
+  // Foods with the closest nutrient profile, as substitutes
+  QComboBox *similarBasisCombo;
+  QComboBox *similarMetricCombo;
+  QTableView *similarView;
+  SimilarFoodsModel *similarModel;
+  QSortFilterProxyModel *similarProxy;
+  QLabel *similarLabel;
+  QThread *similarThread = nullptr;
+  // The food or options changed while similarThread was running
+  bool similarStale = false;
 
   int currentFoodId;
   QString currentFoodName;
@@ -0,0 +1,43 @@
+#ifndef FOODRESULTSMODEL_H
+#define FOODRESULTSMODEL_H
+
+#include "db/foodrepository.h"
+#include <QAbstractTableModel>
+#include <vector>
+
+// Search results for a table view. Cells are produced when the view paints
+// them, so only the visible rows cost anything, and new results are compared
+// with the shown ones so that only rows that changed are repainted.
+class FoodResultsModel : public QAbstractTableModel {
+  Q_OBJECT
+
+public:
+  enum Column {
+    IdColumn,
+    DescriptionColumn,
+    GroupColumn,
+    NutrientsColumn,
+    AminoColumn,
+    FlavonoidColumn,
+    ScoreColumn,
+    ColumnCount
+  };
+
+  explicit FoodResultsModel(QObject *parent = nullptr);
+
+  void setResults(std::vector<FoodItem> results);
+  [[nodiscard]] const FoodItem &food(int row) const { return m_results[row]; }
+
+  [[nodiscard]] int rowCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] int columnCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] QVariant data(const QModelIndex &index,
+                              int role = Qt::DisplayRole) const override;
+  [[nodiscard]] QVariant headerData(int section, Qt::Orientation orientation,
+                                    int role = Qt::DisplayRole) const override;
+
+private:
+  std::vector<FoodItem> m_results;
+  const FoodGroups *m_groups = nullptr;
+};
+
+#endif // FOODRESULTSMODEL_H
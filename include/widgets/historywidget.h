@@ -0,0 +1,33 @@
+#ifndef HISTORYWIDGET_H
+#define HISTORYWIDGET_H
+
+#include "db/mealjournal.h"
+#include <QDateEdit>
+#include <QLabel>
+#include <QTableWidget>
+#include <QWidget>
+
+// Nutrient totals and daily averages over a range of days of the meal
+// journal
+class HistoryWidget : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit HistoryWidget(QWidget *parent = nullptr);
+
+  void setJournal(MealJournal *mealJournal);
+
+public slots:
+  // Recompute the totals for the chosen range
+  void refresh();
+
+private:
+  QDateEdit *fromEdit;
+  QDateEdit *toEdit;
+  QTableWidget *totalsTable;
+  QLabel *statusLabel;
+
+  MealJournal *journal = nullptr;
+};
+
+#endif // HISTORYWIDGET_H
@@ -0,0 +1,127 @@
+#ifndef MEALMODELS_H
+#define MEALMODELS_H
+
+#include "db/nutrientdefinitions.h"
+#include "meal/mealtotals.h"
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QString>
+#include <vector>
+
+struct MealItem {
+  int foodId;
+  QString name;
+  double grams;
+  NutrientVector per100g; // Base nutrients
+  QString note;           // Shown as the row's tooltip
+  bool doubtful = false;  // Highlighted for checking, e.g. a weak match
+};
+
+// The foods of a meal. Only the grams can be edited.
+class MealItemsModel : public QAbstractTableModel {
+  Q_OBJECT
+
+public:
+  enum Column { FoodColumn, GramsColumn, CaloriesColumn, ColumnCount };
+
+  explicit MealItemsModel(QObject *parent = nullptr);
+
+  [[nodiscard]] const std::vector<MealItem> &items() const { return m_items; }
+  // Definition index of energy, for the calories column
+  void setKcalIndex(int index);
+
+  // Adds all the items as one insertion
+  void append(std::vector<MealItem> items);
+  void remove(int row);
+  void clear();
+  // Sets the grams of every row (without gramsEdited) and repaints the rows
+  // that changed
+  void setGrams(const std::vector<double> &grams);
+
+  [[nodiscard]] int rowCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] int columnCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] QVariant data(const QModelIndex &index,
+                              int role = Qt::DisplayRole) const override;
+  [[nodiscard]] QVariant headerData(int section, Qt::Orientation orientation,
+                                    int role = Qt::DisplayRole) const override;
+  [[nodiscard]] Qt::ItemFlags flags(const QModelIndex &index) const override;
+  bool setData(const QModelIndex &index, const QVariant &value,
+               int role = Qt::EditRole) override;
+
+signals:
+  // The grams of the row were edited in a view
+  void gramsEdited(int row, double oldGrams);
+
+private:
+  std::vector<MealItem> m_items;
+  int m_kcalIndex = -1;
+};
+
+// One row per nutrient definition, with the meal's total and a target and
+// limit for the optimizer. Targets start at the RDA.
+class MealTotalsModel : public QAbstractTableModel {
+  Q_OBJECT
+
+public:
+  enum Column {
+    NameColumn,
+    TotalColumn,
+    UnitColumn,
+    RdaColumn,
+    TargetColumn,
+    LimitColumn,
+    ColumnCount
+  };
+
+  // The totals are owned by the meal and must outlive the model
+  explicit MealTotalsModel(const MealTotals &totals,
+                           QObject *parent = nullptr);
+
+  void setDefinitions(const NutrientDefinitions &definitions);
+  // Repaints the totals of these definition indices, a run of adjacent rows
+  // at a time
+  void totalsChanged(std::vector<int> definitions);
+
+  [[nodiscard]] bool isReported(int definition) const {
+    return m_totals.isReported(definition);
+  }
+  // 0 when not set
+  [[nodiscard]] double target(int definition) const {
+    return m_targets[definition];
+  }
+  [[nodiscard]] double limit(int definition) const {
+    return m_limits[definition];
+  }
+
+  [[nodiscard]] int rowCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] int columnCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] QVariant data(const QModelIndex &index,
+                              int role = Qt::DisplayRole) const override;
+  [[nodiscard]] QVariant headerData(int section, Qt::Orientation orientation,
+                                    int role = Qt::DisplayRole) const override;
+  [[nodiscard]] Qt::ItemFlags flags(const QModelIndex &index) const override;
+  bool setData(const QModelIndex &index, const QVariant &value,
+               int role = Qt::EditRole) override;
+
+private:
+  const MealTotals &m_totals;
+  const NutrientDefinitions *m_definitions = nullptr;
+  std::vector<double> m_targets;
+  std::vector<double> m_limits;
+};
+
+// Hides the nutrients no food in the meal reports. Rows come and go as
+// their totals change.
+class ReportedNutrientsFilter : public QSortFilterProxyModel {
+  Q_OBJECT
+
+public:
+  explicit ReportedNutrientsFilter(QObject *parent = nullptr);
+
+protected:
+  [[nodiscard]] bool
+  filterAcceptsRow(int sourceRow,
+                   const QModelIndex &sourceParent) const override;
+};
+
+#endif // MEALMODELS_H
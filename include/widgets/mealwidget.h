@@ -2,17 +2,41 @@
 #define MEALWIDGET_H
 
 #include "db/foodrepository.h"
+#include "db/mealjournal.h"
+#include "db/recipeimporter.h"
+#include "meal/mealoptimizer.h"
+#include "meal/mealtotals.h"
+#include "widgets/mealmodels.h"
+#include <QDateEdit>
+#include <QLabel>
 #include <QPushButton>
-#include <QTableWidget>
+#include <QSortFilterProxyModel>
+#include <QTableView>
+#include <QThread>
 #include <QWidget>
 #include <map>
 #include <vector>
 
-struct MealItem {
-  int foodId;
-  QString name;
-  double grams;
-  std::vector<Nutrient> nutrients_100g; // Base nutrients
+// A finished recipe import, with the nutrients of every matched food
+struct ImportedRecipe {
+  bool ok = false;
+  RecipeImportResult result;
+  std::map<int, NutrientVector> nutrients; // By food id
+  qint64 elapsedMs = 0;
+};
+
+// What an optimization starts from: the meal's foods and grams, and the
+// goals set in the totals table
+struct MealProblem {
+  std::vector<int> foodIds;
+  std::vector<NutrientVector> foods;
+  std::vector<double> grams;
+  std::vector<NutrientGoal> goals;
+  // Definitions some food reports, the only totals the grams can change
+  std::vector<int> reported;
+
+  // Same foods, grams and goals
+  [[nodiscard]] bool sameAs(const MealProblem &other) const;
 };
 
 class MealWidget : public QWidget {
@@ -20,21 +44,56 @@ class MealWidget : public QWidget {
 
 public:
   explicit MealWidget(QWidget *parent = nullptr);
+  ~MealWidget() override;
 
   void addFood(int foodId, const QString &foodName, double grams);
+  // Where Log Meal records the meal; logging is disabled without one
+  void setJournal(MealJournal *mealJournal);
+
+signals:
+  void mealLogged();
 
 private slots:
   void clearMeal();
+  void removeSelected();
+  // Solve on a background thread for the grams that best meet the targets
+  // and limits in the totals table, and write them back into the meal
+  void optimizeGrams();
+  // Append every item of the meal to the journal under the chosen day
+  void logMeal();
+  // Read a recipe CSV on a background thread, then add every ingredient
+  // that matched a food in one batch
+  void importRecipe();
+  void onGramsEdited(int row, double oldGrams);
 
 private:
-  void updateTotals();
+  // Sizes the totals to the nutrient definitions on first use
+  void ensureTotals();
+  // Adds the items to the meal and its totals, and repaints the totals they
+  // change
+  void addItems(std::vector<MealItem> items);
+  void addImported(const ImportedRecipe &imported);
+  [[nodiscard]] MealProblem currentProblem() const;
+  void applySolution(const MealProblem &problem, const MealSolution &solution,
+                     qint64 elapsedMs);
 
-  QTableWidget *itemsTable;
-  QTableWidget *totalsTable;
+  QTableView *itemsView;
+  MealItemsModel *itemsModel;
+  QSortFilterProxyModel *itemsProxy;
+  QTableView *totalsView;
+  MealTotalsModel *totalsModel;
+  QPushButton *removeButton;
   QPushButton *clearButton;
+  QPushButton *optimizeButton;
+  QDateEdit *logDateEdit;
+  QPushButton *logButton;
+  QPushButton *importButton;
+  QLabel *statusLabel;
 
-  std::vector<MealItem> mealItems;
-  FoodRepository repository;
+  MealTotals totals;
+  MealJournal *journal = nullptr;
+  QThread *importThread = nullptr;
+  QThread *optimizeThread = nullptr;
 };
 
 #endif // MEALWIDGET_H
@@ -0,0 +1,31 @@
+#ifndef NUTRIENTSMODEL_H
+#define NUTRIENTSMODEL_H
+
+#include "db/foodrepository.h"
+#include <QAbstractTableModel>
+
+// The nutrients of one food, named through the definitions table. Nothing
+// is formatted until the view paints a cell.
+class NutrientsModel : public QAbstractTableModel {
+  Q_OBJECT
+
+public:
+  enum Column { NameColumn, AmountColumn, UnitColumn, ColumnCount };
+
+  explicit NutrientsModel(QObject *parent = nullptr);
+
+  void setNutrients(FoodNutrients nutrients);
+
+  [[nodiscard]] int rowCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] int columnCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] QVariant data(const QModelIndex &index,
+                              int role = Qt::DisplayRole) const override;
+  [[nodiscard]] QVariant headerData(int section, Qt::Orientation orientation,
+                                    int role = Qt::DisplayRole) const override;
+
+private:
+  FoodNutrients m_nutrients;
+  const NutrientDefinitions *m_definitions = nullptr;
+};
+
+#endif // NUTRIENTSMODEL_H
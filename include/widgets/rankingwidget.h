@@ -0,0 +1,41 @@
+#ifndef RANKINGWIDGET_H
+#define RANKINGWIDGET_H
+
+#include "db/foodrepository.h"
+#include <QComboBox>
+#include <QLabel>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QWidget>
+
+// "Which foods are highest in X": the top foods for one nutrient, per 100 g
+// or per 100 kcal, optionally within one food group
+class RankingWidget : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit RankingWidget(QWidget *parent = nullptr);
+
+  // Fill in the nutrient and group choices once the food data is loaded,
+  // then rank with the current choices
+  void refresh();
+
+signals:
+  void foodSelected(int foodId, const QString &foodName);
+
+private slots:
+  void performRanking();
+  void onRowDoubleClicked(int row, int column);
+
+private:
+  void populateChoices();
+
+  QComboBox *nutrientCombo;
+  QComboBox *basisCombo;
+  QComboBox *groupCombo;
+  QSpinBox *limitSpin;
+  QLabel *statusLabel;
+  QTableWidget *resultsTable;
+};
+
+#endif // RANKINGWIDGET_H
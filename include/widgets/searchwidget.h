@@ -2,9 +2,14 @@
 #define SEARCHWIDGET_H
 
 #include "db/foodrepository.h"
+#include "db/searchworker.h"
+#include "widgets/foodresultsmodel.h"
+#include <QComboBox>
 #include <QLineEdit>
 #include <QPushButton>
-#include <QTableWidget>
+#include <QSortFilterProxyModel>
+#include <QTableView>
+#include <QThread>
 #include <QTimer>
 #include <QWidget>
 
@@ -13,20 +18,41 @@ class SearchWidget : public QWidget {
 
 public:
   explicit SearchWidget(QWidget *parent = nullptr);
+  ~SearchWidget() override;
 
 signals:
   void foodSelected(int foodId, const QString &foodName);
+  void searchRequested(int generation, const QString &query, int foodGroupId);
+  void facetsRequested(int generation, const QString &query);
 
 private slots:
   void performSearch();
-  void onRowDoubleClicked(int row, int column);
+  void onResultsReady(int generation, const std::vector<FoodItem> &results,
+                      bool isFinal);
+  void onFacetsReady(int generation, const std::vector<SearchFacet> &facets);
+  void onRowDoubleClicked(const QModelIndex &index);
 
 private:
+  void populateGroups();
+  // Asks for the match counts of the current search, once
+  void requestFacets();
+  // Back to plain group names, since the counts were of another search
+  void clearFacets();
+
   QLineEdit *searchInput;
+  QComboBox *groupCombo;
   QPushButton *searchButton;
-  QTableWidget *resultsTable;
-  FoodRepository repository;
+  QTableView *resultsView;
+  FoodResultsModel *resultsModel;
+  QSortFilterProxyModel *resultsProxy;
   QTimer *searchTimer;
+
+  QThread searchThread;
+  SearchWorker *searchWorker;
+  int currentGeneration = 0;
+  QString currentQuery;
+  int shownGeneration = 0; // Of the rows in the results view
+  int facetsGeneration = 0; // Of the counts asked for, or 0 if none
 };
 
 #endif // SEARCHWIDGET_H
@@ -0,0 +1,33 @@
+#ifndef SIMILARFOODSMODEL_H
+#define SIMILARFOODSMODEL_H
+
+#include "db/foodrepository.h"
+#include <QAbstractTableModel>
+#include <vector>
+
+// Foods closest to the one shown, closest first. Cells are produced when
+// the view paints them.
+class SimilarFoodsModel : public QAbstractTableModel {
+  Q_OBJECT
+
+public:
+  enum Column { DescriptionColumn, GroupColumn, DistanceColumn, ColumnCount };
+
+  explicit SimilarFoodsModel(QObject *parent = nullptr);
+
+  void setFoods(std::vector<SimilarFood> foods);
+  [[nodiscard]] const SimilarFood &food(int row) const { return m_foods[row]; }
+
+  [[nodiscard]] int rowCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] int columnCount(const QModelIndex &parent = {}) const override;
+  [[nodiscard]] QVariant data(const QModelIndex &index,
+                              int role = Qt::DisplayRole) const override;
+  [[nodiscard]] QVariant headerData(int section, Qt::Orientation orientation,
+                                    int role = Qt::DisplayRole) const override;
+
+private:
+  std::vector<SimilarFood> m_foods;
+  const FoodGroups *m_groups = nullptr;
+};
+
+#endif // SIMILARFOODSMODEL_H
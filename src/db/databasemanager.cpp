@@ -1,7 +1,73 @@
 #include "db/databasemanager.h"
 #include <QDebug>
 #include <QFileInfo>
+#include <QMutexLocker>
 #include <QSqlError>
+#include <QStringList>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QVariant>
+#include <algorithm>
+
+namespace {
+
+// Ids bound per execution of a batched lookup
+constexpr int kBatchSize = 64;
+
+QString databaseUri(const QString &path, bool immutable) {
+  QUrl url = QUrl::fromLocalFile(QFileInfo(path).absoluteFilePath());
+  QUrlQuery query;
+  query.addQueryItem("mode", "ro");
+  if (immutable)
+    query.addQueryItem("immutable", "1");
+  url.setQuery(query);
+  return url.toString(QUrl::FullyEncoded);
+}
+
+bool openWithProfile(QSqlDatabase &db, const QString &path,
+                     const ConnectionProfile &profile) {
+  db.setDatabaseName(databaseUri(path, profile.immutable));
+  db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_OPEN_URI");
+
+  if (!db.open()) {
+    qCritical() << "Error opening database:" << db.lastError().text();
+    return false;
+  }
+
+  const QStringList pragmas = {
+      QString("PRAGMA mmap_size = %1").arg(profile.mmapSize),
+      QString("PRAGMA cache_size = -%1").arg(profile.cacheSizeKiB),
+      QString("PRAGMA temp_store = %1")
+          .arg(profile.tempStoreMemory ? "MEMORY" : "DEFAULT"),
+      QString("PRAGMA query_only = %1").arg(profile.queryOnly ? 1 : 0)};
+  for (const QString &pragma : pragmas) {
+    QSqlQuery query(db);
+    if (!query.exec(pragma))
+      qWarning() << pragma << "failed:" << query.lastError().text();
+  }
+  return true;
+}
+
+} // namespace
+
+struct DatabaseManager::ThreadConnection {
+  QString name;
+  QSqlDatabase db;
+  // Nodes keep the queries at stable addresses
+  std::map<QString, QSqlQuery> statements;
+  std::atomic<int> *count = nullptr;
+
+  ~ThreadConnection() {
+    // Statements must go before the connection they were prepared on
+    statements.clear();
+    if (db.isOpen()) {
+      db.close();
+      --*count;
+    }
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+  }
+};
 
 DatabaseManager &DatabaseManager::instance() {
   static DatabaseManager instance;
@@ -10,14 +76,12 @@ DatabaseManager &DatabaseManager::instance() {
 
 DatabaseManager::DatabaseManager() = default;
 
-DatabaseManager::~DatabaseManager() {
-  if (m_db.isOpen()) {
-    m_db.close();
-  }
-}
+// Per-thread connections are closed by QThreadStorage as their threads end
+DatabaseManager::~DatabaseManager() = default;
 
-bool DatabaseManager::connect(const QString &path) {
-  if (m_db.isOpen()) {
+bool DatabaseManager::connect(const QString &path,
+                              const ConnectionProfile &profile) {
+  if (m_open) {
     return true;
   }
 
@@ -26,18 +90,144 @@ bool DatabaseManager::connect(const QString &path) {
     return false;
   }
 
-  m_db = QSqlDatabase::addDatabase("QSQLITE");
-  m_db.setDatabaseName(path);
-  m_db.setConnectOptions("QSQLITE_OPEN_READONLY");
+  {
+    QMutexLocker locker(&m_mutex);
+    m_path = path;
+    m_profile = profile;
+  }
 
-  if (!m_db.open()) {
-    qCritical() << "Error opening database:" << m_db.lastError().text();
+  // Drop any connection left from an earlier failed attempt
+  m_connections.setLocalData(nullptr);
+  m_open = true;
+  if (!localConnection()->db.isOpen()) {
+    m_open = false;
+    m_connections.setLocalData(nullptr);
     return false;
   }
 
   return true;
 }
 
-bool DatabaseManager::isOpen() const { return m_db.isOpen(); }
+bool DatabaseManager::isOpen() const { return m_open; }
+
+QString DatabaseManager::path() const {
+  QMutexLocker locker(&m_mutex);
+  return m_path;
+}
+
+QSqlDatabase DatabaseManager::database() const {
+  if (!m_open)
+    return {};
+  return localConnection()->db;
+}
+
+DatabaseManager::ThreadConnection *DatabaseManager::localConnection() const {
+  ThreadConnection *connection =
+      m_connections.hasLocalData() ? m_connections.localData() : nullptr;
+  if (connection != nullptr && connection->db.isOpen())
+    return connection;
+
+  if (connection == nullptr) {
+    static std::atomic<int> nextId{0};
+    connection = new ThreadConnection;
+    connection->name = QString("nutra-%1").arg(nextId++);
+    connection->count = &m_connectionCount;
+    connection->db = QSqlDatabase::addDatabase("QSQLITE", connection->name);
+    m_connections.setLocalData(connection);
+  }
 
-QSqlDatabase DatabaseManager::database() const { return m_db; }
+  // A connection that failed to open is retried on the next call, so a
+  // transient error doesn't stick to the thread
+  QString path;
+  ConnectionProfile profile;
+  {
+    QMutexLocker locker(&m_mutex);
+    path = m_path;
+    profile = m_profile;
+  }
+  if (openWithProfile(connection->db, path, profile))
+    ++m_connectionCount;
+  return connection;
+}
+
+QString DatabaseManager::settingsReport() const {
+  QSqlDatabase db = database();
+  if (!db.isOpen())
+    return "not connected";
+
+  QStringList settings;
+  for (const char *pragma :
+       {"mmap_size", "cache_size", "temp_store", "query_only"}) {
+    QSqlQuery query(db);
+    if (query.exec(QString("PRAGMA %1").arg(pragma)) && query.next())
+      settings << QString("%1=%2").arg(pragma, query.value(0).toString());
+  }
+
+  bool immutable = false;
+  {
+    QMutexLocker locker(&m_mutex);
+    immutable = m_profile.immutable;
+  }
+  settings << QString("immutable=%1").arg(immutable ? 1 : 0);
+  return settings.join(" ");
+}
+
+int DatabaseManager::connectionCount() const { return m_connectionCount; }
+
+QSqlQuery *DatabaseManager::cachedQuery(const QString &sql) {
+  return cachedStatement(sql, [&sql] { return sql; });
+}
+
+QSqlQuery *DatabaseManager::cachedStatement(
+    const QString &key, const std::function<QString()> &sql) {
+  if (!m_open)
+    return nullptr;
+
+  ThreadConnection *connection = localConnection();
+  auto it = connection->statements.find(key);
+  if (it == connection->statements.end()) {
+    QSqlQuery query(connection->db);
+    query.setForwardOnly(true);
+    if (!query.prepare(sql())) {
+      qCritical() << "Prepare failed:" << query.lastError().text();
+      return nullptr;
+    }
+    it = connection->statements.emplace(key, query).first;
+  }
+
+  it->second.finish();
+  return &it->second;
+}
+
+bool DatabaseManager::forEachRowIn(
+    const QString &sql, const std::vector<int> &ids,
+    const std::function<void(const QSqlQuery &)> &onRow) {
+  if (ids.empty())
+    return true;
+
+  QSqlQuery *query = cachedStatement(sql, [&sql] {
+    QStringList placeholders;
+    for (int i = 0; i < kBatchSize; ++i)
+      placeholders << "?";
+    return sql.arg(placeholders.join(","));
+  });
+  if (query == nullptr)
+    return false;
+
+  const auto count = static_cast<int>(ids.size());
+  for (int start = 0; start < count; start += kBatchSize) {
+    // A short last batch repeats its final id, which IN ignores
+    for (int i = 0; i < kBatchSize; ++i)
+      query->bindValue(i, ids[std::min(start + i, count - 1)]);
+
+    if (!query->exec()) {
+      qCritical() << "Batch query failed:" << query->lastError().text();
+      query->finish();
+      return false;
+    }
+    while (query->next())
+      onRow(*query);
+    query->finish();
+  }
+  return true;
+}
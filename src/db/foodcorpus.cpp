@@ -0,0 +1,122 @@
+#include "db/foodcorpus.h"
+#include "db/snapshotio.h"
+#include <algorithm>
+
+void FoodCorpus::clear() { *this = FoodCorpus(); }
+
+void FoodCorpus::append(int id, const QString &description,
+                        int foodGroupId) {
+  m_ids.push_back(id);
+  m_foodGroupIds.push_back(foodGroupId);
+
+  m_descriptions += description;
+  m_descriptionOffsets.push_back(static_cast<int>(m_descriptions.length()));
+
+  // Lowercasing can change the length, so it gets its own offsets
+  const int foldedStart = static_cast<int>(m_folded.length());
+  m_folded += description.toLower();
+  m_foldedOffsets.push_back(static_cast<int>(m_folded.length()));
+
+  const int foldedLength = static_cast<int>(m_folded.length()) - foldedStart;
+  m_scratchTokens.clear();
+  Utils::appendTokenSpans(m_folded.constData() + foldedStart, foldedLength,
+                          m_scratchTokens);
+  m_tokens.append(m_scratchTokens.begin(), m_scratchTokens.end());
+
+  m_foldedAscii.resize(foldedStart + foldedLength);
+  Utils::narrowToAscii(m_folded.constData() + foldedStart, foldedLength,
+                       m_foldedAscii.data() + foldedStart);
+  m_tokenOffsets.push_back(static_cast<int>(m_tokens.size()));
+}
+
+void FoodCorpus::squeeze() {
+  m_ids.shrink_to_fit();
+  m_foodGroupIds.shrink_to_fit();
+  m_descriptions.squeeze();
+  m_descriptionOffsets.shrink_to_fit();
+  m_folded.squeeze();
+  m_foldedAscii.squeeze();
+  m_foldedOffsets.shrink_to_fit();
+  m_tokens.shrink_to_fit();
+  m_tokenOffsets.shrink_to_fit();
+  m_scratchTokens = std::vector<Utils::TokenSpan>();
+}
+
+void FoodCorpus::writeTo(SnapshotWriter &writer) const {
+  writer.writeArray(m_ids);
+  writer.writeArray(m_foodGroupIds);
+  writer.writeString(m_descriptions);
+  writer.writeArray(m_descriptionOffsets);
+  writer.writeString(m_folded);
+  writer.writeArray(m_foldedOffsets);
+  writer.writeBytes(m_foldedAscii);
+  writer.writeArray(m_tokens);
+  writer.writeArray(m_tokenOffsets);
+}
+
+bool FoodCorpus::readFrom(SnapshotReader &reader) {
+  clear();
+  const bool read =
+      reader.readArray(m_ids) && reader.readArray(m_foodGroupIds) &&
+      reader.readString(m_descriptions) &&
+      reader.readArray(m_descriptionOffsets) && reader.readString(m_folded) &&
+      reader.readArray(m_foldedOffsets) && reader.readBytes(m_foldedAscii) &&
+      reader.readArray(m_tokens) && reader.readArray(m_tokenOffsets);
+
+  // Offsets are trusted from here on, so check they stay inside the arenas
+  const size_t count = m_ids.size();
+  auto validOffsets = [count](const Utils::PackedArray<int> &offsets,
+                              int arenaSize) {
+    if (offsets.size() != count + 1 || offsets[0] != 0 ||
+        offsets.back() != arenaSize)
+      return false;
+    for (size_t i = 0; i < count; ++i) {
+      if (offsets[i] > offsets[i + 1])
+        return false;
+    }
+    return true;
+  };
+  if (!read || m_foodGroupIds.size() != count ||
+      !validOffsets(m_descriptionOffsets,
+                    static_cast<int>(m_descriptions.length())) ||
+      !validOffsets(m_foldedOffsets, static_cast<int>(m_folded.length())) ||
+      m_foldedAscii.size() != m_folded.length() ||
+      !validOffsets(m_tokenOffsets, static_cast<int>(m_tokens.size()))) {
+    clear();
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (i > 0 && m_ids[i - 1] >= m_ids[i]) {
+      clear();
+      return false;
+    }
+    const int length = m_foldedOffsets[i + 1] - m_foldedOffsets[i];
+    for (int t = m_tokenOffsets[i]; t < m_tokenOffsets[i + 1]; ++t) {
+      if (m_tokens[t].start + m_tokens[t].length > length) {
+        clear();
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int FoodCorpus::indexOf(int id) const {
+  auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+  if (it == m_ids.end() || *it != id)
+    return -1;
+  return static_cast<int>(it - m_ids.begin());
+}
+
+QString FoodCorpus::description(int index) const {
+  const int start = m_descriptionOffsets[index];
+  return m_descriptions.mid(start, m_descriptionOffsets[index + 1] - start);
+}
+
+Utils::FoldedTextView FoodCorpus::folded(int index) const {
+  const int start = m_foldedOffsets[index];
+  const int tokenStart = m_tokenOffsets[index];
+  return {m_folded.constData() + start, m_foldedOffsets[index + 1] - start,
+          m_tokens.data() + tokenStart, m_tokenOffsets[index + 1] - tokenStart,
+          m_foldedAscii.constData() + start};
+}
@@ -0,0 +1,26 @@
+#include "db/foodgroups.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+bool FoodGroups::load(const QSqlDatabase &db) {
+  *this = FoodGroups();
+
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if (!query.exec("SELECT id, fdgrp_desc FROM fdgrp")) {
+    qWarning() << "Food group query failed:" << query.lastError().text();
+    return false;
+  }
+  while (query.next())
+    m_names.insert(query.value(0).toInt(), query.value(1).toString());
+  return true;
+}
+
+QString FoodGroups::name(int groupId) const {
+  auto it = m_names.constFind(groupId);
+  if (it != m_names.constEnd())
+    return it.value();
+  return QString("Group %1").arg(groupId);
+}
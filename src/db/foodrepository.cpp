@@ -1,177 +1,629 @@
 #include "db/foodrepository.h"
 #include "db/databasemanager.h"
+#include "db/fuzzysearchbackend.h"
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QStringList>
 #include <QVariant>
+#include <atomic>
+#include <functional>
+#include <limits>
 #include <map>
 
-FoodRepository::FoodRepository() {}
+FoodRepository &FoodRepository::instance() {
+  static FoodRepository instance;
+  return instance;
+}
+
+FoodRepository::FoodRepository()
+    : m_backend(std::make_shared<FuzzySearchBackend>()) {}
 
 #include "utils/string_utils.h"
 #include <algorithm>
 
-// ...
+namespace {
+
+std::vector<FoodItem> toFoodItems(const FoodSnapshot &snap,
+                                  const std::vector<SearchMatch> &scored) {
+  std::vector<FoodItem> items;
+  items.reserve(scored.size());
+  for (const auto &si : scored) {
+    FoodItem res;
+    res.id = si.id;
+    res.description = snap.corpus.description(si.index);
+    res.foodGroupId = snap.corpus.foodGroupId(si.index);
+    res.nutrientCount = snap.presence.count(si.index);
+    res.aminoCount = snap.presence.aminoAcidCount(si.index);
+    res.flavCount = snap.presence.flavonoidCount(si.index);
+    res.score = si.score;
+    items.push_back(res);
+  }
+  return items;
+}
+
+// What a lazy getFoodNutrients queried, owned by the FoodNutrients it
+// returns
+struct LazyNutrients {
+  std::vector<quint16> indices;
+  std::vector<double> amounts;
+};
+
+void appendNutrients(const NutrientStore &store, int foodId,
+                     std::vector<Nutrient> &out) {
+  const NutrientRow row = store.row(foodId);
+  out.reserve(out.size() + row.count);
+  for (int i = 0; i < row.count; ++i)
+    out.push_back({row.indices[i], row.amounts[i]});
+}
 
-void FoodRepository::ensureCacheLoaded() {
-  if (m_cacheLoaded)
+// From the store when nutrients are loaded, otherwise from a scan of the ids
+void buildPresence(const QSqlDatabase &db,
+                   const NutrientDefinitions &definitions,
+                   FoodSnapshot &snapshot) {
+  const FoodCorpus &corpus = snapshot.corpus;
+  NutrientPresence &presence = snapshot.presence;
+  presence.reset(corpus.size(), definitions);
+
+  if (!snapshot.nutrients.isEmpty()) {
+    for (int idx = 0; idx < corpus.size(); ++idx) {
+      const NutrientRow row = snapshot.nutrients.row(corpus.id(idx));
+      for (int i = 0; i < row.count; ++i)
+        presence.set(idx, row.indices[i]);
+    }
     return;
+  }
 
-  QSqlDatabase db = DatabaseManager::instance().database();
-  if (!db.isOpen())
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if (!query.exec("SELECT food_id, nutr_id FROM nut_data")) {
+    qCritical() << "Nutrient presence query failed:"
+                << query.lastError().text();
+    return;
+  }
+  while (query.next()) {
+    const int idx = corpus.indexOf(query.value(0).toInt());
+    const int definition = definitions.indexOf(query.value(1).toInt());
+    if (idx >= 0 && definition >= 0)
+      presence.set(idx, definition);
+  }
+}
+
+const NutrientDefinitions &emptyDefinitions() {
+  static const NutrientDefinitions empty;
+  return empty;
+}
+
+} // namespace
+
+void FoodRepository::setSearchThreadCount(int count) {
+  m_searchThreadCount = count;
+}
+
+void FoodRepository::setResultCacheCapacity(int capacity) {
+  m_resultCache.setCapacity(capacity);
+}
+
+const SearchCache &FoodRepository::resultCache() const { return m_resultCache; }
+
+std::shared_ptr<const FoodSnapshot> FoodRepository::snapshot() const {
+  return std::atomic_load(&m_snapshot);
+}
+
+void FoodRepository::ensureCacheLoaded(const LoadProgress &progress) {
+  if (snapshot())
+    return;
+
+  // Whoever loses the race waits for the winner's snapshot
+  QMutexLocker locker(&m_loadMutex);
+  if (snapshot())
     return;
 
-  // 1. Load Food Items
-  QSqlQuery query("SELECT id, long_desc, fdgrp_id FROM food_des", db);
-  std::map<int, int> nutrientCounts;
+  std::shared_ptr<const FoodSnapshot> loaded = loadSnapshot(progress);
+  if (loaded)
+    std::atomic_store(&m_snapshot, loaded);
+}
+
+LoadTimings FoodRepository::loadTimings() {
+  QMutexLocker locker(&m_loadMutex);
+  return m_loadTimings;
+}
+
+const NutrientDefinitions &FoodRepository::nutrientDefinitions() {
+  if (auto definitions = std::atomic_load(&m_definitions))
+    return *definitions;
+
+  QMutexLocker locker(&m_loadMutex);
+  return loadDefinitions();
+}
+
+const NutrientDefinitions &FoodRepository::loadDefinitions() {
+  if (m_definitions)
+    return *m_definitions;
+
+  QSqlDatabase db = DatabaseManager::instance().database();
+  auto loaded = std::make_shared<NutrientDefinitions>();
+  if (!db.isOpen() || !loaded->load(db))
+    return emptyDefinitions();
+
+  std::atomic_store(&m_definitions,
+                    std::shared_ptr<const NutrientDefinitions>(loaded));
+  return *loaded;
+}
+
+const FoodGroups &FoodRepository::foodGroups() {
+  static const FoodGroups unnamed;
+  if (auto groups = std::atomic_load(&m_foodGroups))
+    return *groups;
+
+  QMutexLocker locker(&m_loadMutex);
+  if (m_foodGroups)
+    return *m_foodGroups;
+
+  QSqlDatabase db = DatabaseManager::instance().database();
+  auto loaded = std::make_shared<FoodGroups>();
+  if (!db.isOpen() || !loaded->load(db))
+    return unnamed;
 
-  // 2. Load Nutrient Counts (Bulk)
-  QSqlQuery countQuery(
-      "SELECT food_id, count(*) FROM nut_data GROUP BY food_id", db);
-  while (countQuery.next()) {
-    nutrientCounts[countQuery.value(0).toInt()] = countQuery.value(1).toInt();
+  std::atomic_store(&m_foodGroups, std::shared_ptr<const FoodGroups>(loaded));
+  return *loaded;
+}
+
+std::shared_ptr<const FoodSnapshot>
+FoodRepository::loadSnapshot(const LoadProgress &progress) {
+  static std::atomic<quint64> nextGeneration{1};
+  constexpr int kSteps = 4;
+  auto report = [&progress](int step, const QString &label) {
+    if (progress)
+      progress(step, kSteps, label);
+  };
+
+  QSqlDatabase db = DatabaseManager::instance().database();
+  if (!db.isOpen())
+    return nullptr;
+
+  m_loadTimings = LoadTimings();
+  QElapsedTimer timer;
+
+  SnapshotKey key;
+  if (!m_snapshotPath.isEmpty()) {
+    report(0, "Opening search snapshot");
+    timer.start();
+    key = SnapshotKey::forDatabase(DatabaseManager::instance().path(),
+                                   loadDefinitions().size());
+    std::shared_ptr<FoodSnapshot> mapped =
+        FoodSnapshot::map(m_snapshotPath, key, !m_lazyNutrients);
+    m_loadTimings.snapshotMapMs = timer.elapsed();
+    if (mapped) {
+      mapped->generation = nextGeneration++;
+      report(kSteps, "Search snapshot mapped");
+      return mapped;
+    }
   }
 
+  auto loaded = std::make_shared<FoodSnapshot>();
+  loaded->generation = nextGeneration++;
+
+  // 1. Load Nutrients (unless they are loaded lazily)
+  report(0, "Loading nutrients");
+  timer.start();
+  const NutrientDefinitions &definitions = loadDefinitions();
+  if (!m_lazyNutrients)
+    loaded->nutrients.load(db, definitions);
+  m_loadTimings.nutrientLoadMs = timer.elapsed();
+
+  // 2. Load Food Items
+  report(1, "Loading foods");
+  timer.start();
+  QSqlQuery query("SELECT id, long_desc, fdgrp_id FROM food_des ORDER BY id",
+                  db);
   while (query.next()) {
-    FoodItem item;
-    item.id = query.value(0).toInt();
-    item.description = query.value(1).toString();
-    item.foodGroupId = query.value(2).toInt();
+    loaded->corpus.append(query.value(0).toInt(), query.value(1).toString(),
+                          query.value(2).toInt());
+  }
+  loaded->corpus.squeeze();
+  m_loadTimings.foodLoadMs = timer.elapsed();
+
+  // 3. Build the search index and the nutrient presence bits
+  report(2, "Building search index");
+  timer.start();
+  loaded->buildSearchIndex();
+  buildPresence(db, definitions, *loaded);
+  m_loadTimings.indexBuildMs = timer.elapsed();
+
+  if (!m_snapshotPath.isEmpty() && !key.hash.isEmpty()) {
+    report(3, "Saving search snapshot");
+    timer.start();
+    loaded->save(m_snapshotPath, key);
+    m_loadTimings.snapshotSaveMs = timer.elapsed();
+  }
+  report(kSteps, "Search cache loaded");
+  return loaded;
+}
 
-    // Set counts from map (default 0 if not found)
-    auto it = nutrientCounts.find(item.id);
-    item.nutrientCount = (it != nutrientCounts.end()) ? it->second : 0;
+QString LoadTimings::summary() const {
+  QStringList phases;
+  auto add = [&phases](const char *name, qint64 ms) {
+    if (ms >= 0)
+      phases << QString("%1 %2 ms").arg(name).arg(ms);
+  };
+  add("snapshot map", snapshotMapMs);
+  add("nutrient load", nutrientLoadMs);
+  add("food load", foodLoadMs);
+  add("index build", indexBuildMs);
+  add("snapshot save", snapshotSaveMs);
+  return phases.isEmpty() ? QString("not loaded") : phases.join(", ");
+}
 
-    item.aminoCount = 0; // TODO: Implement specific counts if needed
-    item.flavCount = 0;
-    item.score = 0;
-    m_cache.push_back(item);
-  }
-  m_cacheLoaded = true;
+void SearchSession::reset() {
+  query.clear();
+  survivors.clear();
+  ceiling = 0;
+  generation = 0;
+  foodGroupId = -1;
+  valid = false;
+}
+
+void FoodRepository::setSearchBackend(std::shared_ptr<SearchBackend> backend) {
+  std::atomic_store(&m_backend, std::move(backend));
+  // Rankings from the previous backend are no longer wanted
+  m_resultCache.clear();
 }
 
-std::vector<FoodItem> FoodRepository::searchFoods(const QString &query) {
+std::shared_ptr<SearchBackend> FoodRepository::searchBackend() const {
+  return std::atomic_load(&m_backend);
+}
+
+std::vector<FoodItem> FoodRepository::rankFoods(const QString &query,
+                                                SearchSession *session,
+                                                const SearchControl *control,
+                                                const SearchScope *scope) {
   ensureCacheLoaded();
   std::vector<FoodItem> results;
 
-  if (query.trimmed().isEmpty())
+  // Hold on to one snapshot for the whole search, even if a newer one lands
+  const std::shared_ptr<const FoodSnapshot> snap = snapshot();
+  if (!snap)
     return results;
 
-  // Calculate scores
-  // create a temporary list of pointers or indices to sort?
-  // Copying might be expensive if cache is huge (8k items is fine though)
+  // Equivalent spellings of a query share one ranking (and cache entry)
+  const QString normalized = Utils::normalizeQuery(query);
+  if (normalized.isEmpty())
+    return results;
 
-  // Let's iterate and keep top matches.
-  struct ScoredItem {
-    const FoodItem *item;
-    int score;
-  };
-  std::vector<ScoredItem> scoredItems;
-  scoredItems.reserve(m_cache.size());
+  const int foodGroupId = scope != nullptr ? scope->foodGroupId : -1;
+  std::vector<SearchFacet> *facets =
+      scope != nullptr ? scope->facets : nullptr;
+  std::vector<SearchFacet> rankedFacets;
+
+  // Backends rank differently, so each gets its own cache entries, as does
+  // each group filter
+  const std::shared_ptr<SearchBackend> backend = searchBackend();
+  const QString cacheKey = backend->name() + '\n' +
+                           QString::number(foodGroupId) + '\n' + normalized;
+  std::vector<SearchMatch> matches;
+  if (m_resultCache.lookup(cacheKey, snap->generation, matches,
+                           facets != nullptr ? &rankedFacets : nullptr)) {
+    if (facets != nullptr)
+      facets->swap(rankedFacets);
+    return toFoodItems(*snap, matches);
+  }
 
-  for (const auto &item : m_cache) {
-    int score = Utils::calculateFuzzyScore(query, item.description);
-    if (score > 40) { // Threshold
-      scoredItems.push_back({&item, score});
-    }
+  SearchRequest request;
+  request.snapshot = snap.get();
+  // Scored as typed: punctuation matters to exact and substring matches
+  request.query = query.trimmed().toLower();
+  request.threadCount = control != nullptr && control->threadCount > 0
+                            ? control->threadCount
+                            : m_searchThreadCount.load();
+  request.session = session;
+  request.foodGroupId = foodGroupId;
+  // Counting needs every match, not just the best, so only when asked
+  if (facets != nullptr)
+    request.facets = &rankedFacets;
+  if (control != nullptr && control->isCancelled)
+    request.isCancelled = &control->isCancelled;
+  if (control != nullptr && control->onPartialResults) {
+    request.onPartialMatches = [&](const std::vector<SearchMatch> &head) {
+      control->onPartialResults(toFoodItems(*snap, head));
+    };
   }
 
-  // Sort by score desc
-  std::sort(scoredItems.begin(), scoredItems.end(),
-            [](const ScoredItem &a, const ScoredItem &b) {
-              return a.score > b.score;
-            });
+  if (!backend->rank(request, matches)) {
+    if (request.isCancelled != nullptr && (*request.isCancelled)())
+      return results;
+    // The backend failed, e.g. FTS5 is missing. Rank in memory instead, and
+    // leave it out of the cache so the backend gets another chance.
+    FuzzySearchBackend fallback;
+    if (!fallback.rank(request, matches))
+      return results;
+    if (facets != nullptr)
+      facets->swap(rankedFacets);
+    return toFoodItems(*snap, matches);
+  }
+
+  m_resultCache.insert(cacheKey, snap->generation, matches, request.facets);
+  if (facets != nullptr)
+    facets->swap(rankedFacets);
+  return toFoodItems(*snap, matches);
+}
+
+std::vector<FoodItem> FoodRepository::searchFoods(const QString &query,
+                                                  SearchSession *session,
+                                                  const SearchScope *scope) {
+  std::vector<FoodItem> results = rankFoods(query, session, nullptr, scope);
+
+  const std::shared_ptr<const FoodSnapshot> snap = snapshot();
+  if (snap && !snap->nutrients.isEmpty()) {
+    for (auto &res : results)
+      appendNutrients(snap->nutrients, res.id, res.nutrients);
+    return results;
+  }
 
-  // Take top 100
-  int count = 0;
   std::vector<int> resultIds;
   std::map<int, int> idToIndex;
-
-  for (const auto &si : scoredItems) {
-    if (count >= 100)
-      break;
-    FoodItem res = *si.item;
-    res.score = si.score;
-    // We will populate nutrients shortly
-    results.push_back(res);
-    resultIds.push_back(res.id);
-    idToIndex[res.id] = count;
-    count++;
+  for (int i = 0; i < static_cast<int>(results.size()); ++i) {
+    resultIds.push_back(results[i].id);
+    idToIndex[results[i].id] = i;
   }
 
   // Batch fetch nutrients for these results
   if (!resultIds.empty()) {
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QStringList idStrings;
-    for (int id : resultIds)
-      idStrings << QString::number(id);
-
-    QString sql =
-        QString("SELECT n.food_id, n.nutr_id, n.nutr_val, d.nutr_desc, d.unit "
-                "FROM nut_data n "
-                "JOIN nutr_def d ON n.nutr_id = d.id "
-                "WHERE n.food_id IN (%1)")
-            .arg(idStrings.join(","));
-
-    QSqlQuery nutQuery(sql, db);
-    while (nutQuery.next()) {
-      int fid = nutQuery.value(0).toInt();
-      Nutrient nut;
-      nut.id = nutQuery.value(1).toInt();
-      nut.amount = nutQuery.value(2).toDouble();
-      nut.description = nutQuery.value(3).toString();
-      nut.unit = nutQuery.value(4).toString();
-      nut.rdaPercentage = 0.0;
-
-      if (idToIndex.count(fid) != 0U) {
-        results[idToIndex[fid]].nutrients.push_back(nut);
-      }
-    }
-
-    // Update counts based on actual data
-    for (auto &res : results) {
-      res.nutrientCount = static_cast<int>(res.nutrients.size());
-      // TODO: Logic for amino/flav counts if we have ranges of IDs
-    }
+    const NutrientDefinitions &definitions = nutrientDefinitions();
+    DatabaseManager::instance().forEachRowIn(
+        "SELECT food_id, nutr_id, nutr_val FROM nut_data "
+        "WHERE food_id IN (%1)",
+        resultIds, [&](const QSqlQuery &nutQuery) {
+          int fid = nutQuery.value(0).toInt();
+          const int index = definitions.indexOf(nutQuery.value(1).toInt());
+          if (index < 0)
+            return;
+
+          if (idToIndex.count(fid) != 0U) {
+            results[idToIndex[fid]].nutrients.push_back(
+                {static_cast<quint16>(index), nutQuery.value(2).toDouble()});
+          }
+        });
   }
 
   return results;
 }
 
-std::vector<Nutrient> FoodRepository::getFoodNutrients(int foodId) {
-  std::vector<Nutrient> results;
-  QSqlDatabase db = DatabaseManager::instance().database();
+void FoodRepository::setLazyNutrients(bool lazy) { m_lazyNutrients = lazy; }
 
-  if (!db.isOpen())
-    return results;
+void FoodRepository::setSnapshotPath(const QString &path) {
+  QMutexLocker locker(&m_loadMutex);
+  m_snapshotPath = path;
+}
 
-  QSqlQuery query(db);
-  if (!query.prepare("SELECT n.nutr_id, n.nutr_val, d.nutr_desc, d.unit "
-                     "FROM nut_data n "
-                     "JOIN nutr_def d ON n.nutr_id = d.id "
-                     "WHERE n.food_id = ?")) {
+bool FoodRepository::lazyNutrients() const { return m_lazyNutrients; }
 
-    qCritical() << "Prepare failed:" << query.lastError().text();
-    return results;
+std::vector<int>
+FoodRepository::foodsReporting(const std::vector<int> &nutrientIds) {
+  ensureCacheLoaded();
+  std::vector<int> ids;
+  const std::shared_ptr<const FoodSnapshot> snap = snapshot();
+  if (!snap)
+    return ids;
+
+  // Unknown ids map to -1, which no food reports
+  const NutrientDefinitions &definitions = nutrientDefinitions();
+  std::vector<int> indices;
+  indices.reserve(nutrientIds.size());
+  for (int nutrientId : nutrientIds)
+    indices.push_back(definitions.indexOf(nutrientId));
+
+  const std::vector<int> foods = snap->presence.foodsReportingAll(indices);
+  ids.reserve(foods.size());
+  for (int idx : foods)
+    ids.push_back(snap->corpus.id(idx));
+  return ids;
+}
+
+void FoodRepository::dropStaleColumns(const FoodSnapshot &snap) {
+  if (m_columnGeneration != snap.generation) {
+    m_columns.clear();
+    m_profiles.clear();
+    m_columnGeneration = snap.generation;
+  }
+}
+
+std::shared_ptr<const NutrientColumn>
+FoodRepository::nutrientColumn(const FoodSnapshot &snap, int definition) {
+  if (definition < 0 || definition >= nutrientDefinitions().size())
+    return nullptr;
+
+  QMutexLocker locker(&m_columnMutex);
+  dropStaleColumns(snap);
+  auto it = m_columns.find(definition);
+  if (it != m_columns.end())
+    return it->second;
+
+  const FoodCorpus &corpus = snap.corpus;
+  std::vector<double> amounts(corpus.size(),
+                              std::numeric_limits<double>::quiet_NaN());
+  if (!snap.nutrients.isEmpty()) {
+    for (int idx = 0; idx < corpus.size(); ++idx) {
+      if (!snap.presence.reports(idx, definition))
+        continue;
+      const NutrientRow row = snap.nutrients.row(corpus.id(idx));
+      const quint16 *end = row.indices + row.count;
+      const quint16 *found = std::lower_bound(row.indices, end, definition);
+      if (found != end && *found == definition)
+        amounts[idx] = row.amounts[found - row.indices];
+    }
+  } else {
+    QSqlQuery *query = DatabaseManager::instance().cachedQuery(
+        "SELECT food_id, nutr_val FROM nut_data WHERE nutr_id = ?");
+    if (query == nullptr)
+      return nullptr;
+    query->bindValue(0, nutrientDefinitions().at(definition).id);
+    if (!query->exec()) {
+      qCritical() << "Nutrient column query failed:"
+                  << query->lastError().text();
+      return nullptr;
+    }
+    while (query->next()) {
+      const int idx = corpus.indexOf(query->value(0).toInt());
+      if (idx >= 0)
+        amounts[idx] = query->value(1).toDouble();
+    }
+    query->finish();
   }
 
-  query.bindValue(0, foodId);
+  auto column = std::make_shared<const NutrientColumn>(std::move(amounts));
+  m_columns[definition] = column;
+  return column;
+}
+
+std::vector<RankedFood>
+FoodRepository::topFoodsByNutrient(const NutrientRankingQuery &query) {
+  ensureCacheLoaded();
+  const std::shared_ptr<const FoodSnapshot> snap = snapshot();
+  if (!snap)
+    return {};
+
+  const NutrientDefinitions &definitions = nutrientDefinitions();
+  const std::shared_ptr<const NutrientColumn> column =
+      nutrientColumn(*snap, definitions.indexOf(query.nutrientId));
+  if (!column)
+    return {};
+
+  std::shared_ptr<const NutrientColumn> energy;
+  if (query.basis == NutrientBasis::Per100Kcal)
+    energy = nutrientColumn(*snap, definitions.indexOf(208));
+  return rankByNutrient(snap->corpus, *column, energy.get(), query);
+}
 
-  if (query.exec()) {
+std::shared_ptr<const NutrientProfiles>
+FoodRepository::nutrientProfiles(const FoodSnapshot &snap,
+                                 NutrientBasis basis) {
+  const NutrientDefinitions &definitions = nutrientDefinitions();
+
+  {
+    QMutexLocker locker(&m_columnMutex);
+    dropStaleColumns(snap);
+    auto it = m_profiles.find(basis);
+    if (it != m_profiles.end())
+      return it->second;
+  }
+
+  // Built without the lock, which would otherwise stall every column lookup
+  // for the seconds this can take. Two threads may race to build the same
+  // profiles; the first to finish is kept.
+
+  // Nutrients hardly any food reports would only widen every row
+  const FoodCorpus &corpus = snap.corpus;
+  const int minFoods = std::max(1, corpus.size() / 100);
+  std::vector<int> profiled;
+  for (int definition = 0; definition < definitions.size(); ++definition) {
+    if (snap.presence.countReportingAll({definition}) >= minFoods)
+      profiled.push_back(definition);
+  }
+
+  auto profiles = std::make_shared<NutrientProfiles>();
+  profiles->reset(corpus.size(), profiled, basis, definitions.indexOf(208));
+  if (!snap.nutrients.isEmpty()) {
+    for (int idx = 0; idx < corpus.size(); ++idx) {
+      const NutrientRow row = snap.nutrients.row(corpus.id(idx));
+      for (int i = 0; i < row.count; ++i)
+        profiles->set(idx, row.indices[i], row.amounts[i]);
+    }
+  } else {
+    QSqlQuery query(DatabaseManager::instance().database());
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT food_id, nutr_id, nutr_val FROM nut_data")) {
+      qCritical() << "Nutrient profile query failed:"
+                  << query.lastError().text();
+      return nullptr;
+    }
     while (query.next()) {
-      Nutrient nut;
-      nut.id = query.value(0).toInt();
-      nut.amount = query.value(1).toDouble();
-      nut.description = query.value(2).toString();
-      nut.unit = query.value(3).toString();
-      nut.rdaPercentage = 0.0;
-
-      results.push_back(nut);
+      const int idx = corpus.indexOf(query.value(0).toInt());
+      const int definition = definitions.indexOf(query.value(1).toInt());
+      if (idx >= 0 && definition >= 0)
+        profiles->set(idx, definition, query.value(2).toDouble());
     }
+  }
+  profiles->finish();
+  if (corpus.size() >= NutrientProfiles::kIndexThreshold)
+    profiles->buildIndex();
+
+  QMutexLocker locker(&m_columnMutex);
+  // A newer snapshot's caches are not ours to replace
+  if (m_columnGeneration != snap.generation)
+    return profiles;
+  return m_profiles.emplace(basis, std::move(profiles)).first->second;
+}
+
+std::vector<SimilarFood>
+FoodRepository::similarFoods(const SimilarityQuery &query) {
+  ensureCacheLoaded();
+  const std::shared_ptr<const FoodSnapshot> snap = snapshot();
+  if (!snap)
+    return {};
+  const std::shared_ptr<const NutrientProfiles> profiles =
+      nutrientProfiles(*snap, query.basis);
+  if (!profiles)
+    return {};
+
+  const FoodCorpus &corpus = snap->corpus;
+  std::vector<int> members;
+  if (query.foodGroupId >= 0)
+    members = snap->groupMembers(query.foodGroupId);
+  const std::vector<NutrientProfiles::Neighbour> neighbours =
+      profiles->nearest(corpus.indexOf(query.foodId), query.metric,
+                        query.limit,
+                        query.foodGroupId >= 0 ? &members : nullptr,
+                        query.exact);
+
+  std::vector<SimilarFood> similar;
+  similar.reserve(neighbours.size());
+  for (const NutrientProfiles::Neighbour &neighbour : neighbours) {
+    similar.push_back({corpus.id(neighbour.food),
+                       corpus.description(neighbour.food),
+                       corpus.foodGroupId(neighbour.food),
+                       neighbour.distance});
+  }
+  return similar;
+}
+
+FoodNutrients FoodRepository::getFoodNutrients(int foodId) {
+  const std::shared_ptr<const FoodSnapshot> snap = snapshot();
+  if (snap && !snap->nutrients.isEmpty())
+    return {snap, snap->nutrients.row(foodId)};
+
+  const NutrientDefinitions &definitions = nutrientDefinitions();
+  DatabaseManager &manager = DatabaseManager::instance();
+
+  if (!manager.isOpen())
+    return {};
+
+  QSqlQuery *query = manager.cachedQuery("SELECT nutr_id, nutr_val "
+                                         "FROM nut_data WHERE food_id = ?");
+  if (query == nullptr)
+    return {};
+
+  query->bindValue(0, foodId);
+
+  auto lazy = std::make_shared<LazyNutrients>();
+  if (query->exec()) {
+    while (query->next()) {
+      const int index = definitions.indexOf(query->value(0).toInt());
+      if (index < 0)
+        continue;
+
+      lazy->indices.push_back(static_cast<quint16>(index));
+      lazy->amounts.push_back(query->value(1).toDouble());
+    }
+    query->finish();
 
   } else {
-    qCritical() << "Nutrient query failed:" << query.lastError().text();
+    qCritical() << "Nutrient query failed:" << query->lastError().text();
   }
 
-  return results;
+  const NutrientRow row{lazy->indices.data(), lazy->amounts.data(),
+                        static_cast<int>(lazy->indices.size())};
+  return {std::move(lazy), row};
 }
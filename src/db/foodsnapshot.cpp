@@ -0,0 +1,284 @@
+#include "db/foodsnapshot.h"
+#include "db/snapshotio.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+constexpr quint64 kMagic = 0x50414E535254554EULL; // "NUTRSNAP"
+// Bump whenever the layout of anything written below changes
+constexpr quint32 kVersion = 5;
+constexpr quint32 kByteOrderMark = 0x01020304;
+constexpr quint32 kHasNutrients = 0x1;
+constexpr quint64 kEndMarker = ~kMagic;
+constexpr qint64 kHashedBlockSize = 64 * 1024;
+
+template <typename Key>
+bool validPostings(const Utils::PackedArray<Key> &keys,
+                   const Utils::PackedArray<int> &offsets,
+                   const Utils::PackedArray<int> &postings, int corpusSize) {
+  if (offsets.size() != keys.size() + 1 || offsets[0] != 0 ||
+      offsets.back() != static_cast<int>(postings.size()))
+    return false;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if ((i > 0 && keys[i - 1] >= keys[i]) || offsets[i] > offsets[i + 1])
+      return false;
+  }
+  for (int idx : postings) {
+    if (idx < 0 || idx >= corpusSize)
+      return false;
+  }
+  return true;
+}
+
+// Fills keys, offsets and postings from (key, corpus index) pairs
+template <typename Key>
+void buildPostings(std::vector<std::pair<Key, int>> &entries,
+                   Utils::PackedArray<Key> &keys,
+                   Utils::PackedArray<int> &offsets,
+                   Utils::PackedArray<int> &postings) {
+  // Sorting by (key, index) groups each key's postings, in ascending order
+  std::sort(entries.begin(), entries.end());
+
+  keys = {};
+  offsets = {0};
+  postings = {};
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (i == 0 || entries[i - 1].first != entries[i].first) {
+      if (i != 0)
+        offsets.push_back(static_cast<int>(i));
+      keys.push_back(entries[i].first);
+    }
+    postings.push_back(entries[i].second);
+  }
+  if (!entries.empty())
+    offsets.push_back(static_cast<int>(entries.size()));
+}
+
+} // namespace
+
+SnapshotKey SnapshotKey::forDatabase(const QString &path,
+                                     int definitionCount) {
+  SnapshotKey key;
+  key.definitionCount = definitionCount;
+
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+    return key;
+
+  const QFileInfo info(file);
+  key.fileSize = static_cast<quint64>(info.size());
+  key.modifiedMs = info.lastModified().toMSecsSinceEpoch();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(file.read(kHashedBlockSize));
+  if (info.size() > kHashedBlockSize) {
+    file.seek(std::max(kHashedBlockSize, info.size() - kHashedBlockSize));
+    hash.addData(file.read(kHashedBlockSize));
+  }
+  key.hash = hash.result();
+  return key;
+}
+
+bool SnapshotKey::operator==(const SnapshotKey &other) const {
+  return fileSize == other.fileSize && modifiedMs == other.modifiedMs &&
+         hash == other.hash && definitionCount == other.definitionCount;
+}
+
+void FoodSnapshot::buildSearchIndex() {
+  std::vector<std::pair<quint64, int>> entries;
+  std::vector<quint64> keys;
+  for (int idx = 0; idx < corpus.size(); ++idx) {
+    keys.clear();
+    const Utils::FoldedTextView text = corpus.folded(idx);
+    for (int t = 0; t < text.tokenCount; ++t)
+      Utils::appendTrigramKeys(text.text + text.tokens[t].start,
+                               text.tokens[t].length, keys);
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (quint64 key : keys)
+      entries.emplace_back(key, idx);
+  }
+
+  buildPostings(entries, trigramKeys, trigramOffsets, trigramPostings);
+
+  std::vector<std::pair<int, int>> groups;
+  groups.reserve(corpus.size());
+  for (int idx = 0; idx < corpus.size(); ++idx)
+    groups.emplace_back(corpus.foodGroupId(idx), idx);
+  buildPostings(groups, groupIds, groupOffsets, groupPostings);
+}
+
+int FoodSnapshot::groupSlot(int foodGroupId) const {
+  auto it = std::lower_bound(groupIds.begin(), groupIds.end(), foodGroupId);
+  if (it == groupIds.end() || *it != foodGroupId)
+    return -1;
+  return static_cast<int>(it - groupIds.begin());
+}
+
+std::vector<int> FoodSnapshot::groupMembers(int foodGroupId) const {
+  const int slot = groupSlot(foodGroupId);
+  if (slot < 0)
+    return {};
+  return std::vector<int>(groupPostings.begin() + groupOffsets[slot],
+                          groupPostings.begin() + groupOffsets[slot + 1]);
+}
+
+bool FoodSnapshot::collectCandidates(const Utils::FuzzyQuery &query,
+                                     int threshold,
+                                     std::vector<int> &candidates) const {
+  // Only a guaranteed number of shared trigrams makes the index a complete
+  // filter; one shared trigram is not enough, since spaced-out typos can
+  // leave none and still score above the threshold
+  const int minShared = Utils::minSharedTrigrams(query, threshold);
+  if (minShared <= 0)
+    return false;
+
+  std::vector<quint64> keys;
+  for (const Utils::TokenSpan &token : query.tokens)
+    Utils::appendTrigramKeys(query.text.constData() + token.start,
+                             token.length, keys);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  // Each posting list holds a food once, so a food appears once per
+  // distinct query trigram it contains
+  std::vector<int> hits;
+  for (quint64 key : keys) {
+    auto it = std::lower_bound(trigramKeys.begin(), trigramKeys.end(), key);
+    if (it == trigramKeys.end() || *it != key)
+      continue;
+    const auto slot = static_cast<size_t>(it - trigramKeys.begin());
+    hits.insert(hits.end(), trigramPostings.begin() + trigramOffsets[slot],
+                trigramPostings.begin() + trigramOffsets[slot + 1]);
+  }
+  std::sort(hits.begin(), hits.end());
+
+  candidates.clear();
+  for (size_t i = 0; i < hits.size();) {
+    size_t end = i + 1;
+    while (end < hits.size() && hits[end] == hits[i])
+      ++end;
+    if (static_cast<int>(end - i) >= minShared)
+      candidates.push_back(hits[i]);
+    i = end;
+  }
+  return true;
+}
+
+bool FoodSnapshot::save(const QString &path, const SnapshotKey &key) const {
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << "Cannot write search snapshot:" << file.errorString();
+    return false;
+  }
+
+  SnapshotWriter writer(&file);
+  writer.writeValue(kMagic);
+  writer.writeValue(kVersion);
+  writer.writeValue(kByteOrderMark);
+  writer.writeValue(nutrients.isEmpty() ? 0U : kHasNutrients);
+  writer.writeValue(qint32(key.definitionCount));
+  writer.writeValue(key.fileSize);
+  writer.writeValue(key.modifiedMs);
+  writer.writeBytes(key.hash);
+
+  corpus.writeTo(writer);
+  presence.writeTo(writer);
+  if (!nutrients.isEmpty())
+    nutrients.writeTo(writer);
+  writer.writeArray(trigramKeys);
+  writer.writeArray(trigramOffsets);
+  writer.writeArray(trigramPostings);
+  writer.writeArray(groupIds);
+  writer.writeArray(groupOffsets);
+  writer.writeArray(groupPostings);
+  writer.writeValue(kEndMarker);
+
+  if (!writer.ok() || !file.commit()) {
+    qWarning() << "Cannot write search snapshot:" << file.errorString();
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<FoodSnapshot> FoodSnapshot::map(const QString &path,
+                                                const SnapshotKey &key,
+                                                bool withNutrients) {
+  if (key.hash.isEmpty())
+    return nullptr;
+
+  auto file = std::make_shared<QFile>(path);
+  if (!file->open(QIODevice::ReadOnly))
+    return nullptr;
+  const qint64 size = file->size();
+  const uchar *data = file->map(0, size);
+  if (data == nullptr)
+    return nullptr;
+
+  // The header is checked before trusting anything after it
+  SnapshotReader reader(data, size);
+  quint64 magic = 0;
+  quint32 version = 0;
+  quint32 byteOrder = 0;
+  quint32 flags = 0;
+  qint32 definitionCount = 0;
+  SnapshotKey stored;
+  if (!reader.readValue(magic) || magic != kMagic ||
+      !reader.readValue(version) || version != kVersion ||
+      !reader.readValue(byteOrder) || byteOrder != kByteOrderMark ||
+      !reader.readValue(flags) || !reader.readValue(definitionCount) ||
+      !reader.readValue(stored.fileSize) ||
+      !reader.readValue(stored.modifiedMs) || !reader.readBytes(stored.hash))
+    return nullptr;
+  stored.definitionCount = definitionCount;
+  if (!(stored == key))
+    return nullptr;
+
+  const bool hasNutrients = (flags & kHasNutrients) != 0;
+  if (withNutrients && !hasNutrients)
+    return nullptr;
+
+  auto snapshot = std::make_shared<FoodSnapshot>();
+  snapshot->mapping = file;
+  if (!snapshot->corpus.readFrom(reader) ||
+      !snapshot->presence.readFrom(reader, snapshot->corpus.size(),
+                                   key.definitionCount))
+    return nullptr;
+  if (hasNutrients) {
+    // Skipping still has to walk past the arrays
+    NutrientStore skipped;
+    NutrientStore &store = withNutrients ? snapshot->nutrients : skipped;
+    if (!store.readFrom(reader, key.definitionCount))
+      return nullptr;
+  }
+
+  quint64 endMarker = 0;
+  if (!reader.readArray(snapshot->trigramKeys) ||
+      !reader.readArray(snapshot->trigramOffsets) ||
+      !reader.readArray(snapshot->trigramPostings) ||
+      !reader.readArray(snapshot->groupIds) ||
+      !reader.readArray(snapshot->groupOffsets) ||
+      !reader.readArray(snapshot->groupPostings) ||
+      !reader.readValue(endMarker) || endMarker != kEndMarker ||
+      !reader.atEnd())
+    return nullptr;
+
+  const int corpusSize = snapshot->corpus.size();
+  if (!validPostings(snapshot->trigramKeys, snapshot->trigramOffsets,
+                     snapshot->trigramPostings, corpusSize) ||
+      !validPostings(snapshot->groupIds, snapshot->groupOffsets,
+                     snapshot->groupPostings, corpusSize))
+    return nullptr;
+
+  return snapshot;
+}
@@ -0,0 +1,260 @@
+#include "db/ftssearchbackend.h"
+#include "db/databasemanager.h"
+#include "utils/string_utils.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QVariant>
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Bumped when the index schema changes, which forces a rebuild
+constexpr int kIndexVersion = 2;
+
+} // namespace
+
+struct FtsSearchBackend::ThreadConnection {
+  QString name;
+  QSqlDatabase db;
+  // Prepared on first use
+  QSqlQuery search;
+  QSqlQuery facets;
+  bool prepared = false;
+
+  ~ThreadConnection() {
+    search = QSqlQuery();
+    facets = QSqlQuery();
+    db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+  }
+};
+
+FtsSearchBackend::FtsSearchBackend(QString indexPath)
+    : m_path(std::move(indexPath)) {}
+
+// Other threads' connections are closed by QThreadStorage as they finish
+FtsSearchBackend::~FtsSearchBackend() { m_connections.setLocalData(nullptr); }
+
+QString FtsSearchBackend::matchExpression(const QString &query) {
+  QStringList terms;
+  for (QString token : query.split(' ')) {
+    if (token.isEmpty())
+      continue;
+    token.replace('"', "\"\"");
+    terms << '"' + token + "\"*";
+  }
+  return terms.join(' ');
+}
+
+QSqlDatabase FtsSearchBackend::connection() {
+  if (m_connections.hasLocalData() && m_connections.localData() != nullptr)
+    return m_connections.localData()->db;
+
+  static std::atomic<int> nextId{0};
+  auto *connection = new ThreadConnection;
+  connection->name = QString("nutra-fts-%1").arg(nextId++);
+  connection->db = QSqlDatabase::addDatabase("QSQLITE", connection->name);
+  connection->db.setDatabaseName(m_path);
+  // Another thread may be rebuilding the index
+  connection->db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+  QDir().mkpath(QFileInfo(m_path).absolutePath());
+  if (!connection->db.open()) {
+    qWarning() << "Cannot open search index:"
+               << connection->db.lastError().text();
+  }
+
+  m_connections.setLocalData(connection);
+  return connection->db;
+}
+
+bool FtsSearchBackend::ensureIndex(const FoodSnapshot &snapshot) {
+  if (m_indexedGeneration == snapshot.generation)
+    return true;
+
+  QMutexLocker locker(&m_buildMutex);
+  if (m_indexedGeneration == snapshot.generation)
+    return true;
+
+  QSqlDatabase db = connection();
+  if (!db.isOpen())
+    return false;
+
+  // Identifies the USDA database (and corpus) the index was built from
+  const SnapshotKey key =
+      SnapshotKey::forDatabase(DatabaseManager::instance().path(), 0);
+  const QString source = QString("%1:%2:%3:%4:%5")
+                             .arg(kIndexVersion)
+                             .arg(key.fileSize)
+                             .arg(key.modifiedMs)
+                             .arg(QString::fromLatin1(key.hash.toHex()))
+                             .arg(snapshot.corpus.size());
+
+  QSqlQuery query(db);
+  const bool current =
+      query.exec("SELECT value FROM meta WHERE key = 'source'") &&
+      query.next() && query.value(0).toString() == source;
+  query.finish();
+  if (!current && !buildIndex(db, snapshot, source))
+    return false;
+
+  m_indexedGeneration = snapshot.generation;
+  return true;
+}
+
+bool FtsSearchBackend::buildIndex(QSqlDatabase &db,
+                                  const FoodSnapshot &snapshot,
+                                  const QString &source) {
+  qDebug() << "Building FTS5 search index at" << m_path;
+  if (!db.transaction()) {
+    qWarning() << "Cannot build search index:" << db.lastError().text();
+    return false;
+  }
+
+  QSqlQuery query(db);
+  auto fail = [&db, &query] {
+    qWarning() << "Cannot build search index:" << query.lastError().text();
+    query.finish();
+    db.rollback();
+    return false;
+  };
+
+  // Contentless: descriptions come from the snapshot, the index only needs
+  // to map tokens to food ids (the rowids). Group filters and facet counts
+  // join the matches with a copy of each food's group.
+  for (const char *sql :
+       {"DROP TABLE IF EXISTS food_fts", "DROP TABLE IF EXISTS food_group",
+        "DROP TABLE IF EXISTS meta",
+        "CREATE VIRTUAL TABLE food_fts USING fts5(long_desc, content='', "
+        "prefix='2 3')",
+        "CREATE TABLE food_group(food_id INTEGER PRIMARY KEY, "
+        "food_group_id INTEGER NOT NULL)",
+        "CREATE TABLE meta(key TEXT PRIMARY KEY, value TEXT)"}) {
+    if (!query.exec(sql))
+      return fail();
+  }
+
+  const FoodCorpus &corpus = snapshot.corpus;
+  if (!query.prepare("INSERT INTO food_fts(rowid, long_desc) VALUES (?, ?)"))
+    return fail();
+  for (int idx = 0; idx < corpus.size(); ++idx) {
+    query.bindValue(0, corpus.id(idx));
+    query.bindValue(1, corpus.description(idx));
+    if (!query.exec())
+      return fail();
+  }
+  if (!query.prepare("INSERT INTO food_group(food_id, food_group_id) "
+                     "VALUES (?, ?)"))
+    return fail();
+  for (int idx = 0; idx < corpus.size(); ++idx) {
+    query.bindValue(0, corpus.id(idx));
+    query.bindValue(1, corpus.foodGroupId(idx));
+    if (!query.exec())
+      return fail();
+  }
+
+  if (!query.prepare("INSERT INTO meta(key, value) VALUES ('source', ?)"))
+    return fail();
+  query.bindValue(0, source);
+  if (!query.exec())
+    return fail();
+
+  query.finish();
+  return db.commit();
+}
+
+bool FtsSearchBackend::unavailable(const QString &reason) {
+  // Every search would fail the same way; say so once
+  if (!m_warned.exchange(true))
+    qWarning() << "FTS5 search unavailable, searching in memory instead:"
+               << reason;
+  return false;
+}
+
+bool FtsSearchBackend::rank(const SearchRequest &request,
+                            std::vector<SearchMatch> &matches) {
+  matches.clear();
+  // Nothing to refine: every query is a single indexed lookup
+  if (request.session != nullptr)
+    request.session->reset();
+
+  const QString expression =
+      matchExpression(Utils::normalizeQuery(request.query));
+  if (expression.isEmpty())
+    return true;
+  if (!ensureIndex(*request.snapshot))
+    return unavailable("the index could not be built");
+  if (request.isCancelled != nullptr && (*request.isCancelled)())
+    return false;
+
+  QSqlDatabase db = connection();
+  ThreadConnection *local = m_connections.localData();
+  if (!local->prepared) {
+    local->search = QSqlQuery(db);
+    local->search.setForwardOnly(true);
+    local->facets = QSqlQuery(db);
+    local->facets.setForwardOnly(true);
+    // Bound: the MATCH expression, the group id twice (negative for every
+    // group), then for the search the LIMIT
+    if (!local->search.prepare(
+            "SELECT food_fts.rowid, bm25(food_fts) AS score "
+            "FROM food_fts JOIN food_group ON food_id = food_fts.rowid "
+            "WHERE food_fts MATCH ? AND (? < 0 OR food_group_id = ?) "
+            "ORDER BY score, food_fts.rowid LIMIT ?"))
+      return unavailable(local->search.lastError().text());
+    if (!local->facets.prepare(
+            "SELECT food_group_id, count(*) "
+            "FROM food_fts JOIN food_group ON food_id = food_fts.rowid "
+            "WHERE food_fts MATCH ? AND (? < 0 OR food_group_id = ?) "
+            "GROUP BY food_group_id ORDER BY food_group_id"))
+      return unavailable(local->facets.lastError().text());
+    local->prepared = true;
+  }
+
+  QSqlQuery &query = local->search;
+  query.bindValue(0, expression);
+  query.bindValue(1, request.foodGroupId);
+  query.bindValue(2, request.foodGroupId);
+  query.bindValue(3, request.maxResults);
+  if (!query.exec())
+    return unavailable(query.lastError().text());
+
+  // bm25 is negative, and more so for better matches; scale the scores so
+  // the best match gets 100
+  const FoodCorpus &corpus = request.snapshot->corpus;
+  double best = 0.0;
+  while (query.next()) {
+    const int id = query.value(0).toInt();
+    const int index = corpus.indexOf(id);
+    if (index < 0)
+      continue;
+    const double bm25 = query.value(1).toDouble();
+    if (matches.empty())
+      best = bm25;
+    const int score = best < 0.0 ? qRound(100.0 * bm25 / best) : 100;
+    matches.push_back({index, id, std::max(1, score)});
+  }
+  query.finish();
+
+  // Counted apart, so the ranking above stops at maxResults
+  if (request.facets != nullptr) {
+    QSqlQuery &counts = local->facets;
+    counts.bindValue(0, expression);
+    counts.bindValue(1, request.foodGroupId);
+    counts.bindValue(2, request.foodGroupId);
+    if (!counts.exec())
+      return unavailable(counts.lastError().text());
+    request.facets->clear();
+    while (counts.next())
+      request.facets->push_back(
+          {counts.value(0).toInt(), counts.value(1).toInt()});
+    counts.finish();
+  }
+  return true;
+}
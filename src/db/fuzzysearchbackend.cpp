@@ -0,0 +1,308 @@
+#include "db/fuzzysearchbackend.h"
+#include "utils/function_task.h"
+#include "utils/string_utils.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+
+namespace {
+
+constexpr int kScoreThreshold = 40;
+// The trigram index can only rule foods out above this score (see
+// Utils::minSharedTrigrams), so it serves a first pass whose best
+// matches all beat it
+constexpr int kPrunedThreshold = 80;
+// Sessions also keep near misses, since a longer query can score higher
+constexpr int kSessionThreshold = 20;
+// How often a long scan publishes the best matches found so far
+constexpr int kProgressIntervalMs = 50;
+// Candidates handed out per grab; also the minimum worth a second thread
+constexpr int kScoreBlockSize = 1024;
+
+// Best first: higher score, then lower food id, so ranking is deterministic
+bool ranksBefore(const SearchMatch &a, const SearchMatch &b) {
+  if (a.score != b.score)
+    return a.score > b.score;
+  return a.id < b.id;
+}
+
+// Bounded heap of the best items seen; the front is the worst
+class TopResults {
+public:
+  explicit TopResults(int limit = 0) : m_limit(static_cast<size_t>(limit)) {}
+
+  void offer(const SearchMatch &item) {
+    if (m_limit == 0)
+      return;
+    if (m_heap.size() < m_limit) {
+      m_heap.push_back(item);
+      std::push_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+    } else if (ranksBefore(item, m_heap.front())) {
+      std::pop_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+      m_heap.back() = item;
+      std::push_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+    }
+  }
+
+  [[nodiscard]] const std::vector<SearchMatch> &items() const { return m_heap; }
+
+private:
+  size_t m_limit;
+  std::vector<SearchMatch> m_heap;
+};
+
+// Dedicated so a search started from a global pool thread can't starve itself
+QThreadPool &searchPool() {
+  static QThreadPool pool;
+  return pool;
+}
+
+struct RankOptions {
+  int maxResults = 0;
+  const std::vector<int> *indices = nullptr; // Null scores the whole corpus
+  int threadCount = 0;                       // 0 = one per core
+  int threshold = kScoreThreshold;
+  // If set, receives every index scoring above survivorThreshold, ascending
+  std::vector<int> *survivors = nullptr;
+  int survivorThreshold = kScoreThreshold;
+  // If set, receives the number of matches per slot of the group index
+  std::vector<int> *groupCounts = nullptr;
+  const std::function<bool()> *isCancelled = nullptr;
+  // If set, receives the best matches found so far every
+  // kProgressIntervalMs, on the calling thread
+  const std::function<void(const std::vector<SearchMatch> &)> *onProgress =
+      nullptr;
+};
+
+// Score corpus entries and return the best maxResults above the threshold,
+// best first. Work is split across threads that claim blocks of candidates,
+// each keeping its own top list. Stops early (with whatever it has) once
+// isCancelled returns true.
+std::vector<SearchMatch> rankMatches(const FoodSnapshot &snap,
+                                    const Utils::FuzzyQuery &query,
+                                    const RankOptions &options) {
+  const FoodCorpus &corpus = snap.corpus;
+  const std::vector<int> *indices = options.indices;
+  const int total =
+      indices != nullptr ? static_cast<int>(indices->size()) : corpus.size();
+  const int threadCount = options.threadCount > 0
+                              ? options.threadCount
+                              : searchPool().maxThreadCount();
+  const int blockCount = (total + kScoreBlockSize - 1) / kScoreBlockSize;
+  const int taskCount = std::max(1, std::min(threadCount, blockCount));
+
+  std::vector<int> *survivors = options.survivors;
+  const int threshold =
+      survivors != nullptr
+          ? std::min(options.survivorThreshold, options.threshold)
+          : options.threshold;
+
+  std::vector<TopResults> partials(taskCount, TopResults(options.maxResults));
+  // Held while a task scores a block, so progress can read its top list
+  std::vector<QMutex> partialLocks(taskCount);
+  std::vector<std::vector<int>> partialSurvivors(taskCount);
+  std::vector<int> *groupCounts = options.groupCounts;
+  std::vector<std::vector<int>> partialCounts(
+      groupCounts != nullptr ? taskCount : 0,
+      std::vector<int>(snap.groupIds.size(), 0));
+  std::atomic<int> next{0};
+
+  auto bestSoFar = [&] {
+    std::vector<SearchMatch> merged;
+    for (int t = 0; t < taskCount; ++t) {
+      QMutexLocker locker(&partialLocks[t]);
+      merged.insert(merged.end(), partials[t].items().begin(),
+                    partials[t].items().end());
+    }
+    std::sort(merged.begin(), merged.end(), ranksBefore);
+    if (merged.size() > static_cast<size_t>(options.maxResults))
+      merged.resize(options.maxResults);
+    return merged;
+  };
+
+  QElapsedTimer progressTimer;
+  progressTimer.start();
+  qint64 nextProgressMs = kProgressIntervalMs;
+
+  auto work = [&](int task) {
+    TopResults &top = partials[task];
+    std::vector<int> &kept = partialSurvivors[task];
+    for (;;) {
+      if (options.isCancelled != nullptr && (*options.isCancelled)())
+        break;
+      const int begin = next.fetch_add(kScoreBlockSize);
+      if (begin >= total)
+        break;
+      const int end = std::min(total, begin + kScoreBlockSize);
+      QMutexLocker locker(&partialLocks[task]);
+      for (int i = begin; i < end; ++i) {
+        const int idx = indices != nullptr ? (*indices)[i] : i;
+        const int score =
+            Utils::calculateFuzzyScore(query, corpus.folded(idx), threshold);
+        if (score > options.threshold) {
+          top.offer({idx, corpus.id(idx), score});
+          if (groupCounts != nullptr)
+            ++partialCounts[task][snap.groupSlot(corpus.foodGroupId(idx))];
+        }
+        if (survivors != nullptr && score > options.survivorThreshold)
+          kept.push_back(idx);
+      }
+      locker.unlock();
+
+      // Only the calling thread publishes, so callbacks stay on it
+      if (task == 0 && options.onProgress != nullptr &&
+          progressTimer.elapsed() >= nextProgressMs) {
+        const std::vector<SearchMatch> best = bestSoFar();
+        if (!best.empty())
+          (*options.onProgress)(best);
+        nextProgressMs = progressTimer.elapsed() + kProgressIntervalMs;
+      }
+    }
+  };
+
+  // The calling thread works too, then waits for the helpers
+  QSemaphore done;
+  for (int t = 1; t < taskCount; ++t)
+    searchPool().start(new Utils::FunctionTask([&work, t] { work(t); }, done));
+  work(0);
+  done.acquire(taskCount - 1);
+
+  if (survivors != nullptr) {
+    survivors->clear();
+    for (const auto &kept : partialSurvivors)
+      survivors->insert(survivors->end(), kept.begin(), kept.end());
+    std::sort(survivors->begin(), survivors->end());
+  }
+  if (groupCounts != nullptr) {
+    groupCounts->assign(snap.groupIds.size(), 0);
+    for (const auto &counts : partialCounts) {
+      for (size_t slot = 0; slot < counts.size(); ++slot)
+        (*groupCounts)[slot] += counts[slot];
+    }
+  }
+
+  return bestSoFar();
+}
+
+} // namespace
+
+bool FuzzySearchBackend::rank(const SearchRequest &request,
+                              std::vector<SearchMatch> &matches) {
+  const FoodSnapshot &snap = *request.snapshot;
+  SearchSession *session = request.session;
+  matches.clear();
+
+  // Lowercase and tokenize the query once; the corpus is already folded
+  const Utils::FuzzyQuery fuzzyQuery = Utils::prepareFuzzyQuery(request.query);
+
+  // When the user keeps typing, only the previous survivors need rescoring,
+  // unless a food left out could now score above the threshold
+  std::vector<int> candidates;
+  bool narrowed = false;
+  int ceiling = kSessionThreshold;
+  if (session != nullptr && session->valid &&
+      session->generation == snap.generation &&
+      session->foodGroupId == request.foodGroupId &&
+      fuzzyQuery.text.startsWith(session->query)) {
+    const int extended = Utils::maxExtendedScore(
+        Utils::prepareFuzzyQuery(session->query), fuzzyQuery,
+        session->ceiling);
+    if (extended <= kScoreThreshold) {
+      candidates.swap(session->survivors);
+      narrowed = true;
+      ceiling = std::max(ceiling, extended);
+    }
+  }
+  // Foods outside the group are dropped before anything is scored
+  if (!narrowed && request.foodGroupId >= 0) {
+    candidates = snap.groupMembers(request.foodGroupId);
+    narrowed = true;
+  }
+
+  RankOptions options;
+  options.maxResults = request.maxResults;
+  options.threadCount = request.threadCount;
+  options.isCancelled = request.isCancelled;
+
+  auto cancelled = [&] {
+    if (options.isCancelled == nullptr || !(*options.isCancelled)())
+      return false;
+    if (session != nullptr)
+      session->reset();
+    return true;
+  };
+
+  std::vector<int> survivors;
+  if (session != nullptr) {
+    options.survivors = &survivors;
+    options.survivorThreshold = kSessionThreshold;
+  }
+  std::vector<int> groupCounts;
+  if (request.facets != nullptr)
+    options.groupCounts = &groupCounts;
+
+  // First only the foods sharing enough trigrams to score above
+  // kPrunedThreshold. Every other food scores at most that, so if a full
+  // list of matches all beat it, they are exactly the best of a full scan.
+  // Survivors and facets then only cover these candidates.
+  bool pruned = false;
+  std::vector<int> strict;
+  if (request.maxResults > 0 &&
+      snap.collectCandidates(fuzzyQuery, kPrunedThreshold, strict)) {
+    if (narrowed) {
+      std::vector<int> inScope;
+      std::set_intersection(strict.begin(), strict.end(), candidates.begin(),
+                            candidates.end(), std::back_inserter(inScope));
+      strict.swap(inScope);
+    }
+    // Not worth a second pass unless it leaves out most of the foods
+    const size_t scope = narrowed ? candidates.size()
+                                  : static_cast<size_t>(snap.corpus.size());
+    if (strict.size() * 2 < scope) {
+      options.indices = &strict;
+      matches = rankMatches(snap, fuzzyQuery, options);
+      if (cancelled()) {
+        matches.clear();
+        return false;
+      }
+      pruned = matches.size() == static_cast<size_t>(request.maxResults) &&
+               matches.back().score > kPrunedThreshold;
+    }
+  }
+
+  if (pruned) {
+    ceiling = std::max(ceiling, kPrunedThreshold);
+  } else {
+    options.indices = narrowed ? &candidates : nullptr;
+    if (request.onPartialMatches)
+      options.onProgress = &request.onPartialMatches;
+    matches = rankMatches(snap, fuzzyQuery, options);
+    if (cancelled()) {
+      matches.clear();
+      return false;
+    }
+  }
+
+  if (request.facets != nullptr) {
+    request.facets->clear();
+    for (size_t slot = 0; slot < groupCounts.size(); ++slot) {
+      if (groupCounts[slot] > 0)
+        request.facets->push_back({snap.groupIds[slot], groupCounts[slot]});
+    }
+  }
+
+  if (session != nullptr) {
+    session->query = fuzzyQuery.text;
+    session->survivors.swap(survivors);
+    session->ceiling = ceiling;
+    session->generation = snap.generation;
+    session->foodGroupId = request.foodGroupId;
+    session->valid = true;
+  }
+  return true;
+}
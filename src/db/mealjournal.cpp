@@ -0,0 +1,300 @@
+#include "db/mealjournal.h"
+#include "db/snapshotio.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr quint64 kMagic = 0x4C4E524A5254554EULL; // "NUTRJRNL"
+// Bump whenever the record layout changes
+constexpr quint32 kVersion = 1;
+constexpr quint32 kByteOrderMark = 0x01020304;
+constexpr qint64 kHeaderSize = 16;
+// Each record: payload size, payload checksum, then the payload
+constexpr qint64 kRecordHeaderSize = 8;
+
+// FNV-1a, enough to tell a torn or garbled record from a whole one
+quint32 checksum(const char *data, qint64 size) {
+  quint32 hash = 2166136261U;
+  for (qint64 i = 0; i < size; ++i) {
+    hash ^= static_cast<uchar>(data[i]);
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+void writeRecord(const JournalEntry &entry, QByteArray &out) {
+  QByteArray payload;
+  QBuffer buffer(&payload);
+  buffer.open(QIODevice::WriteOnly);
+  SnapshotWriter writer(&buffer);
+  writer.writeValue(qint64(entry.day.toJulianDay()));
+  writer.writeValue(entry.loggedAtMs);
+  writer.writeValue(entry.grams);
+  writer.writeValue(qint32(entry.foodId));
+  writer.writeString(entry.description);
+  writer.writeArray(entry.nutrientIds.data(), entry.nutrientIds.size());
+  writer.writeArray(entry.amounts.data(), entry.amounts.size());
+
+  const auto size = static_cast<quint32>(payload.size());
+  const quint32 sum = checksum(payload.constData(), payload.size());
+  out.append(reinterpret_cast<const char *>(&size), sizeof(size));
+  out.append(reinterpret_cast<const char *>(&sum), sizeof(sum));
+  out.append(payload);
+}
+
+bool readRecord(const uchar *data, qint64 size, JournalEntry &entry) {
+  SnapshotReader reader(data, size);
+  qint64 day = 0;
+  qint32 foodId = 0;
+  Utils::PackedArray<quint16> ids;
+  Utils::PackedArray<float> amounts;
+  if (!reader.readValue(day) || !reader.readValue(entry.loggedAtMs) ||
+      !reader.readValue(entry.grams) || !reader.readValue(foodId) ||
+      !reader.readString(entry.description) || !reader.readArray(ids) ||
+      !reader.readArray(amounts) || !reader.atEnd() ||
+      ids.size() != amounts.size())
+    return false;
+  entry.day = QDate::fromJulianDay(day);
+  entry.foodId = foodId;
+  entry.nutrientIds.assign(ids.begin(), ids.end());
+  entry.amounts.assign(amounts.begin(), amounts.end());
+  return entry.day.isValid();
+}
+
+// Makes what was written survive power loss, not only a crash
+bool sync(QFile &file) {
+  if (!file.flush())
+    return false;
+#ifdef Q_OS_UNIX
+  return ::fsync(file.handle()) == 0;
+#else
+  return true;
+#endif
+}
+
+} // namespace
+
+bool MealJournal::open(const QString &path) {
+  close();
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::ReadWrite)) {
+    qWarning() << "Cannot open meal journal:" << m_file.errorString();
+    return false;
+  }
+
+  if (m_file.size() == 0) {
+    QByteArray header;
+    QBuffer buffer(&header);
+    buffer.open(QIODevice::WriteOnly);
+    SnapshotWriter writer(&buffer);
+    writer.writeValue(kMagic);
+    writer.writeValue(kVersion);
+    writer.writeValue(kByteOrderMark);
+    if (m_file.write(header) != header.size() || !sync(m_file)) {
+      qWarning() << "Cannot write meal journal:" << m_file.errorString();
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  const QByteArray contents = m_file.readAll();
+  const auto *data = reinterpret_cast<const uchar *>(contents.constData());
+  const qint64 size = contents.size();
+  SnapshotReader header(data, size);
+  quint64 magic = 0;
+  quint32 version = 0;
+  quint32 byteOrder = 0;
+  if (!header.readValue(magic) || magic != kMagic ||
+      !header.readValue(version) || version != kVersion ||
+      !header.readValue(byteOrder) || byteOrder != kByteOrderMark) {
+    qWarning() << "Not a meal journal:" << path;
+    close();
+    return false;
+  }
+
+  qint64 pos = kHeaderSize;
+  JournalEntry entry;
+  while (pos + kRecordHeaderSize <= size) {
+    quint32 recordSize = 0;
+    quint32 sum = 0;
+    std::memcpy(&recordSize, data + pos, sizeof(recordSize));
+    std::memcpy(&sum, data + pos + 4, sizeof(sum));
+    const qint64 payload = pos + kRecordHeaderSize;
+    if (recordSize > size - payload)
+      break; // Cut short by the end of the file
+    if (checksum(contents.constData() + payload, recordSize) != sum ||
+        !readRecord(data + payload, recordSize, entry)) {
+      // An interrupted append only damages the end; anything else is
+      // corruption, and repairing it would throw away the records after it
+      if (payload + recordSize < size) {
+        qWarning() << "Meal journal is damaged at byte" << pos << "with"
+                   << size - payload - recordSize
+                   << "bytes of records after it; not opening" << path;
+        close();
+        return false;
+      }
+      break;
+    }
+    addToDay(entry);
+    pos = payload + recordSize;
+  }
+  updatePrefix(0);
+
+  // Only an interrupted append leaves anything after the last whole record
+  if (pos < size) {
+    qWarning() << "Dropping" << size - pos
+               << "bytes of a torn record from the meal journal";
+    if (!m_file.resize(pos)) {
+      qWarning() << "Cannot repair meal journal:" << m_file.errorString();
+      close();
+      return false;
+    }
+  }
+  m_file.seek(pos);
+  return true;
+}
+
+void MealJournal::close() {
+  m_file.close();
+  m_days.clear();
+  m_nutrientIds.clear();
+  m_columns.clear();
+  m_dayTotals.clear();
+  m_dayEntries.clear();
+  m_prefix.clear();
+  m_entryPrefix.clear();
+}
+
+bool MealJournal::append(const std::vector<JournalEntry> &entries) {
+  if (!isOpen() || entries.empty())
+    return false;
+
+  QByteArray records;
+  for (const JournalEntry &entry : entries)
+    writeRecord(entry, records);
+
+  const qint64 end = m_file.size();
+  m_file.seek(end);
+  if (m_file.write(records) != records.size() || !sync(m_file)) {
+    qWarning() << "Cannot append to meal journal:" << m_file.errorString();
+    m_file.resize(end);
+    return false;
+  }
+
+  int firstRow = static_cast<int>(m_days.size());
+  for (const JournalEntry &entry : entries)
+    firstRow = std::min(firstRow, addToDay(entry));
+  updatePrefix(firstRow);
+  return true;
+}
+
+int MealJournal::columnOf(int nutrientId) {
+  if (nutrientId >= static_cast<int>(m_columns.size()))
+    m_columns.resize(nutrientId + 1, -1);
+  if (m_columns[nutrientId] >= 0)
+    return m_columns[nutrientId];
+
+  // A new nutrient widens every day row by one
+  const size_t oldWidth = m_nutrientIds.size();
+  const size_t width = oldWidth + 1;
+  std::vector<double> widened(m_days.size() * width, 0.0);
+  for (size_t row = 0; row < m_days.size(); ++row)
+    std::copy_n(m_dayTotals.begin() + row * oldWidth, oldWidth,
+                widened.begin() + row * width);
+  m_dayTotals = std::move(widened);
+  m_prefix.clear(); // Rebuilt in full by the next updatePrefix
+  m_nutrientIds.push_back(nutrientId);
+  m_columns[nutrientId] = static_cast<int>(oldWidth);
+  return m_columns[nutrientId];
+}
+
+int MealJournal::addToDay(const JournalEntry &entry) {
+  std::vector<int> columns;
+  columns.reserve(entry.nutrientIds.size());
+  for (quint16 nutrientId : entry.nutrientIds)
+    columns.push_back(columnOf(nutrientId));
+
+  const qint64 day = entry.day.toJulianDay();
+  const auto it = std::lower_bound(m_days.begin(), m_days.end(), day);
+  const auto row = static_cast<size_t>(it - m_days.begin());
+  const size_t width = m_nutrientIds.size();
+  if (it == m_days.end() || *it != day) {
+    m_days.insert(it, day);
+    m_dayTotals.insert(m_dayTotals.begin() + row * width, width, 0.0);
+    m_dayEntries.insert(m_dayEntries.begin() + row, 0);
+  }
+
+  double *totals = m_dayTotals.data() + row * width;
+  for (size_t i = 0; i < columns.size(); ++i)
+    totals[columns[i]] += entry.amounts[i];
+  ++m_dayEntries[row];
+  return static_cast<int>(row);
+}
+
+void MealJournal::updatePrefix(int fromRow) {
+  const size_t width = m_nutrientIds.size();
+  const size_t days = m_days.size();
+  // Rows up to fromRow only sum days before it, so inserting a day leaves
+  // them valid; only a widened table starts over
+  if (m_prefix.empty())
+    fromRow = 0;
+  m_prefix.resize((days + 1) * width, 0.0);
+  m_entryPrefix.resize(days + 1, 0);
+  for (size_t row = static_cast<size_t>(fromRow); row < days; ++row) {
+    const double *before = m_prefix.data() + row * width;
+    const double *day = m_dayTotals.data() + row * width;
+    double *after = m_prefix.data() + (row + 1) * width;
+    for (size_t c = 0; c < width; ++c)
+      after[c] = before[c] + day[c];
+    m_entryPrefix[row + 1] = m_entryPrefix[row] + m_dayEntries[row];
+  }
+}
+
+int MealJournal::entryCount() const {
+  return m_entryPrefix.empty() ? 0 : m_entryPrefix.back();
+}
+
+QDate MealJournal::firstDay() const {
+  return m_days.empty() ? QDate() : QDate::fromJulianDay(m_days.front());
+}
+
+QDate MealJournal::lastDay() const {
+  return m_days.empty() ? QDate() : QDate::fromJulianDay(m_days.back());
+}
+
+JournalTotals MealJournal::totals(const QDate &from, const QDate &to) const {
+  JournalTotals totals;
+  if (!from.isValid() || !to.isValid() || to < from || m_days.empty())
+    return totals;
+  totals.calendarDays = static_cast<int>(from.daysTo(to)) + 1;
+
+  const auto begin = static_cast<size_t>(
+      std::lower_bound(m_days.begin(), m_days.end(), from.toJulianDay()) -
+      m_days.begin());
+  const auto end = static_cast<size_t>(
+      std::upper_bound(m_days.begin(), m_days.end(), to.toJulianDay()) -
+      m_days.begin());
+  totals.loggedDays = static_cast<int>(end - begin);
+  totals.entryCount = m_entryPrefix[end] - m_entryPrefix[begin];
+
+  const size_t width = m_nutrientIds.size();
+  const double *first = m_prefix.data() + begin * width;
+  const double *last = m_prefix.data() + end * width;
+  for (size_t c = 0; c < width; ++c) {
+    if (last[c] == first[c])
+      continue;
+    totals.nutrientIds.push_back(m_nutrientIds[c]);
+    totals.amounts.push_back(last[c] - first[c]);
+  }
+  return totals;
+}
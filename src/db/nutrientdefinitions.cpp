@@ -0,0 +1,41 @@
+#include "db/nutrientdefinitions.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+bool NutrientDefinitions::load(const QSqlDatabase &db) {
+  *this = NutrientDefinitions();
+
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if (!query.exec("SELECT id, nutr_desc, unit FROM nutr_def ORDER BY id")) {
+    qCritical() << "Nutrient definition query failed:"
+                << query.lastError().text();
+    return false;
+  }
+
+  // A handful of units ("g", "mg", "IU", ...) repeat across the table
+  QHash<QString, QString> units;
+  while (query.next()) {
+    const int id = query.value(0).toInt();
+    QString unit = query.value(2).toString();
+    unit = units.insert(unit, unit).value();
+
+    m_indexById.insert(id, static_cast<int>(m_definitions.size()));
+    m_definitions.push_back({id, query.value(1).toString(), unit});
+  }
+  m_definitions.shrink_to_fit();
+
+  // Older databases have no RDA column; everything else still works
+  if (!query.exec("SELECT id, rda FROM nutr_def WHERE rda > 0")) {
+    qWarning() << "Nutrient RDA query failed:" << query.lastError().text();
+    return true;
+  }
+  while (query.next()) {
+    const int index = indexOf(query.value(0).toInt());
+    if (index >= 0)
+      m_definitions[index].rda = query.value(1).toDouble();
+  }
+  return true;
+}
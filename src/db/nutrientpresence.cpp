@@ -0,0 +1,152 @@
+#include "db/nutrientpresence.h"
+#include "db/snapshotio.h"
+#include <QtAlgorithms>
+
+namespace {
+
+constexpr int kWordBits = 64;
+
+int wordsFor(int bits) { return (bits + kWordBits - 1) / kWordBits; }
+
+quint64 bit(int index) { return quint64(1) << (index % kWordBits); }
+
+} // namespace
+
+void NutrientPresence::reset(int foodCount,
+                             const NutrientDefinitions &definitions) {
+  clear();
+  m_foodCount = foodCount;
+  m_definitionCount = definitions.size();
+  m_rowWords = wordsFor(m_definitionCount);
+  m_columnWords = wordsFor(foodCount);
+  m_rows.resize(static_cast<size_t>(m_foodCount) * m_rowWords);
+  m_columns.resize(static_cast<size_t>(m_definitionCount) * m_columnWords);
+
+  m_aminoAcidMask.resize(m_rowWords);
+  m_flavonoidMask.resize(m_rowWords);
+  for (int d = 0; d < m_definitionCount; ++d) {
+    const int id = definitions.at(d).id;
+    if (id >= kFirstAminoAcidId && id <= kLastAminoAcidId)
+      m_aminoAcidMask.mutableData()[d / kWordBits] |= bit(d);
+    if (id >= kFirstFlavonoidId && id <= kLastFlavonoidId)
+      m_flavonoidMask.mutableData()[d / kWordBits] |= bit(d);
+  }
+}
+
+void NutrientPresence::set(int food, int definition) {
+  Q_ASSERT(food >= 0 && food < m_foodCount);
+  Q_ASSERT(definition >= 0 && definition < m_definitionCount);
+  m_rows.mutableData()[static_cast<size_t>(food) * m_rowWords +
+                       definition / kWordBits] |= bit(definition);
+  m_columns.mutableData()[static_cast<size_t>(definition) * m_columnWords +
+                          food / kWordBits] |= bit(food);
+}
+
+void NutrientPresence::clear() { *this = NutrientPresence(); }
+
+void NutrientPresence::writeTo(SnapshotWriter &writer) const {
+  writer.writeValue(qint32(m_foodCount));
+  writer.writeValue(qint32(m_definitionCount));
+  writer.writeArray(m_rows);
+  writer.writeArray(m_columns);
+  writer.writeArray(m_aminoAcidMask);
+  writer.writeArray(m_flavonoidMask);
+}
+
+bool NutrientPresence::readFrom(SnapshotReader &reader, int foodCount,
+                                int definitionCount) {
+  clear();
+  qint32 storedFoods = 0;
+  qint32 storedDefinitions = 0;
+  const bool read = reader.readValue(storedFoods) &&
+                    reader.readValue(storedDefinitions) &&
+                    reader.readArray(m_rows) && reader.readArray(m_columns) &&
+                    reader.readArray(m_aminoAcidMask) &&
+                    reader.readArray(m_flavonoidMask);
+
+  const int rowWords = wordsFor(definitionCount);
+  const int columnWords = wordsFor(foodCount);
+  if (!read || storedFoods != foodCount ||
+      storedDefinitions != definitionCount ||
+      m_rows.size() != static_cast<size_t>(foodCount) * rowWords ||
+      m_columns.size() != static_cast<size_t>(definitionCount) * columnWords ||
+      m_aminoAcidMask.size() != static_cast<size_t>(rowWords) ||
+      m_flavonoidMask.size() != static_cast<size_t>(rowWords)) {
+    clear();
+    return false;
+  }
+  m_foodCount = foodCount;
+  m_definitionCount = definitionCount;
+  m_rowWords = rowWords;
+  m_columnWords = columnWords;
+  return true;
+}
+
+bool NutrientPresence::reports(int food, int definition) const {
+  if (food < 0 || food >= m_foodCount || definition < 0 ||
+      definition >= m_definitionCount)
+    return false;
+  return (m_rows[static_cast<size_t>(food) * m_rowWords +
+                 definition / kWordBits] &
+          bit(definition)) != 0;
+}
+
+int NutrientPresence::count(int food) const {
+  if (food < 0 || food >= m_foodCount)
+    return 0;
+  const quint64 *row = m_rows.data() + static_cast<size_t>(food) * m_rowWords;
+  int total = 0;
+  for (int w = 0; w < m_rowWords; ++w)
+    total += qPopulationCount(row[w]);
+  return total;
+}
+
+int NutrientPresence::maskedCount(
+    int food, const Utils::PackedArray<quint64> &mask) const {
+  if (food < 0 || food >= m_foodCount)
+    return 0;
+  const quint64 *row = m_rows.data() + static_cast<size_t>(food) * m_rowWords;
+  int total = 0;
+  for (int w = 0; w < m_rowWords; ++w)
+    total += qPopulationCount(row[w] & mask[w]);
+  return total;
+}
+
+std::vector<quint64>
+NutrientPresence::intersectColumns(const std::vector<int> &definitions) const {
+  std::vector<quint64> result(m_columnWords, ~quint64(0));
+  for (int definition : definitions) {
+    if (definition < 0 || definition >= m_definitionCount)
+      return std::vector<quint64>(m_columnWords, 0);
+
+    // Plain word-wise AND over contiguous arrays, which the compiler
+    // vectorizes
+    const quint64 *column =
+        m_columns.data() + static_cast<size_t>(definition) * m_columnWords;
+    quint64 *out = result.data();
+    for (int w = 0; w < m_columnWords; ++w)
+      out[w] &= column[w];
+  }
+  if (m_foodCount % kWordBits != 0)
+    result.back() &= bit(m_foodCount) - 1;
+  return result;
+}
+
+std::vector<int>
+NutrientPresence::foodsReportingAll(const std::vector<int> &definitions) const {
+  const std::vector<quint64> matches = intersectColumns(definitions);
+  std::vector<int> foods;
+  for (int w = 0; w < m_columnWords; ++w) {
+    for (quint64 word = matches[w]; word != 0; word &= word - 1)
+      foods.push_back(w * kWordBits + qCountTrailingZeroBits(word));
+  }
+  return foods;
+}
+
+int NutrientPresence::countReportingAll(
+    const std::vector<int> &definitions) const {
+  int total = 0;
+  for (quint64 word : intersectColumns(definitions))
+    total += qPopulationCount(word);
+  return total;
+}
@@ -0,0 +1,72 @@
+#include "db/nutrientranking.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+NutrientColumn::NutrientColumn(std::vector<double> amounts)
+    : m_amounts(std::move(amounts)) {
+  for (int food = 0; food < static_cast<int>(m_amounts.size()); ++food) {
+    if (reports(food))
+      m_byAmount.push_back(food);
+  }
+  std::sort(m_byAmount.begin(), m_byAmount.end(), [this](int a, int b) {
+    return m_amounts[a] != m_amounts[b] ? m_amounts[a] > m_amounts[b] : a < b;
+  });
+}
+
+bool NutrientColumn::reports(int food) const {
+  return food >= 0 && food < static_cast<int>(m_amounts.size()) &&
+         !std::isnan(m_amounts[food]);
+}
+
+std::vector<RankedFood> rankByNutrient(const FoodCorpus &corpus,
+                                       const NutrientColumn &column,
+                                       const NutrientColumn *energy,
+                                       const NutrientRankingQuery &query) {
+  std::vector<RankedFood> ranked;
+  if (query.limit <= 0)
+    return ranked;
+
+  auto inGroup = [&](int food) {
+    return query.foodGroupId < 0 ||
+           corpus.foodGroupId(food) == query.foodGroupId;
+  };
+  auto add = [&](int food, double value) {
+    ranked.push_back({corpus.id(food), corpus.description(food),
+                      corpus.foodGroupId(food), column.amount(food), value});
+  };
+
+  if (query.basis == NutrientBasis::Per100Grams) {
+    for (int food : column.byAmount()) {
+      if (static_cast<int>(ranked.size()) == query.limit)
+        break;
+      if (inGroup(food))
+        add(food, column.amount(food));
+    }
+    return ranked;
+  }
+
+  if (energy == nullptr)
+    return ranked;
+
+  std::vector<std::pair<double, int>> values;
+  values.reserve(column.byAmount().size());
+  for (int food : column.byAmount()) {
+    if (!inGroup(food) || !energy->reports(food) || energy->amount(food) <= 0)
+      continue;
+    values.emplace_back(column.amount(food) / energy->amount(food) * 100.0,
+                        food);
+  }
+
+  const auto count =
+      std::min(values.size(), static_cast<size_t>(query.limit));
+  std::partial_sort(values.begin(), values.begin() + count, values.end(),
+                    [](const std::pair<double, int> &a,
+                       const std::pair<double, int> &b) {
+                      return a.first != b.first ? a.first > b.first
+                                                : a.second < b.second;
+                    });
+  for (size_t i = 0; i < count; ++i)
+    add(values[i].second, values[i].first);
+  return ranked;
+}
@@ -0,0 +1,303 @@
+#include "db/nutrientsimilarity.h"
+#include "utils/simd_search.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Rows sampled per cluster to train the centroids, training rounds, and
+// clusters scanned per query
+constexpr int kSamplesPerCluster = 50;
+constexpr int kTrainingRounds = 10;
+constexpr int kProbes = 16;
+
+bool closer(const NutrientProfiles::Neighbour &a,
+            const NutrientProfiles::Neighbour &b) {
+  return a.distance != b.distance ? a.distance < b.distance : a.food < b.food;
+}
+
+// Nearest centroid by squared L2 distance, from |c|^2 - 2 x.c
+int nearestCentroid(const float *row, const std::vector<float> &centroids,
+                    const std::vector<float> &centroidNorms, int dimensions,
+                    std::vector<float> &dots) {
+  const int count = static_cast<int>(centroidNorms.size());
+  Utils::dotProducts(row, centroids.data(), dimensions, count, dots.data());
+  int best = 0;
+  float bestDistance = centroidNorms[0] - 2.0F * dots[0];
+  for (int c = 1; c < count; ++c) {
+    const float distance = centroidNorms[c] - 2.0F * dots[c];
+    if (distance < bestDistance) {
+      bestDistance = distance;
+      best = c;
+    }
+  }
+  return best;
+}
+
+std::vector<float> squaredNorms(const std::vector<float> &rows,
+                                int dimensions) {
+  std::vector<float> norms(dimensions > 0 ? rows.size() / dimensions : 0);
+  for (size_t r = 0; r < norms.size(); ++r) {
+    const float *row = rows.data() + r * dimensions;
+    float sum = 0.0F;
+    for (int j = 0; j < dimensions; ++j)
+      sum += row[j] * row[j];
+    norms[r] = sum;
+  }
+  return norms;
+}
+
+} // namespace
+
+void NutrientProfiles::reset(int foodCount,
+                             const std::vector<int> &definitions,
+                             NutrientBasis basis, int energyDefinition) {
+  m_foodCount = foodCount;
+  m_definitions = definitions;
+  m_basis = basis;
+  m_energyDefinition = energyDefinition;
+
+  int maxDefinition = energyDefinition;
+  for (int definition : definitions)
+    maxDefinition = std::max(maxDefinition, definition);
+  m_dimensionOf.assign(maxDefinition + 1, -1);
+  for (int d = 0; d < dimensions(); ++d)
+    m_dimensionOf[definitions[d]] = d;
+
+  m_energy.assign(basis == NutrientBasis::Per100Kcal ? foodCount : 0, 0.0F);
+  m_rows.assign(static_cast<size_t>(foodCount) * dimensions(), 0.0F);
+  m_squaredNorms.clear();
+  m_slotOf.assign(foodCount, -1);
+  m_foodAt.clear();
+  m_centroids.clear();
+  m_clusterOffsets.clear();
+}
+
+void NutrientProfiles::set(int food, int definition, double amount) {
+  if (food < 0 || food >= m_foodCount || definition < 0 ||
+      definition >= static_cast<int>(m_dimensionOf.size()))
+    return;
+  if (definition == m_energyDefinition && !m_energy.empty())
+    m_energy[food] = static_cast<float>(amount);
+  const int dimension = m_dimensionOf[definition];
+  if (dimension >= 0)
+    m_rows[static_cast<size_t>(food) * dimensions() + dimension] =
+        static_cast<float>(amount);
+}
+
+void NutrientProfiles::finish() {
+  const int d = dimensions();
+  float *rows = m_rows.data();
+
+  if (m_basis == NutrientBasis::Per100Kcal) {
+    // Energy itself is 100 kcal for every food now, so it carries nothing
+    const int energyDimension =
+        m_energyDefinition >= 0 ? m_dimensionOf[m_energyDefinition] : -1;
+    for (int food = 0; food < m_foodCount; ++food) {
+      float *row = rows + static_cast<size_t>(food) * d;
+      const float scale = m_energy[food] > 0 ? 100.0F / m_energy[food] : 0.0F;
+      for (int j = 0; j < d; ++j)
+        row[j] = j == energyDimension ? 0.0F : row[j] * scale;
+    }
+  }
+
+  std::vector<double> sums(d, 0.0);
+  std::vector<int> counts(d, 0);
+  for (int food = 0; food < m_foodCount; ++food) {
+    const float *row = rows + static_cast<size_t>(food) * d;
+    for (int j = 0; j < d; ++j) {
+      if (row[j] > 0) {
+        sums[j] += row[j];
+        ++counts[j];
+      }
+    }
+  }
+  std::vector<float> inverseMeans(d, 0.0F);
+  for (int j = 0; j < d; ++j) {
+    if (counts[j] > 0 && sums[j] > 0)
+      inverseMeans[j] = static_cast<float>(counts[j] / sums[j]);
+  }
+
+  for (int food = 0; food < m_foodCount; ++food) {
+    float *row = rows + static_cast<size_t>(food) * d;
+    for (int j = 0; j < d; ++j)
+      row[j] = row[j] > 0 ? std::log1p(row[j] * inverseMeans[j]) : 0.0F;
+  }
+
+  m_squaredNorms = squaredNorms(m_rows, d);
+  m_foodAt.resize(m_foodCount);
+  for (int food = 0; food < m_foodCount; ++food) {
+    m_foodAt[food] = food;
+    m_slotOf[food] = m_squaredNorms[food] > 0 ? food : -1;
+  }
+}
+
+void NutrientProfiles::buildIndex() {
+  const int d = dimensions();
+  std::vector<int> profiled;
+  for (int food = 0; food < m_foodCount; ++food) {
+    if (contains(food))
+      profiled.push_back(m_slotOf[food]);
+  }
+  const int n = static_cast<int>(profiled.size());
+  const int clusterCount =
+      std::max(1, static_cast<int>(std::sqrt(static_cast<double>(n)) / 2));
+  if (d == 0 || n < 2 * clusterCount)
+    return;
+
+  // Train on an even sample, seeded with evenly spaced rows
+  const int sampleCount = std::min(n, clusterCount * kSamplesPerCluster);
+  std::vector<int> sample(sampleCount);
+  for (int i = 0; i < sampleCount; ++i)
+    sample[i] = profiled[static_cast<size_t>(i) * n / sampleCount];
+  std::vector<float> centroids(static_cast<size_t>(clusterCount) * d);
+  for (int c = 0; c < clusterCount; ++c)
+    std::copy_n(row(sample[static_cast<size_t>(c) * sampleCount /
+                           clusterCount]),
+                d, centroids.begin() + static_cast<size_t>(c) * d);
+
+  std::vector<float> centroidNorms = squaredNorms(centroids, d);
+  std::vector<float> dots(clusterCount);
+  std::vector<double> sums(static_cast<size_t>(clusterCount) * d);
+  std::vector<int> sizes(clusterCount);
+  for (int round = 0; round < kTrainingRounds; ++round) {
+    std::fill(sums.begin(), sums.end(), 0.0);
+    std::fill(sizes.begin(), sizes.end(), 0);
+    for (int slot : sample) {
+      const float *values = row(slot);
+      const int c = nearestCentroid(values, centroids, centroidNorms, d, dots);
+      double *sum = sums.data() + static_cast<size_t>(c) * d;
+      for (int j = 0; j < d; ++j)
+        sum[j] += values[j];
+      ++sizes[c];
+    }
+    // A cluster that lost every row keeps its centroid
+    for (int c = 0; c < clusterCount; ++c) {
+      if (sizes[c] == 0)
+        continue;
+      for (int j = 0; j < d; ++j)
+        centroids[static_cast<size_t>(c) * d + j] =
+            static_cast<float>(sums[static_cast<size_t>(c) * d + j] / sizes[c]);
+    }
+    centroidNorms = squaredNorms(centroids, d);
+  }
+
+  // Assign every row, then store the rows cluster by cluster
+  std::vector<int> clusterOf(n);
+  std::vector<int> offsets(clusterCount + 1, 0);
+  for (int i = 0; i < n; ++i) {
+    clusterOf[i] =
+        nearestCentroid(row(profiled[i]), centroids, centroidNorms, d, dots);
+    ++offsets[clusterOf[i] + 1];
+  }
+  for (int c = 0; c < clusterCount; ++c)
+    offsets[c + 1] += offsets[c];
+
+  std::vector<float> rows(static_cast<size_t>(n) * d);
+  std::vector<float> norms(n);
+  std::vector<int> foodAt(n);
+  std::vector<int> next(offsets.begin(), offsets.end() - 1);
+  std::fill(m_slotOf.begin(), m_slotOf.end(), -1);
+  for (int i = 0; i < n; ++i) {
+    const int oldSlot = profiled[i];
+    const int slot = next[clusterOf[i]]++;
+    std::copy_n(row(oldSlot), d, rows.begin() + static_cast<size_t>(slot) * d);
+    norms[slot] = m_squaredNorms[oldSlot];
+    foodAt[slot] = m_foodAt[oldSlot];
+    m_slotOf[foodAt[slot]] = slot;
+  }
+  m_rows = std::move(rows);
+  m_squaredNorms = std::move(norms);
+  m_foodAt = std::move(foodAt);
+  m_centroids = std::move(centroids);
+  m_clusterOffsets = std::move(offsets);
+}
+
+bool NutrientProfiles::contains(int food) const {
+  return food >= 0 && food < m_foodCount && m_slotOf[food] >= 0;
+}
+
+void NutrientProfiles::score(const float *query, float queryNorm,
+                             SimilarityMetric metric, int slot, int count,
+                             std::vector<Neighbour> &out) const {
+  std::vector<float> dots(count);
+  Utils::dotProducts(query, row(slot), dimensions(), count, dots.data());
+  for (int i = 0; i < count; ++i) {
+    const float norm = m_squaredNorms[slot + i];
+    if (norm <= 0)
+      continue; // No profile
+    const float distance =
+        metric == SimilarityMetric::Cosine
+            ? 1.0F - dots[i] / std::sqrt(queryNorm * norm)
+            : std::sqrt(std::max(0.0F, queryNorm + norm - 2.0F * dots[i]));
+    out.push_back({m_foodAt[slot + i], distance});
+  }
+}
+
+void NutrientProfiles::scoreSlots(const float *query, float queryNorm,
+                                  SimilarityMetric metric,
+                                  const std::vector<int> &slots,
+                                  std::vector<Neighbour> &out) const {
+  for (int slot : slots)
+    score(query, queryNorm, metric, slot, 1, out);
+}
+
+std::vector<NutrientProfiles::Neighbour>
+NutrientProfiles::nearest(int food, SimilarityMetric metric, int limit,
+                          const std::vector<int> *candidates,
+                          bool exact) const {
+  std::vector<Neighbour> neighbours;
+  if (!contains(food) || limit <= 0)
+    return neighbours;
+
+  const int querySlot = m_slotOf[food];
+  const float *query = row(querySlot);
+  const float queryNorm = m_squaredNorms[querySlot];
+
+  if (candidates != nullptr) {
+    std::vector<int> slots;
+    slots.reserve(candidates->size());
+    for (int candidate : *candidates) {
+      if (contains(candidate))
+        slots.push_back(m_slotOf[candidate]);
+    }
+    scoreSlots(query, queryNorm, metric, slots, neighbours);
+  } else if (hasIndex() && !exact) {
+    const int d = dimensions();
+    const int clusterCount = static_cast<int>(m_clusterOffsets.size()) - 1;
+    std::vector<float> dots(clusterCount);
+    Utils::dotProducts(query, m_centroids.data(), d, clusterCount,
+                       dots.data());
+    std::vector<Neighbour> clusters(clusterCount);
+    for (int c = 0; c < clusterCount; ++c) {
+      const float *centroid = m_centroids.data() + static_cast<size_t>(c) * d;
+      float norm = 0.0F;
+      for (int j = 0; j < d; ++j)
+        norm += centroid[j] * centroid[j];
+      clusters[c] = {c, norm - 2.0F * dots[c]};
+    }
+    const int probes = std::min(clusterCount, kProbes);
+    std::partial_sort(clusters.begin(), clusters.begin() + probes,
+                      clusters.end(), closer);
+    for (int p = 0; p < probes; ++p) {
+      const int c = clusters[p].food;
+      score(query, queryNorm, metric, m_clusterOffsets[c],
+            m_clusterOffsets[c + 1] - m_clusterOffsets[c], neighbours);
+    }
+  } else {
+    score(query, queryNorm, metric, 0, static_cast<int>(m_foodAt.size()),
+          neighbours);
+  }
+
+  neighbours.erase(std::remove_if(neighbours.begin(), neighbours.end(),
+                                  [food](const Neighbour &neighbour) {
+                                    return neighbour.food == food;
+                                  }),
+                   neighbours.end());
+  const auto count =
+      std::min(neighbours.size(), static_cast<size_t>(limit));
+  std::partial_sort(neighbours.begin(), neighbours.begin() + count,
+                    neighbours.end(), closer);
+  neighbours.resize(count);
+  return neighbours;
+}
@@ -0,0 +1,87 @@
+#include "db/nutrientstore.h"
+#include "db/snapshotio.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <algorithm>
+
+bool NutrientStore::load(const QSqlDatabase &db,
+                         const NutrientDefinitions &definitions) {
+  clear();
+
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if (!query.exec("SELECT food_id, nutr_id, nutr_val FROM nut_data "
+                  "ORDER BY food_id, nutr_id")) {
+    qCritical() << "Nutrient data query failed:" << query.lastError().text();
+    clear();
+    return false;
+  }
+
+  while (query.next()) {
+    // Values without a definition were never shown, so drop them here
+    const int index = definitions.indexOf(query.value(1).toInt());
+    if (index < 0)
+      continue;
+
+    const int foodId = query.value(0).toInt();
+    if (m_foodIds.empty() || m_foodIds.back() != foodId) {
+      if (!m_foodIds.empty())
+        m_offsets.push_back(static_cast<int>(m_nutrientIndices.size()));
+      m_foodIds.push_back(foodId);
+    }
+    m_nutrientIndices.push_back(static_cast<quint16>(index));
+    m_amounts.push_back(query.value(2).toDouble());
+  }
+  if (!m_foodIds.empty())
+    m_offsets.push_back(static_cast<int>(m_nutrientIndices.size()));
+
+  m_foodIds.shrink_to_fit();
+  m_offsets.shrink_to_fit();
+  m_nutrientIndices.shrink_to_fit();
+  m_amounts.shrink_to_fit();
+  return true;
+}
+
+void NutrientStore::clear() { *this = NutrientStore(); }
+
+void NutrientStore::writeTo(SnapshotWriter &writer) const {
+  writer.writeArray(m_foodIds);
+  writer.writeArray(m_offsets);
+  writer.writeArray(m_nutrientIndices);
+  writer.writeArray(m_amounts);
+}
+
+bool NutrientStore::readFrom(SnapshotReader &reader, int definitionCount) {
+  clear();
+  const bool read =
+      reader.readArray(m_foodIds) && reader.readArray(m_offsets) &&
+      reader.readArray(m_nutrientIndices) && reader.readArray(m_amounts);
+
+  const size_t count = m_foodIds.size();
+  bool valid = read && m_offsets.size() == count + 1 && m_offsets[0] == 0 &&
+               m_offsets.back() == static_cast<int>(m_amounts.size()) &&
+               m_nutrientIndices.size() == m_amounts.size();
+  for (size_t i = 0; valid && i < count; ++i) {
+    valid = m_offsets[i] <= m_offsets[i + 1] &&
+            (i == 0 || m_foodIds[i - 1] < m_foodIds[i]);
+  }
+  for (size_t i = 0; valid && i < m_nutrientIndices.size(); ++i)
+    valid = m_nutrientIndices[i] < definitionCount;
+
+  if (!valid)
+    clear();
+  return valid;
+}
+
+NutrientRow NutrientStore::row(int foodId) const {
+  auto it = std::lower_bound(m_foodIds.begin(), m_foodIds.end(), foodId);
+  if (it == m_foodIds.end() || *it != foodId)
+    return {};
+
+  const auto food = static_cast<size_t>(it - m_foodIds.begin());
+  const int start = m_offsets[food];
+  return {m_nutrientIndices.data() + start, m_amounts.data() + start,
+          m_offsets[food + 1] - start};
+}
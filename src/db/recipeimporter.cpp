@@ -0,0 +1,189 @@
+#include "db/recipeimporter.h"
+#include "utils/function_task.h"
+#include "utils/string_utils.h"
+#include <QDebug>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <map>
+
+namespace {
+
+// Separate from the search pool, whose threads the searches run on
+QThreadPool &importPool() {
+  static QThreadPool pool;
+  return pool;
+}
+
+struct Match {
+  int foodId = -1;
+  QString name;
+};
+
+struct Columns {
+  int ingredient = 0;
+  int grams = 1;
+};
+
+bool readHeader(const QStringList &fields, Columns &columns) {
+  int ingredient = -1;
+  int grams = -1;
+  for (int i = 0; i < fields.size(); ++i) {
+    const QString name = fields[i].trimmed().toLower();
+    if (ingredient < 0 &&
+        (name == "ingredient" || name == "food" || name == "description"))
+      ingredient = i;
+    else if (grams < 0 && (name == "grams" || name == "g" || name == "amount"))
+      grams = i;
+  }
+  if (ingredient < 0 || grams < 0)
+    return false;
+  columns = {ingredient, grams};
+  return true;
+}
+
+// Accepts "120" as well as "120 g"
+bool parseGrams(QString text, double &grams) {
+  text = text.trimmed();
+  if (text.endsWith(QLatin1Char('g'), Qt::CaseInsensitive))
+    text.chop(1);
+  bool ok = false;
+  grams = text.trimmed().toDouble(&ok);
+  return ok && grams > 0;
+}
+
+QString readLine(QIODevice &device) {
+  QByteArray line = device.readLine();
+  while (line.endsWith('\n') || line.endsWith('\r'))
+    line.chop(1);
+  return QString::fromUtf8(line);
+}
+
+// Best match for each query. Threads claim queries one at a time, and each
+// search scores on its own thread since the searches already run in
+// parallel.
+std::vector<Match> resolve(FoodRepository &repository,
+                           const std::vector<QString> &queries,
+                           int threadCount) {
+  std::vector<Match> matches(queries.size());
+  const int total = static_cast<int>(queries.size());
+  SearchControl control;
+  control.threadCount = 1;
+  std::atomic<int> next{0};
+  auto work = [&] {
+    for (int i = next++; i < total; i = next++) {
+      const std::vector<FoodItem> found =
+          repository.rankFoods(queries[i], nullptr, &control);
+      if (!found.empty())
+        matches[i] = {found.front().id, found.front().description};
+    }
+  };
+
+  const int threads =
+      threadCount > 0 ? threadCount : importPool().maxThreadCount();
+  const int taskCount = std::max(1, std::min(threads, total));
+  QSemaphore done;
+  for (int t = 1; t < taskCount; ++t)
+    importPool().start(new Utils::FunctionTask(work, done));
+  work();
+  done.acquire(taskCount - 1);
+  return matches;
+}
+
+} // namespace
+
+bool importRecipeCsv(QIODevice &device, FoodRepository &repository,
+                     RecipeImportResult &result,
+                     const RecipeImportOptions &options,
+                     const ImportProgress &progress) {
+  result = RecipeImportResult();
+  if (!device.isOpen() && !device.open(QIODevice::ReadOnly)) {
+    qWarning() << "Cannot read recipe:" << device.errorString();
+    return false;
+  }
+  repository.ensureCacheLoaded();
+
+  // Matches by normalized ingredient text, for the whole import. Each one
+  // is searched as first written.
+  std::map<QString, Match> known;
+  std::vector<ImportedIngredient> chunk;
+  auto resolveChunk = [&] {
+    std::vector<QString> keys;
+    std::vector<QString> queries;
+    for (const ImportedIngredient &ingredient : chunk) {
+      QString key = Utils::normalizeQuery(ingredient.text);
+      if (known.emplace(key, Match()).second) {
+        keys.push_back(std::move(key));
+        queries.push_back(ingredient.text);
+      }
+    }
+    const std::vector<Match> matches =
+        resolve(repository, queries, options.threadCount);
+    for (size_t i = 0; i < keys.size(); ++i)
+      known[keys[i]] = matches[i];
+
+    // Confidence is the fuzzy score of the text as written against the
+    // food, whatever the backend: FTS always scores its best hit 100
+    for (ImportedIngredient &ingredient : chunk) {
+      const Match &match = known[Utils::normalizeQuery(ingredient.text)];
+      ingredient.foodId = match.foodId;
+      ingredient.foodName = match.name;
+      if (match.foodId >= 0)
+        ingredient.score =
+            Utils::calculateFuzzyScore(ingredient.text, match.name);
+      ingredient.lowConfidence =
+          match.foodId < 0 || ingredient.score < options.confidentScore;
+      if (ingredient.lowConfidence)
+        ++result.lowConfidenceCount;
+      result.ingredients.push_back(std::move(ingredient));
+    }
+    chunk.clear();
+  };
+
+  Columns columns;
+  bool firstRecord = true;
+  int lineNumber = 0;
+  QStringList fields;
+  while (!device.atEnd()) {
+    // A quoted field may run over several lines
+    QString record = readLine(device);
+    const int recordLine = ++lineNumber;
+    while (!Utils::splitCsvRecord(record, fields) && !device.atEnd()) {
+      record += QLatin1Char('\n') + readLine(device);
+      ++lineNumber;
+    }
+
+    const QString trimmed = record.trimmed();
+    if (trimmed.isEmpty() || trimmed.startsWith(QLatin1Char('#')))
+      continue;
+    if (firstRecord) {
+      firstRecord = false;
+      if (readHeader(fields, columns))
+        continue;
+    }
+
+    ImportedIngredient ingredient{recordLine, QString(), 0.0};
+    if (fields.size() > std::max(columns.ingredient, columns.grams))
+      ingredient.text = fields[columns.ingredient].trimmed();
+    if (ingredient.text.isEmpty() ||
+        !parseGrams(fields[columns.grams], ingredient.grams)) {
+      result.problems << QString("Line %1: expected an ingredient and its "
+                                 "grams, got \"%2\"")
+                             .arg(recordLine)
+                             .arg(trimmed);
+      continue;
+    }
+    chunk.push_back(std::move(ingredient));
+
+    if (static_cast<int>(chunk.size()) >= options.chunkLines) {
+      resolveChunk();
+      if (progress)
+        progress(lineNumber);
+    }
+  }
+  resolveChunk();
+  if (progress)
+    progress(lineNumber);
+  return true;
+}
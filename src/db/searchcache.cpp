@@ -0,0 +1,97 @@
+#include "db/searchcache.h"
+#include <QMutexLocker>
+#include <algorithm>
+
+SearchCache::SearchCache(int capacity) : m_capacity(capacity) {}
+
+void SearchCache::setCapacity(int capacity) {
+  QMutexLocker locker(&m_mutex);
+  m_capacity = std::max(0, capacity);
+  evictExcess();
+}
+
+int SearchCache::capacity() const {
+  QMutexLocker locker(&m_mutex);
+  return m_capacity;
+}
+
+bool SearchCache::lookup(const QString &key, quint64 generation,
+                         std::vector<Match> &matches,
+                         std::vector<Facet> *facets) {
+  QMutexLocker locker(&m_mutex);
+  auto it = m_index.find(key);
+  if (it == m_index.end()) {
+    ++m_misses;
+    return false;
+  }
+  if (it.value()->generation != generation) {
+    // Ranked against data that has since been replaced
+    m_entries.erase(it.value());
+    m_index.erase(it);
+    ++m_misses;
+    return false;
+  }
+  if (facets != nullptr && !it.value()->hasFacets) {
+    // Ranked without counting; the search has to run again
+    ++m_misses;
+    return false;
+  }
+  ++m_hits;
+  m_entries.splice(m_entries.begin(), m_entries, it.value());
+  matches = it.value()->matches;
+  if (facets != nullptr)
+    *facets = it.value()->facets;
+  return true;
+}
+
+void SearchCache::insert(const QString &key, quint64 generation,
+                         const std::vector<Match> &matches,
+                         const std::vector<Facet> *facets) {
+  QMutexLocker locker(&m_mutex);
+  if (m_capacity == 0)
+    return;
+
+  auto it = m_index.find(key);
+  if (it != m_index.end()) {
+    it.value()->generation = generation;
+    it.value()->matches = matches;
+    it.value()->facets = facets != nullptr ? *facets : std::vector<Facet>();
+    it.value()->hasFacets = facets != nullptr;
+    m_entries.splice(m_entries.begin(), m_entries, it.value());
+    return;
+  }
+  m_entries.push_front(
+      {key, generation, matches,
+       facets != nullptr ? *facets : std::vector<Facet>(), facets != nullptr});
+  m_index.insert(key, m_entries.begin());
+  evictExcess();
+}
+
+void SearchCache::clear() {
+  QMutexLocker locker(&m_mutex);
+  m_entries.clear();
+  m_index.clear();
+}
+
+quint64 SearchCache::hits() const {
+  QMutexLocker locker(&m_mutex);
+  return m_hits;
+}
+
+quint64 SearchCache::misses() const {
+  QMutexLocker locker(&m_mutex);
+  return m_misses;
+}
+
+void SearchCache::resetStatistics() {
+  QMutexLocker locker(&m_mutex);
+  m_hits = 0;
+  m_misses = 0;
+}
+
+void SearchCache::evictExcess() {
+  while (static_cast<int>(m_entries.size()) > m_capacity) {
+    m_index.remove(m_entries.back().key);
+    m_entries.pop_back();
+  }
+}
@@ -0,0 +1,52 @@
+#include "db/searchworker.h"
+
+SearchWorker::SearchWorker(FoodRepository &repository, QObject *parent)
+    : QObject(parent), m_repository(repository) {
+  qRegisterMetaType<std::vector<FoodItem>>("std::vector<FoodItem>");
+  qRegisterMetaType<std::vector<SearchFacet>>("std::vector<SearchFacet>");
+}
+
+int SearchWorker::nextGeneration() { return ++m_generation; }
+
+bool SearchWorker::isStale(int generation) const {
+  return generation != m_generation.load();
+}
+
+void SearchWorker::search(int generation, const QString &query,
+                          int foodGroupId) {
+  // Superseded while waiting in the queue
+  if (isStale(generation))
+    return;
+
+  SearchControl control;
+  control.isCancelled = [this, generation] { return isStale(generation); };
+  control.onPartialResults = [this,
+                              generation](const std::vector<FoodItem> &head) {
+    emit resultsReady(generation, head, false);
+  };
+
+  SearchScope scope;
+  scope.foodGroupId = foodGroupId;
+
+  std::vector<FoodItem> results =
+      m_repository.rankFoods(query, &m_session, &control, &scope);
+  if (!isStale(generation))
+    emit resultsReady(generation, results, true);
+}
+
+void SearchWorker::countFacets(int generation, const QString &query) {
+  if (isStale(generation))
+    return;
+
+  SearchControl control;
+  control.isCancelled = [this, generation] { return isStale(generation); };
+
+  // Every group, whatever the search itself is limited to. The session
+  // belongs to the searches, so this one runs without it.
+  std::vector<SearchFacet> facets;
+  SearchScope scope;
+  scope.facets = &facets;
+  m_repository.rankFoods(query, nullptr, &control, &scope);
+  if (!isStale(generation))
+    emit facetsReady(generation, facets);
+}
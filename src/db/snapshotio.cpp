@@ -0,0 +1,50 @@
+#include "db/snapshotio.h"
+
+namespace {
+
+constexpr qint64 kAlignment = 8;
+
+qint64 paddingAfter(qint64 offset) {
+  return (kAlignment - offset % kAlignment) % kAlignment;
+}
+
+} // namespace
+
+void SnapshotWriter::writeRaw(const void *data, size_t size) {
+  if (!m_ok || size == 0)
+    return;
+  const auto length = static_cast<qint64>(size);
+  m_ok = m_device->write(static_cast<const char *>(data), length) == length;
+  m_written += length;
+}
+
+void SnapshotWriter::pad() {
+  static const char zeros[kAlignment] = {};
+  writeRaw(zeros, static_cast<size_t>(paddingAfter(m_written)));
+}
+
+bool SnapshotReader::readString(QString &text) {
+  const QChar *data = nullptr;
+  size_t count = 0;
+  if (!readArrayData(data, count))
+    return false;
+  text = QString::fromRawData(data, static_cast<int>(count));
+  return true;
+}
+
+bool SnapshotReader::readBytes(QByteArray &bytes) {
+  const char *data = nullptr;
+  size_t count = 0;
+  if (!readArrayData(data, count))
+    return false;
+  bytes = QByteArray::fromRawData(data, static_cast<int>(count));
+  return true;
+}
+
+bool SnapshotReader::skipPadding() {
+  const qint64 padding = paddingAfter(m_pos);
+  if (!has(padding))
+    return false;
+  m_pos += padding;
+  return true;
+}
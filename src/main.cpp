@@ -1,8 +1,11 @@
 #include "db/databasemanager.h"
+#include "db/foodrepository.h"
+#include "db/ftssearchbackend.h"
 #include "mainwindow.h"
 #include <QApplication>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QIcon>
 #include <QMessageBox>
@@ -50,6 +53,8 @@ int main(int argc, char *argv[]) {
     qWarning() << "Database not found in standard locations.";
   }
 
+  QElapsedTimer openTimer;
+  openTimer.start();
   if (!DatabaseManager::instance().connect(dbPath)) {
     QString errorMsg =
         QString("Failed to connect to database at:\n%1\n\nPlease ensure the "
@@ -59,10 +64,30 @@ int main(int argc, char *argv[]) {
     QMessageBox::critical(nullptr, "Database Error", errorMsg);
     return 1;
   }
-  qDebug() << "Connected to database at:" << dbPath;
+  qDebug() << "Connected to database at:" << dbPath << "in"
+           << openTimer.elapsed() << "ms";
+  qDebug().noquote() << "SQLite settings:"
+                     << DatabaseManager::instance().settingsReport();
+
+  // Memory-constrained installs can keep nutrient data in the database
+  if (qEnvironmentVariableIsSet("NUTRA_LAZY_NUTRIENTS"))
+    FoodRepository::instance().setLazyNutrients(true);
+  const QString dataDir =
+      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  FoodRepository::instance().setSnapshotPath(dataDir + "/search-snapshot.bin");
+
+  // Thin clients can trade typo tolerance for memory with the FTS5 index
+  if (qEnvironmentVariable("NUTRA_SEARCH_BACKEND") == "fts5") {
+    FoodRepository::instance().setSearchBackend(
+        std::make_shared<FtsSearchBackend>(dataDir + "/search-fts.sqlite3"));
+  }
+  qDebug() << "Search backend:"
+           << FoodRepository::instance().searchBackend()->name();
 
   MainWindow window;
+  window.openJournal(dataDir + "/meal-journal.bin");
   window.show();
+  window.startWarmup();
 
   return QApplication::exec();
 }
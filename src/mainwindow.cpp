@@ -2,12 +2,75 @@
 #include <QVBoxLayout>
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QLabel>
+#include <QStatusBar>
 #include <QWidget>
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) { setupUi(); }
 
-MainWindow::~MainWindow() = default;
+MainWindow::~MainWindow() {
+  // Loading cannot be interrupted, but it must not outlive the window
+  if (warmupThread != nullptr)
+    warmupThread->wait();
+}
+
+void MainWindow::startWarmup() {
+  if (warmupThread != nullptr)
+    return;
+
+  warmupProgress->show();
+  warmupThread = QThread::create([this] {
+    FoodRepository::instance().ensureCacheLoaded(
+        [this](int step, int stepCount, const QString &label) {
+          QMetaObject::invokeMethod(
+              this,
+              [this, step, stepCount, label] {
+                onWarmupProgress(step, stepCount, label);
+              },
+              Qt::QueuedConnection);
+        });
+  });
+  warmupThread->setParent(this);
+  connect(warmupThread, &QThread::finished, this,
+          &MainWindow::onWarmupFinished);
+  warmupThread->start();
+}
+
+bool MainWindow::openJournal(const QString &path) {
+  QElapsedTimer timer;
+  timer.start();
+  const bool opened = journal.open(path);
+  if (opened) {
+    qDebug() << "Meal journal:" << journal.entryCount() << "entries read in"
+             << timer.elapsed() << "ms";
+  }
+  mealWidget->setJournal(&journal);
+  historyWidget->setJournal(&journal);
+  return opened;
+}
+
+void MainWindow::onWarmupProgress(int step, int stepCount,
+                                  const QString &label) {
+  warmupProgress->setRange(0, stepCount);
+  warmupProgress->setValue(step);
+  statusBar()->showMessage(label + "...");
+}
+
+void MainWindow::onWarmupFinished() {
+  warmupProgress->hide();
+  const LoadTimings timings = FoodRepository::instance().loadTimings();
+  qDebug().noquote() << "Startup:" << timings.summary();
+
+  auto snapshot = FoodRepository::instance().snapshot();
+  if (snapshot) {
+    rankingWidget->refresh();
+    statusBar()->showMessage(
+        QString("Ready: %1 foods").arg(snapshot->corpus.size()), 5000);
+  } else {
+    statusBar()->showMessage("Could not load the food database");
+  }
+}
 
 void MainWindow::setupUi() {
   setWindowTitle("Nutrient Coach");
@@ -22,6 +85,12 @@ void MainWindow::setupUi() {
   tabs = new QTabWidget(this);
   mainLayout->addWidget(tabs);
 
+  warmupProgress = new QProgressBar(this);
+  warmupProgress->setMaximumWidth(200);
+  warmupProgress->setTextVisible(false);
+  warmupProgress->hide();
+  statusBar()->addPermanentWidget(warmupProgress);
+
   // Search Tab
   searchWidget = new SearchWidget(this);
   tabs->addTab(searchWidget, "Search Foods");
@@ -38,10 +107,25 @@ void MainWindow::setupUi() {
   detailsWidget = new DetailsWidget(this);
   tabs->addTab(detailsWidget, "Analyze");
 
+  // Ranking Tab
+  rankingWidget = new RankingWidget(this);
+  tabs->addTab(rankingWidget, "Top Foods");
+  connect(rankingWidget, &RankingWidget::foodSelected, this,
+          [=](int foodId, const QString &foodName) {
+            detailsWidget->loadFood(foodId, foodName);
+            tabs->setCurrentWidget(detailsWidget);
+          });
+
   // Meal Tab
   mealWidget = new MealWidget(this);
   tabs->addTab(mealWidget, "Meal Tracker");
 
+  // History Tab
+  historyWidget = new HistoryWidget(this);
+  tabs->addTab(historyWidget, "History");
+  connect(mealWidget, &MealWidget::mealLogged, historyWidget,
+          &HistoryWidget::refresh);
+
   // Connect Analysis -> Meal
   connect(detailsWidget, &DetailsWidget::addToMeal, this,
           [=](int foodId, const QString &foodName, double grams) {
@@ -0,0 +1,306 @@
+#include "meal/mealoptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// One squared term of the objective: a goal's target or its upper limit,
+// with the meal's total expressed as a fraction of it
+struct Term {
+  int definition;
+  double reference; // Target or limit
+  double weight;
+  bool isLimit;
+};
+
+// How far a term is from being met; limits only count once exceeded
+double residual(const Term &term, double fraction) {
+  if (term.isLimit)
+    return std::max(0.0, fraction - 1.0);
+  return fraction - 1.0;
+}
+
+// The problem in the form the steps work on: a dense food x term matrix,
+// one contiguous row per food, holding the fraction of each term's
+// reference that one gram of the food provides
+struct Problem {
+  std::vector<Term> terms;
+  std::vector<double> matrix;
+  int foodCount = 0;
+  int termCount = 0;
+  double maxGrams = 0.0;
+
+  [[nodiscard]] const double *row(int food) const {
+    return matrix.data() + static_cast<size_t>(food) * termCount;
+  }
+
+  // The meal's total for each term, as a fraction of its reference
+  void fractionsAt(const std::vector<double> &grams,
+                   std::vector<double> &fractions) const {
+    fractions.assign(termCount, 0.0);
+    for (int i = 0; i < foodCount; ++i) {
+      const double *r = row(i);
+      for (int k = 0; k < termCount; ++k)
+        fractions[k] += r[k] * grams[i];
+    }
+  }
+
+  // Half the objective, which is what the gradient and Hessian below are of
+  [[nodiscard]] double
+  halfObjective(const std::vector<double> &fractions) const {
+    double sum = 0.0;
+    for (int k = 0; k < termCount; ++k) {
+      const double r = residual(terms[k], fractions[k]);
+      sum += terms[k].weight * r * r;
+    }
+    return 0.5 * sum;
+  }
+
+  void gradientAt(const std::vector<double> &fractions,
+                  std::vector<double> &gradient) const {
+    gradient.assign(foodCount, 0.0);
+    for (int i = 0; i < foodCount; ++i) {
+      const double *r = row(i);
+      double sum = 0.0;
+      for (int k = 0; k < termCount; ++k)
+        sum += terms[k].weight * r[k] * residual(terms[k], fractions[k]);
+      gradient[i] = sum;
+    }
+  }
+};
+
+// Solves h x = b for a symmetric positive definite m x m matrix, leaving x
+// in b. h is overwritten with its Cholesky factor. False if h is not
+// positive definite.
+bool choleskySolve(std::vector<double> &h, std::vector<double> &b, int m) {
+  for (int j = 0; j < m; ++j) {
+    double diagonal = h[j * m + j];
+    for (int p = 0; p < j; ++p)
+      diagonal -= h[j * m + p] * h[j * m + p];
+    if (diagonal <= 0.0)
+      return false;
+    const double pivot = std::sqrt(diagonal);
+    h[j * m + j] = pivot;
+    for (int i = j + 1; i < m; ++i) {
+      double value = h[i * m + j];
+      for (int p = 0; p < j; ++p)
+        value -= h[i * m + p] * h[j * m + p];
+      h[i * m + j] = value / pivot;
+    }
+  }
+  for (int i = 0; i < m; ++i) {
+    for (int p = 0; p < i; ++p)
+      b[i] -= h[i * m + p] * b[p];
+    b[i] /= h[i * m + i];
+  }
+  for (int i = m - 1; i >= 0; --i) {
+    for (int p = i + 1; p < m; ++p)
+      b[i] -= h[p * m + i] * b[p];
+    b[i] /= h[i * m + i];
+  }
+  return true;
+}
+
+// Backtracks along the projection of x + t * step onto the bounds until the
+// objective drops enough, leaving the new point in x and fractions. False if
+// it never does.
+bool projectedSearch(const Problem &problem,
+                     const std::vector<double> &gradient,
+                     const std::vector<double> &step, std::vector<double> &x,
+                     std::vector<double> &fractions) {
+  const double current = problem.halfObjective(fractions);
+  std::vector<double> trial(x.size());
+  std::vector<double> trialFractions;
+  double t = 1.0;
+  for (int halving = 0; halving < 40; ++halving, t *= 0.5) {
+    double decrease = 0.0; // Predicted by the gradient
+    double largestMove = 0.0;
+    for (size_t i = 0; i < x.size(); ++i) {
+      trial[i] = std::min(std::max(x[i] + t * step[i], 0.0), problem.maxGrams);
+      decrease += gradient[i] * (trial[i] - x[i]);
+      largestMove = std::max(largestMove, std::abs(trial[i] - x[i]));
+    }
+    if (largestMove == 0.0)
+      return true;
+    problem.fractionsAt(trial, trialFractions);
+    if (problem.halfObjective(trialFractions) <= current + 1e-4 * decrease) {
+      x.swap(trial);
+      fractions.swap(trialFractions);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Projected Newton steps until no food moves by more than the tolerance or
+// the iteration budget runs out. Foods held at a bound by the gradient stay
+// there; the others take a Newton step over the target terms and the limit
+// terms exceeded right now.
+void solve(const Problem &problem, const std::vector<double> &targetHessian,
+           const MealOptimizerOptions &options, MealSolution &solution,
+           std::vector<double> &fractions) {
+  const int n = problem.foodCount;
+  std::vector<double> &x = solution.grams;
+  std::vector<double> gradient;
+  std::vector<double> step(n);
+  std::vector<int> free;
+  std::vector<double> hessian;
+  std::vector<double> diagonal;
+  std::vector<double> rhs;
+  solution.converged = false;
+  while (solution.iterations < options.maxIterations) {
+    ++solution.iterations;
+    problem.gradientAt(fractions, gradient);
+
+    // Within the tolerance of a bound counts as on it, or a Newton step
+    // would be cut short by foods a hair away from 0 g
+    free.clear();
+    for (int i = 0; i < n; ++i) {
+      const bool held =
+          (x[i] <= options.tolerance && gradient[i] > 0.0) ||
+          (x[i] >= problem.maxGrams - options.tolerance && gradient[i] < 0.0);
+      if (!held)
+        free.push_back(i);
+    }
+    if (free.empty()) {
+      solution.converged = true;
+      return;
+    }
+
+    const int m = static_cast<int>(free.size());
+    hessian.assign(static_cast<size_t>(m) * m, 0.0);
+    for (int a = 0; a < m; ++a) {
+      for (int b = 0; b <= a; ++b)
+        hessian[a * m + b] = targetHessian[free[a] * n + free[b]];
+    }
+    for (int k = 0; k < problem.termCount; ++k) {
+      const Term &term = problem.terms[k];
+      if (!term.isLimit || fractions[k] <= 1.0)
+        continue;
+      for (int a = 0; a < m; ++a) {
+        const double ra = term.weight * problem.row(free[a])[k];
+        if (ra == 0.0)
+          continue;
+        for (int b = 0; b <= a; ++b)
+          hessian[a * m + b] += ra * problem.row(free[b])[k];
+      }
+    }
+    // A little ridge keeps foods that no goal depends on solvable
+    double largestDiagonal = 0.0;
+    for (int a = 0; a < m; ++a)
+      largestDiagonal = std::max(largestDiagonal, hessian[a * m + a]);
+    const double ridge = 1e-12 * largestDiagonal + 1e-300;
+    for (int a = 0; a < m; ++a)
+      hessian[a * m + a] += ridge;
+    diagonal.resize(m);
+    for (int a = 0; a < m; ++a)
+      diagonal[a] = hessian[a * m + a];
+
+    rhs.resize(m);
+    for (int a = 0; a < m; ++a)
+      rhs[a] = -gradient[free[a]];
+    std::fill(step.begin(), step.end(), 0.0);
+    bool moved = false;
+    double fullMove = 0.0;
+    if (choleskySolve(hessian, rhs, m)) {
+      for (int a = 0; a < m; ++a) {
+        const int i = free[a];
+        step[i] = rhs[a];
+        const double target =
+            std::min(std::max(x[i] + step[i], 0.0), problem.maxGrams);
+        fullMove = std::max(fullMove, std::abs(target - x[i]));
+      }
+      moved = projectedSearch(problem, gradient, step, x, fractions);
+    }
+    // The bounds can turn a Newton step uphill; a diagonally scaled
+    // gradient step cannot be
+    if (!moved) {
+      for (int a = 0; a < m; ++a)
+        step[free[a]] = -gradient[free[a]] / diagonal[a];
+      if (!projectedSearch(problem, gradient, step, x, fractions))
+        return;
+    }
+    if (moved && fullMove <= options.tolerance) {
+      solution.converged = true;
+      return;
+    }
+  }
+}
+
+} // namespace
+
+MealSolution optimizeMeal(const std::vector<const NutrientVector *> &foods,
+                          const std::vector<NutrientGoal> &goals,
+                          const std::vector<double> &grams,
+                          const MealOptimizerOptions &options) {
+  MealSolution solution;
+  Problem problem;
+  problem.foodCount = static_cast<int>(foods.size());
+  problem.maxGrams = options.maxGrams;
+  const int n = problem.foodCount;
+  solution.grams.resize(n, 0.0);
+  for (int i = 0; i < n && i < static_cast<int>(grams.size()); ++i)
+    solution.grams[i] = std::min(std::max(grams[i], 0.0), options.maxGrams);
+
+  for (const NutrientGoal &goal : goals) {
+    if (goal.target > 0)
+      problem.terms.push_back({goal.definition, goal.target, 1.0, false});
+    if (goal.upperLimit > 0)
+      problem.terms.push_back(
+          {goal.definition, goal.upperLimit, options.limitWeight, true});
+  }
+  problem.termCount = static_cast<int>(problem.terms.size());
+  problem.matrix.resize(static_cast<size_t>(n) * problem.termCount);
+  for (int i = 0; i < n; ++i) {
+    double *row =
+        problem.matrix.data() + static_cast<size_t>(i) * problem.termCount;
+    for (int k = 0; k < problem.termCount; ++k)
+      row[k] = foods[i]->amount(problem.terms[k].definition) / 100.0 /
+               problem.terms[k].reference;
+  }
+
+  // Target terms never switch off, so their part of the Hessian is
+  // computed once; its lower triangle is all the steps read
+  std::vector<double> targetHessian(static_cast<size_t>(n) * n, 0.0);
+  for (int k = 0; k < problem.termCount; ++k) {
+    if (problem.terms[k].isLimit)
+      continue;
+    for (int i = 0; i < n; ++i) {
+      const double ri = problem.row(i)[k];
+      if (ri == 0.0)
+        continue;
+      for (int j = 0; j <= i; ++j)
+        targetHessian[i * n + j] += ri * problem.row(j)[k];
+    }
+  }
+
+  std::vector<double> fractions;
+  problem.fractionsAt(solution.grams, fractions);
+  auto exceeded = [&](int k) {
+    return problem.terms[k].isLimit &&
+           fractions[k] > 1.0 + options.limitTolerance;
+  };
+  for (int round = 0;; ++round) {
+    solve(problem, targetHessian, options, solution, fractions);
+    bool anyExceeded = false;
+    for (int k = 0; k < problem.termCount; ++k)
+      anyExceeded = anyExceeded || exceeded(k);
+    if (!anyExceeded || round >= options.limitRounds ||
+        solution.iterations >= options.maxIterations)
+      break;
+    for (Term &term : problem.terms) {
+      if (term.isLimit)
+        term.weight *= 100.0;
+    }
+  }
+
+  for (int k = 0; k < problem.termCount; ++k) {
+    const Term &term = problem.terms[k];
+    const double r = residual(term, fractions[k]);
+    solution.objective += (term.isLimit ? options.limitWeight : 1.0) * r * r;
+    if (exceeded(k))
+      solution.exceededLimits.push_back(term.definition);
+  }
+  std::sort(solution.exceededLimits.begin(), solution.exceededLimits.end());
+  return solution;
+}
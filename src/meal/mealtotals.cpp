@@ -0,0 +1,72 @@
+#include "meal/mealtotals.h"
+#include <algorithm>
+
+namespace {
+
+template <typename Nutrients>
+NutrientVector toVector(const Nutrients &nutrients, int definitionCount) {
+  NutrientVector vector;
+  vector.amounts.assign(definitionCount, 0.0);
+  for (const Nutrient nut : nutrients) {
+    if (nut.index >= definitionCount)
+      continue;
+    vector.amounts[nut.index] = nut.amount;
+    vector.reported.push_back(nut.index);
+  }
+  std::sort(vector.reported.begin(), vector.reported.end());
+  return vector;
+}
+
+} // namespace
+
+NutrientVector
+NutrientVector::fromNutrients(const std::vector<Nutrient> &nutrients,
+                              int definitionCount) {
+  return toVector(nutrients, definitionCount);
+}
+
+NutrientVector NutrientVector::fromNutrients(const FoodNutrients &nutrients,
+                                             int definitionCount) {
+  return toVector(nutrients, definitionCount);
+}
+
+double NutrientVector::amount(int definition) const {
+  if (definition < 0 || definition >= static_cast<int>(amounts.size()))
+    return 0.0;
+  return amounts[definition];
+}
+
+void MealTotals::reset(int definitionCount) {
+  m_totals.assign(definitionCount, 0.0);
+  m_reporters.assign(definitionCount, 0);
+}
+
+void MealTotals::addFood(const NutrientVector &food, double grams) {
+  for (int definition : food.reported)
+    ++m_reporters[definition];
+  scaleAdd(food, grams / 100.0);
+}
+
+void MealTotals::removeFood(const NutrientVector &food, double grams) {
+  scaleAdd(food, -grams / 100.0);
+  for (int definition : food.reported) {
+    // Whatever rounding left behind belongs to nobody
+    if (--m_reporters[definition] == 0)
+      m_totals[definition] = 0.0;
+  }
+}
+
+void MealTotals::changeGrams(const NutrientVector &food, double oldGrams,
+                             double newGrams) {
+  scaleAdd(food, (newGrams - oldGrams) / 100.0);
+}
+
+void MealTotals::scaleAdd(const NutrientVector &food, double factor) {
+  // A plain dense loop, which the compiler vectorizes; unreported slots
+  // are 0 and add nothing
+  const size_t count = std::min(m_totals.size(), food.amounts.size());
+  double *totals = m_totals.data();
+  const double *amounts = food.amounts.data();
+  for (size_t i = 0; i < count; ++i)
+    totals[i] += amounts[i] * factor;
+}
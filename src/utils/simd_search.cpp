@@ -0,0 +1,212 @@
+#include "utils/simd_search.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NUTRA_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define NUTRA_TARGET_AVX2
+#else
+#define NUTRA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace Utils {
+
+namespace {
+
+bool containsScalar(const char *h, int n, const char *s, int k, int from) {
+  for (int i = from; i + k <= n; ++i) {
+    if (h[i] == s[0] && std::memcmp(h + i + 1, s + 1, k - 1) == 0)
+      return true;
+  }
+  return false;
+}
+
+void dotsScalar(const float *q, const float *rows, int d, int count,
+                float *out) {
+  for (int r = 0; r < count; ++r) {
+    const float *row = rows + static_cast<size_t>(r) * d;
+    float sum = 0.0F;
+    for (int j = 0; j < d; ++j)
+      sum += q[j] * row[j];
+    out[r] = sum;
+  }
+}
+
+#ifdef NUTRA_SIMD_X86
+
+// Compare a block of candidate start positions against the needle's first and
+// last bytes at once, then verify the (few) positions where both match.
+// See Wojciech Mula, "SIMD-friendly algorithms for substring searching".
+
+bool containsSse2(const char *h, int n, const char *s, int k) {
+  const __m128i first = _mm_set1_epi8(s[0]);
+  const __m128i last = _mm_set1_epi8(s[k - 1]);
+
+  int i = 0;
+  for (; i + k - 1 + 16 <= n; i += 16) {
+    const __m128i blockFirst =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i));
+    const __m128i blockLast =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i + k - 1));
+    auto mask = static_cast<quint32>(_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast))));
+    while (mask != 0) {
+      const int pos = i + static_cast<int>(qCountTrailingZeroBits(mask));
+      if (std::memcmp(h + pos + 1, s + 1, k - 2) == 0)
+        return true;
+      mask &= mask - 1;
+    }
+  }
+  return containsScalar(h, n, s, k, i);
+}
+
+NUTRA_TARGET_AVX2 bool containsAvx2(const char *h, int n, const char *s,
+                                    int k) {
+  const __m256i first = _mm256_set1_epi8(s[0]);
+  const __m256i last = _mm256_set1_epi8(s[k - 1]);
+
+  int i = 0;
+  for (; i + k - 1 + 32 <= n; i += 32) {
+    const __m256i blockFirst =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(h + i));
+    const __m256i blockLast =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(h + i + k - 1));
+    auto mask = static_cast<quint32>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst),
+                         _mm256_cmpeq_epi8(last, blockLast))));
+    while (mask != 0) {
+      const int pos = i + static_cast<int>(qCountTrailingZeroBits(mask));
+      if (std::memcmp(h + pos + 1, s + 1, k - 2) == 0)
+        return true;
+      mask &= mask - 1;
+    }
+  }
+  return containsScalar(h, n, s, k, i);
+}
+
+// Rows are scored with several accumulators each so the adds of one row do
+// not wait on each other; the few trailing dimensions are added scalar.
+
+float horizontalSum(__m128 v) {
+  const __m128 pairs = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+
+void dotsSse2(const float *q, const float *rows, int d, int count,
+              float *out) {
+  for (int r = 0; r < count; ++r) {
+    const float *row = rows + static_cast<size_t>(r) * d;
+    __m128 a = _mm_setzero_ps();
+    __m128 b = _mm_setzero_ps();
+    int j = 0;
+    for (; j + 8 <= d; j += 8) {
+      a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(q + j), _mm_loadu_ps(row + j)));
+      b = _mm_add_ps(
+          b, _mm_mul_ps(_mm_loadu_ps(q + j + 4), _mm_loadu_ps(row + j + 4)));
+    }
+    float sum = horizontalSum(_mm_add_ps(a, b));
+    for (; j < d; ++j)
+      sum += q[j] * row[j];
+    out[r] = sum;
+  }
+}
+
+NUTRA_TARGET_AVX2 void dotsAvx2(const float *q, const float *rows, int d,
+                                int count, float *out) {
+  for (int r = 0; r < count; ++r) {
+    const float *row = rows + static_cast<size_t>(r) * d;
+    __m256 a = _mm256_setzero_ps();
+    __m256 b = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 16 <= d; j += 16) {
+      a = _mm256_add_ps(
+          a, _mm256_mul_ps(_mm256_loadu_ps(q + j), _mm256_loadu_ps(row + j)));
+      b = _mm256_add_ps(b, _mm256_mul_ps(_mm256_loadu_ps(q + j + 8),
+                                         _mm256_loadu_ps(row + j + 8)));
+    }
+    if (j + 8 <= d) {
+      a = _mm256_add_ps(
+          a, _mm256_mul_ps(_mm256_loadu_ps(q + j), _mm256_loadu_ps(row + j)));
+      j += 8;
+    }
+    const __m256 ab = _mm256_add_ps(a, b);
+    float sum = horizontalSum(_mm_add_ps(_mm256_castps256_ps128(ab),
+                                         _mm256_extractf128_ps(ab, 1)));
+    for (; j < d; ++j)
+      sum += q[j] * row[j];
+    out[r] = sum;
+  }
+}
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && // OSXSAVE
+                          (info[2] & (1 << 28)) != 0 && // AVX
+                          (_xgetbv(0) & 0x6) == 0x6;
+  __cpuidex(info, 7, 0);
+  return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // NUTRA_SIMD_X86
+
+using ContainsKernel = bool (*)(const char *, int, const char *, int);
+using DotsKernel = void (*)(const float *, const float *, int, int, float *);
+
+struct Dispatch {
+  ContainsKernel contains;
+  DotsKernel dots;
+  const char *name;
+};
+
+const Dispatch &dispatch() {
+  static const Dispatch selected = [] {
+#ifdef NUTRA_SIMD_X86
+    if (cpuHasAvx2())
+      return Dispatch{containsAvx2, dotsAvx2, "avx2"};
+    return Dispatch{containsSse2, dotsSse2, "sse2"};
+#else
+    return Dispatch{[](const char *h, int n, const char *s, int k) {
+                      return containsScalar(h, n, s, k, 0);
+                    },
+                    dotsScalar, "scalar"};
+#endif
+  }();
+  return selected;
+}
+
+} // namespace
+
+bool asciiContains(const char *haystack, int haystackLen, const char *needle,
+                   int needleLen) {
+  if (needleLen <= 0)
+    return true;
+  if (needleLen > haystackLen)
+    return false;
+  if (needleLen == 1)
+    return std::memchr(haystack, needle[0], haystackLen) != nullptr;
+  return dispatch().contains(haystack, haystackLen, needle, needleLen);
+}
+
+const char *asciiContainsKernel() { return dispatch().name; }
+
+void dotProducts(const float *query, const float *rows, int dimensions,
+                 int rowCount, float *out) {
+  if (rowCount <= 0)
+    return;
+  dispatch().dots(query, rows, dimensions, rowCount, out);
+}
+
+} // namespace Utils
@@ -1,14 +1,11 @@
 #include "utils/string_utils.h"
-#include <QRegularExpression>
-#include <QStringList>
+#include "utils/simd_search.h"
 #include <QtGlobal>
 #include <algorithm> // Required for std::max
 #include <cmath>
-
-#ifndef QT_VERSION_CHECK
-#define QT_VERSION_CHECK(major, minor, patch)                                  \
-  ((major << 16) | (minor << 8) | (patch))
-#endif
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 
 namespace Utils {
 
@@ -38,7 +35,185 @@ int levenshteinDistance(const QString &s1, const QString &s2) {
   return dp[m][n];
 }
 
-int calculateFuzzyScore(const QString &query, const QString &target) {
+namespace {
+
+// Myers/Hyyro bit-parallel edit distance; the pattern must be 1-64
+// characters. Stops with maxDistance + 1 once the distance is known to
+// exceed maxDistance.
+int myersDistance(const QChar *pattern, int m, const QChar *text, int n,
+                  int maxDistance) {
+  // Match masks per character: ASCII via table, anything else by scanning
+  quint64 asciiPeq[128] = {};
+  for (int i = 0; i < m; ++i) {
+    const ushort c = pattern[i].unicode();
+    if (c < 128)
+      asciiPeq[c] |= quint64(1) << i;
+  }
+
+  const quint64 last = quint64(1) << (m - 1);
+  quint64 pv = ~quint64(0);
+  quint64 mv = 0;
+  int score = m;
+
+  for (int j = 0; j < n; ++j) {
+    const ushort c = text[j].unicode();
+    quint64 eq = 0;
+    if (c < 128) {
+      eq = asciiPeq[c];
+    } else {
+      for (int i = 0; i < m; ++i) {
+        if (pattern[i].unicode() == c)
+          eq |= quint64(1) << i;
+      }
+    }
+
+    const quint64 xv = eq | mv;
+    const quint64 xh = (((eq & pv) + pv) ^ pv) | eq;
+    quint64 ph = mv | ~(xh | pv);
+    quint64 mh = pv & xh;
+    if ((ph & last) != 0U)
+      ++score;
+    else if ((mh & last) != 0U)
+      --score;
+
+    // Each remaining text character can lower the distance by at most one
+    if (score - (n - 1 - j) > maxDistance)
+      return maxDistance + 1;
+
+    ph = (ph << 1) | 1U;
+    mh <<= 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+  }
+
+  return score;
+}
+
+int boundedDistance(const QChar *a, int m, const QChar *b, int n,
+                    int maxDistance) {
+  if (m > n) {
+    std::swap(a, b);
+    std::swap(m, n);
+  }
+
+  // Outside the band: the length difference alone exceeds the budget
+  if (n - m > maxDistance)
+    return maxDistance + 1;
+  if (m == 0)
+    return n;
+  if (m > 64)
+    return std::min(levenshteinDistance(QString::fromRawData(a, m),
+                                        QString::fromRawData(b, n)),
+                    maxDistance + 1);
+
+  return myersDistance(a, m, b, n, maxDistance);
+}
+
+// ASCII whitespace, commas and dashes, plus any Unicode space (no-break,
+// em and the like, which branded descriptions contain)
+bool isTokenSeparator(ushort c) {
+  if (c < 0x80)
+    return c == ' ' || (c >= '\t' && c <= '\r') || c == ',' || c == '-';
+  return QChar(c).isSpace();
+}
+
+// A token scoring at most this counts as unmatched, and any unmatched token
+// costs the whole score the penalty
+constexpr int kUnmatchedTokenScore = 60;
+constexpr int kUnmatchedPenalty = 20;
+
+int ratioScore(int dist, int maxLen) {
+  double ratio = 1.0 - (static_cast<double>(dist) / maxLen);
+  return static_cast<int>(ratio * 100);
+}
+
+// Largest distance whose ratio score still beats minScore, or -1
+int maxDistanceAbove(int minScore, int maxLen) {
+  int dist = (maxLen * (100 - minScore)) / 100;
+  while (dist >= 0 && ratioScore(dist, maxLen) <= minScore)
+    --dist;
+  return dist;
+}
+
+} // namespace
+
+int fastLevenshteinDistance(const QString &s1, const QString &s2) {
+  const int maxLen = static_cast<int>(std::max(s1.length(), s2.length()));
+  return boundedLevenshteinDistance(s1, s2, maxLen);
+}
+
+int boundedLevenshteinDistance(const QString &s1, const QString &s2,
+                               int maxDistance) {
+  return boundedDistance(s1.constData(), static_cast<int>(s1.length()),
+                         s2.constData(), static_cast<int>(s2.length()),
+                         maxDistance);
+}
+
+FoldedTextView FuzzyQuery::view() const {
+  return {text.constData(), static_cast<int>(text.length()), tokens.data(),
+          static_cast<int>(tokens.size()),
+          ascii.isEmpty() ? nullptr : ascii.constData()};
+}
+
+FuzzyQuery prepareFuzzyQuery(const QString &query) {
+  FuzzyQuery prepared;
+  prepared.text = query.toLower();
+  const int length = static_cast<int>(prepared.text.length());
+  appendTokenSpans(prepared.text.constData(), length, prepared.tokens);
+
+  QByteArray ascii(length, Qt::Uninitialized);
+  if (narrowToAscii(prepared.text.constData(), length, ascii.data()))
+    prepared.ascii = ascii;
+  return prepared;
+}
+
+QString normalizeQuery(const QString &query) {
+  const QString folded = query.toLower();
+  QString normalized;
+  normalized.reserve(folded.length());
+
+  bool pendingSpace = false;
+  for (const QChar c : folded) {
+    if (c.isSpace() || QStringLiteral(",;:-/()").contains(c)) {
+      pendingSpace = !normalized.isEmpty();
+      continue;
+    }
+    if (pendingSpace)
+      normalized += QLatin1Char(' ');
+    pendingSpace = false;
+    normalized += c;
+  }
+  return normalized;
+}
+
+bool splitCsvRecord(const QString &text, QStringList &fields) {
+  fields.clear();
+  QString field;
+  bool quoted = false;
+  for (int i = 0; i < text.length(); ++i) {
+    const QChar c = text[i];
+    if (quoted) {
+      if (c != QLatin1Char('"'))
+        field += c;
+      else if (i + 1 < text.length() && text[i + 1] == QLatin1Char('"'))
+        field += text[++i];
+      else
+        quoted = false;
+    } else if (c == QLatin1Char('"')) {
+      quoted = true;
+    } else if (c == QLatin1Char(',')) {
+      fields << field;
+      field.clear();
+    } else {
+      field += c;
+    }
+  }
+  fields << field;
+  return !quoted;
+}
+
+int calculateFuzzyScore(const QString &query, const QString &target,
+                        int threshold) {
   if (query.isEmpty()) {
     return 0;
   }
@@ -46,67 +221,284 @@ int calculateFuzzyScore(const QString &query, const QString &target) {
     return 0;
   }
 
-  QString q = query.toLower();
-  QString t = target.toLower();
+  const FuzzyQuery q = prepareFuzzyQuery(query);
+  const QString t = target.toLower();
+  std::vector<TokenSpan> targetTokens;
+  appendTokenSpans(t.constData(), static_cast<int>(t.length()), targetTokens);
 
-  // 1. Exact match bonus
-  if (t == q) {
-    return 100;
+  return calculateFuzzyScore(q,
+                             {t.constData(), static_cast<int>(t.length()),
+                              targetTokens.data(),
+                              static_cast<int>(targetTokens.size()), nullptr},
+                             threshold);
+}
+
+int calculateFuzzyScore(const FuzzyQuery &query, const FoldedTextView &target,
+                        int threshold) {
+  const FoldedTextView q = query.view();
+  const QChar *t = target.text;
+  if (q.length == 0 || target.length == 0) {
+    return 0;
   }
 
-  // 2. Contains match bonus (very strong signal)
-  if (t.contains(q)) {
-    return 90; // Base score for containing the string
+  if (q.ascii != nullptr && target.ascii != nullptr) {
+    // ASCII query against 8-bit text: byte compares and SIMD search
+    if (q.length == target.length &&
+        std::memcmp(q.ascii, target.ascii, q.length) == 0) {
+      return 100;
+    }
+    if (asciiContains(target.ascii, target.length, q.ascii, q.length)) {
+      return 90;
+    }
+  } else {
+    // 1. Exact match bonus
+    if (q.length == target.length &&
+        std::equal(q.text, q.text + q.length, t)) {
+      return 100;
+    }
+
+    // 2. Contains match bonus (very strong signal)
+    if (std::search(t, t + target.length, q.text, q.text + q.length) !=
+        t + target.length) {
+      return 90; // Base score for containing the string
+    }
   }
 
   // 3. Token-based matching (handling "grass fed" vs "beef, grass-fed")
-  static const QRegularExpression regex("[\\s,-]+");
-#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
-  auto behavior = Qt::SkipEmptyParts;
-#else
-  auto behavior = QString::SkipEmptyParts;
-#endif
-  QStringList queryTokens = q.split(regex, behavior);
-  QStringList targetTokens = t.split(regex, behavior);
+  if (q.tokenCount == 0) {
+    return 0;
+  }
 
+  const int tokenCount = q.tokenCount;
   int totalScore = 0;
   int matchedTokens = 0;
 
-  for (const QString &qToken : queryTokens) {
+  for (int i = 0; i < tokenCount; ++i) {
+    const QChar *qToken = q.text + q.tokens[i].start;
+    const int qLen = q.tokens[i].length;
+
+    // Lowest score this token may get with the result still above threshold,
+    // assuming every later token matches perfectly and none is penalized
+    const int others = totalScore + 100 * (tokenCount - 1 - i);
+    const int withPenalty =
+        (threshold + 1 + kUnmatchedPenalty) * tokenCount - others;
+    const int withoutPenalty = (threshold + 1) * tokenCount - others;
+    const int floorScore =
+        withPenalty <= kUnmatchedTokenScore
+            ? withPenalty
+            : std::max(kUnmatchedTokenScore + 1, withoutPenalty);
+    if (floorScore > 100)
+      return 0;
+
     int maxTokenScore = 0;
-    for (const QString &tToken : targetTokens) {
-      int dist = levenshteinDistance(qToken, tToken);
-      int maxLen = static_cast<int>(std::max(qToken.length(), tToken.length()));
+    for (int j = 0; j < target.tokenCount; ++j) {
+      const QChar *tToken = t + target.tokens[j].start;
+      const int tLen = target.tokens[j].length;
+      int maxLen = std::max(qLen, tLen);
       if (maxLen == 0)
         continue;
 
       int score = 0;
-      if (tToken.startsWith(qToken)) {
+      if (tLen >= qLen && std::equal(qToken, qToken + qLen, tToken)) {
         score = 95; // Prefix match is very good
       } else {
-        double ratio = 1.0 - (static_cast<double>(dist) / maxLen);
-        score = static_cast<int>(ratio * 100);
+        // Only pay for the distance if it could raise this token's score
+        int maxDist =
+            maxDistanceAbove(std::max(maxTokenScore, floorScore - 1), maxLen);
+        if (maxDist < 0)
+          continue;
+        int dist = boundedDistance(qToken, qLen, tToken, tLen, maxDist);
+        if (dist > maxDist)
+          continue;
+        score = ratioScore(dist, maxLen);
       }
 
       maxTokenScore = std::max(maxTokenScore, score);
     }
+    if (maxTokenScore < floorScore)
+      return 0;
+
     totalScore += maxTokenScore;
-    if (maxTokenScore > 60)
+    if (maxTokenScore > kUnmatchedTokenScore)
       matchedTokens++;
   }
 
-  if (queryTokens.isEmpty()) {
+  int averageScore = totalScore / tokenCount;
+
+  // Penalize if not all tokens matched somewhat well
+  if (matchedTokens < tokenCount) {
+    averageScore -= kUnmatchedPenalty;
+  }
+
+  return std::max(0, averageScore);
+}
+
+int minSharedTrigrams(const FuzzyQuery &query, int threshold) {
+  if (query.tokens.empty())
     return 0;
+
+  // Some query token must score at least this: without the penalty every
+  // token beats kUnmatchedTokenScore and the average beats threshold, with
+  // it the average beats threshold + kUnmatchedPenalty
+  const int minTokenScore =
+      std::min(std::max(threshold + 1, kUnmatchedTokenScore + 1),
+               threshold + 1 + kUnmatchedPenalty);
+
+  int bound = std::numeric_limits<int>::max();
+  std::vector<quint64> keys;
+  for (const TokenSpan &token : query.tokens) {
+    const int n = token.length;
+    keys.clear();
+    appendTrigramKeys(query.text.constData() + token.start, n, keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // Most edits a target token of any length may be away and still score
+    // minTokenScore. Longer targets allow more edits but need at least the
+    // length difference, which soon grows faster.
+    int maxEdits = 0;
+    for (int maxLen = n;; ++maxLen) {
+      const int dist = maxDistanceAbove(minTokenScore - 1, maxLen);
+      if (dist < maxLen - n)
+        break;
+      if (maxLen > 8 * n)
+        return 0; // Thresholds this low match nearly anything
+      maxEdits = std::max(maxEdits, dist);
+    }
+
+    // Each edit changes at most three of the token's padded trigrams. An
+    // exact, substring or prefix match misses at most the two padded ends.
+    bound = std::min(bound, static_cast<int>(keys.size()) -
+                                std::max(2, 3 * maxEdits));
   }
+  return std::max(0, bound);
+}
 
-  int averageScore = static_cast<int>(totalScore / queryTokens.size());
+namespace {
 
-  // Penalize if not all tokens matched somewhat well
-  if (matchedTokens < queryTokens.size()) {
-    averageScore -= 20;
+// Highest score a query token of length n, whose best score against a target
+// is at most before, can reach against it after growing by grown characters
+int maxGrownTokenScore(int n, int grown, int before) {
+  // A prefix of some target token (95) stays one when shortened
+  if (before >= 95)
+    return 100;
+  if (grown == 0)
+    return before;
+
+  // Per target token length: the fewest edits the old token can be away
+  // while scoring at most before, less one per added character, but no
+  // fewer than the new length difference, and never 0, which would have
+  // made the old token a prefix. Longer target tokens than tried here
+  // score below 25 whatever the edits.
+  int best = 25;
+  const int grownLength = n + grown;
+  for (int m = 1; m <= 4 * grownLength + 8; ++m) {
+    const int maxLen = std::max(n, m);
+    int dist = std::abs(n - m);
+    while (ratioScore(dist, maxLen) > before)
+      ++dist;
+    const int newDist =
+        std::max({dist - grown, std::abs(grownLength - m), 1});
+    best = std::max(best, ratioScore(newDist, std::max(grownLength, m)));
   }
+  return best;
+}
 
-  return std::max(0, averageScore);
+} // namespace
+
+int maxExtendedScore(const FuzzyQuery &before, const FuzzyQuery &after,
+                     int scoreBefore) {
+  const int count = static_cast<int>(before.tokens.size());
+  if (count == 0 || !after.text.startsWith(before.text) ||
+      static_cast<int>(after.tokens.size()) < count)
+    return 100;
+
+  // Earlier tokens stay as they were, the last one may grow and new ones
+  // may follow. A new exact or contains match (90 and up) was already one,
+  // so only the token average can rise, through the grown token and the
+  // new ones, which are assumed to match perfectly.
+  const int n = before.tokens.back().length;
+  const int grown = after.tokens[count - 1].length - n;
+  const int added = static_cast<int>(after.tokens.size()) - count;
+  const int afterCount = count + added;
+
+  int best = 0;
+  for (int last = 0; last <= 100; ++last) {
+    const int grownScore = maxGrownTokenScore(n, grown, last);
+    // Whether an earlier token was unmatched, which keeps the penalty
+    for (const bool earlierUnmatched : {false, true}) {
+      if (earlierUnmatched && count == 1)
+        continue;
+      int lowest = 0;
+      int highest = 100 * (count - 1);
+      if (earlierUnmatched)
+        highest -= 100 - kUnmatchedTokenScore;
+      else
+        lowest = (kUnmatchedTokenScore + 1) * (count - 1);
+
+      // Largest sum of the earlier tokens that kept the old score at most
+      // scoreBefore. Without the penalty the average itself had to be low.
+      const bool penalized =
+          earlierUnmatched || last <= kUnmatchedTokenScore;
+      const int oldCap =
+          count * (scoreBefore + 1 + (penalized ? kUnmatchedPenalty : 0)) -
+          1 - last;
+      const int earlier = std::min(highest, oldCap);
+      if (earlier < lowest)
+        continue;
+
+      int score = (earlier + grownScore + 100 * added) / afterCount;
+      if (earlierUnmatched || grownScore <= kUnmatchedTokenScore)
+        score -= kUnmatchedPenalty;
+      best = std::max(best, score);
+    }
+  }
+  return best;
+}
+
+void appendTokenSpans(const QChar *text, int length,
+                      std::vector<TokenSpan> &spans) {
+  int i = 0;
+  while (i < length) {
+    while (i < length && isTokenSeparator(text[i].unicode()))
+      ++i;
+    const int start = i;
+    while (i < length && !isTokenSeparator(text[i].unicode()))
+      ++i;
+    if (i > start)
+      spans.push_back(
+          {static_cast<quint16>(start), static_cast<quint16>(i - start)});
+  }
+}
+
+bool narrowToAscii(const QChar *text, int length, char *out) {
+  bool ascii = true;
+  for (int i = 0; i < length; ++i) {
+    const ushort c = text[i].unicode();
+    if (c < 0x80) {
+      out[i] = static_cast<char>(c);
+    } else {
+      out[i] = static_cast<char>(0x80);
+      ascii = false;
+    }
+  }
+  return ascii;
+}
+
+void appendTrigramKeys(const QChar *token, int n,
+                       std::vector<quint64> &keys) {
+  if (n == 0)
+    return;
+
+  // Slide a 3-wide window over " token "
+  quint64 a = ' ';
+  quint64 b = token[0].unicode();
+  for (int i = 1; i <= n; ++i) {
+    const quint64 c = (i < n) ? token[i].unicode() : ' ';
+    keys.push_back((a << 32) | (b << 16) | c);
+    a = b;
+    b = c;
+  }
 }
 
 } // namespace Utils
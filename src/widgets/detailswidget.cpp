@@ -1,8 +1,10 @@
 #include "widgets/detailswidget.h"
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QVBoxLayout>
+#include <memory>
 
 DetailsWidget::DetailsWidget(QWidget *parent)
     : QWidget(parent), currentFoodId(-1) {
@@ -25,14 +27,68 @@ DetailsWidget::DetailsWidget(QWidget *parent)
   headerLayout->addWidget(addButton);
   layout->addLayout(headerLayout);
 
-  // Nutrients Table
-  nutrientsTable = new QTableWidget(this);
-  nutrientsTable->setColumnCount(3);
-  nutrientsTable->setHorizontalHeaderLabels({"Nutrient", "Amount", "Unit"});
-  nutrientsTable->horizontalHeader()->setSectionResizeMode(
-      0, QHeaderView::Stretch);
-  nutrientsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
-  layout->addWidget(nutrientsTable);
+  // Nutrients Table, in definition order until a header is clicked
+  nutrientsModel = new NutrientsModel(this);
+  nutrientsProxy = new QSortFilterProxyModel(this);
+  nutrientsProxy->setSourceModel(nutrientsModel);
+  nutrientsView = new QTableView(this);
+  nutrientsView->setModel(nutrientsProxy);
+  nutrientsView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+  nutrientsView->setSortingEnabled(true);
+  nutrientsView->horizontalHeader()->setSectionResizeMode(
+      NutrientsModel::NameColumn, QHeaderView::Stretch);
+  nutrientsView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  layout->addWidget(nutrientsView);
+
+  // Similar foods
+  auto *similarLayout = new QHBoxLayout();
+  similarLayout->addWidget(new QLabel("Similar foods", this));
+  similarBasisCombo = new QComboBox(this);
+  similarBasisCombo->addItem("per 100 g",
+                             static_cast<int>(NutrientBasis::Per100Grams));
+  similarBasisCombo->addItem("per 100 kcal",
+                             static_cast<int>(NutrientBasis::Per100Kcal));
+  similarMetricCombo = new QComboBox(this);
+  similarMetricCombo->addItem("by proportions",
+                              static_cast<int>(SimilarityMetric::Cosine));
+  similarMetricCombo->addItem("by amounts",
+                              static_cast<int>(SimilarityMetric::Euclidean));
+  similarLayout->addWidget(similarBasisCombo);
+  similarLayout->addWidget(similarMetricCombo);
+  similarLayout->addStretch();
+  layout->addLayout(similarLayout);
+  connect(similarBasisCombo,
+          QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+          &DetailsWidget::findSimilar);
+  connect(similarMetricCombo,
+          QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+          &DetailsWidget::findSimilar);
+
+  // Closest first until a header is clicked
+  similarModel = new SimilarFoodsModel(this);
+  similarProxy = new QSortFilterProxyModel(this);
+  similarProxy->setSourceModel(similarModel);
+  similarView = new QTableView(this);
+  similarView->setModel(similarProxy);
+  similarView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+  similarView->setSortingEnabled(true);
+  similarView->horizontalHeader()->setSectionResizeMode(
+      SimilarFoodsModel::DescriptionColumn, QHeaderView::Stretch);
+  similarView->setSelectionBehavior(QAbstractItemView::SelectRows);
+  similarView->setSelectionMode(QAbstractItemView::SingleSelection);
+  similarView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  connect(similarView, &QTableView::doubleClicked, this,
+          &DetailsWidget::onSimilarDoubleClicked);
+  layout->addWidget(similarView);
+
+  similarLabel = new QLabel(this);
+  layout->addWidget(similarLabel);
+}
+
+DetailsWidget::~DetailsWidget() {
+  // The search cannot be interrupted, but it must not outlive the widget
+  if (similarThread != nullptr)
+    similarThread->wait();
 }
 
 void DetailsWidget::loadFood(int foodId, const QString &foodName) {
@@ -41,18 +97,72 @@ void DetailsWidget::loadFood(int foodId, const QString &foodName) {
   nameLabel->setText(foodName + QString(" (ID: %1)").arg(foodId));
   addButton->setEnabled(true);
 
-  nutrientsTable->setRowCount(0);
+  nutrientsModel->setNutrients(
+      FoodRepository::instance().getFoodNutrients(foodId));
+
+  findSimilar();
+}
 
-  std::vector<Nutrient> nutrients = repository.getFoodNutrients(foodId);
+void DetailsWidget::findSimilar() {
+  if (currentFoodId == -1)
+    return;
 
-  nutrientsTable->setRowCount(static_cast<int>(nutrients.size()));
-  for (int i = 0; i < static_cast<int>(nutrients.size()); ++i) {
-    const auto &nut = nutrients[i];
-    nutrientsTable->setItem(i, 0, new QTableWidgetItem(nut.description));
-    nutrientsTable->setItem(i, 1,
-                            new QTableWidgetItem(QString::number(nut.amount)));
-    nutrientsTable->setItem(i, 2, new QTableWidgetItem(nut.unit));
+  SimilarityQuery query;
+  query.foodId = currentFoodId;
+  query.basis =
+      static_cast<NutrientBasis>(similarBasisCombo->currentData().toInt());
+  query.metric =
+      static_cast<SimilarityMetric>(similarMetricCombo->currentData().toInt());
+
+  // One search at a time; the latest request runs once it is done
+  if (similarThread != nullptr) {
+    similarStale = true;
+    return;
   }
+
+  // The first search on a basis builds its profiles, which can take seconds
+  struct Found {
+    std::vector<SimilarFood> similar;
+    qint64 elapsedMs = 0;
+  };
+  auto found = std::make_shared<Found>();
+  similarLabel->setText("Finding similar foods...");
+  similarThread = QThread::create([query, found] {
+    QElapsedTimer timer;
+    timer.start();
+    found->similar = FoodRepository::instance().similarFoods(query);
+    found->elapsedMs = timer.elapsed();
+  });
+  similarThread->setParent(this);
+  connect(similarThread, &QThread::finished, this, [this, found] {
+    similarThread->deleteLater();
+    similarThread = nullptr;
+    if (similarStale) {
+      similarStale = false;
+      findSimilar();
+      return;
+    }
+    qDebug() << "Similar foods found in" << found->elapsedMs << "ms";
+    showSimilar(std::move(found->similar));
+  });
+  similarThread->start();
+}
+
+void DetailsWidget::showSimilar(std::vector<SimilarFood> similar) {
+  similarLabel->setText(
+      similar.empty()
+          ? QString("No nutrient profile to compare on this basis")
+          : QString("%1 closest foods").arg(static_cast<int>(similar.size())));
+  similarModel->setFoods(std::move(similar));
+}
+
+void DetailsWidget::onSimilarDoubleClicked(const QModelIndex &index) {
+  const QModelIndex source = similarProxy->mapToSource(index);
+  if (!source.isValid())
+    return;
+  // Copied, since loading the food replaces the rows
+  const SimilarFood food = similarModel->food(source.row());
+  loadFood(food.id, food.description);
 }
 
 void DetailsWidget::onAddClicked() {
@@ -0,0 +1,95 @@
+#include "widgets/foodresultsmodel.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Every other column follows from the id
+bool sameRow(const FoodItem &a, const FoodItem &b) {
+  return a.id == b.id && a.score == b.score;
+}
+
+} // namespace
+
+FoodResultsModel::FoodResultsModel(QObject *parent)
+    : QAbstractTableModel(parent) {}
+
+void FoodResultsModel::setResults(std::vector<FoodItem> results) {
+  m_groups = &FoodRepository::instance().foodGroups();
+  const int oldCount = rowCount();
+  const int newCount = static_cast<int>(results.size());
+
+  if (newCount < oldCount) {
+    beginRemoveRows(QModelIndex(), newCount, oldCount - 1);
+    m_results.resize(newCount);
+    endRemoveRows();
+  }
+
+  // Partial results settling into the final ranking mostly keep their rows
+  const int common = std::min(oldCount, newCount);
+  int runStart = -1;
+  for (int row = 0; row <= common; ++row) {
+    const bool changed =
+        row < common && !sameRow(m_results[row], results[row]);
+    if (changed) {
+      m_results[row] = std::move(results[row]);
+      if (runStart < 0)
+        runStart = row;
+    } else if (runStart >= 0) {
+      emit dataChanged(index(runStart, 0), index(row - 1, ColumnCount - 1));
+      runStart = -1;
+    }
+  }
+
+  if (newCount > oldCount) {
+    beginInsertRows(QModelIndex(), oldCount, newCount - 1);
+    std::move(results.begin() + oldCount, results.end(),
+              std::back_inserter(m_results));
+    endInsertRows();
+  }
+}
+
+int FoodResultsModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(m_results.size());
+}
+
+int FoodResultsModel::columnCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant FoodResultsModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || role != Qt::DisplayRole)
+    return QVariant();
+
+  // Numbers stay numbers, so a sort proxy orders them by value
+  const FoodItem &item = m_results[index.row()];
+  switch (index.column()) {
+  case IdColumn:
+    return item.id;
+  case DescriptionColumn:
+    return item.description;
+  case GroupColumn:
+    return m_groups != nullptr ? m_groups->name(item.foodGroupId) : QString();
+  case NutrientsColumn:
+    return item.nutrientCount;
+  case AminoColumn:
+    return item.aminoCount;
+  case FlavonoidColumn:
+    return item.flavCount;
+  case ScoreColumn:
+    return item.score;
+  default:
+    return QVariant();
+  }
+}
+
+QVariant FoodResultsModel::headerData(int section, Qt::Orientation orientation,
+                                      int role) const {
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QAbstractTableModel::headerData(section, orientation, role);
+
+  static const char *const names[ColumnCount] = {
+      "ID", "Description", "Group", "Nutr", "Amino", "Flav", "Score"};
+  return section >= 0 && section < ColumnCount ? QString(names[section])
+                                               : QVariant();
+}
@@ -0,0 +1,88 @@
+#include "widgets/historywidget.h"
+#include "db/foodrepository.h"
+#include <QElapsedTimer>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <algorithm>
+
+HistoryWidget::HistoryWidget(QWidget *parent) : QWidget(parent) {
+  auto *layout = new QVBoxLayout(this);
+
+  // Range, the last week by default
+  auto *rangeLayout = new QHBoxLayout();
+  const QDate today = QDate::currentDate();
+  fromEdit = new QDateEdit(today.addDays(-6), this);
+  fromEdit->setCalendarPopup(true);
+  toEdit = new QDateEdit(today, this);
+  toEdit->setCalendarPopup(true);
+  rangeLayout->addWidget(new QLabel("From", this));
+  rangeLayout->addWidget(fromEdit);
+  rangeLayout->addWidget(new QLabel("to", this));
+  rangeLayout->addWidget(toEdit);
+  rangeLayout->addStretch();
+  layout->addLayout(rangeLayout);
+  connect(fromEdit, &QDateEdit::dateChanged, this, &HistoryWidget::refresh);
+  connect(toEdit, &QDateEdit::dateChanged, this, &HistoryWidget::refresh);
+
+  totalsTable = new QTableWidget(this);
+  totalsTable->setColumnCount(4);
+  totalsTable->setHorizontalHeaderLabels(
+      {"Nutrient", "Total", "Per Logged Day", "Unit"});
+  totalsTable->horizontalHeader()->setSectionResizeMode(0,
+                                                        QHeaderView::Stretch);
+  totalsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  layout->addWidget(totalsTable);
+
+  statusLabel = new QLabel(this);
+  layout->addWidget(statusLabel);
+}
+
+void HistoryWidget::setJournal(MealJournal *mealJournal) {
+  journal = mealJournal;
+  refresh();
+}
+
+void HistoryWidget::refresh() {
+  totalsTable->setRowCount(0);
+  if (journal == nullptr || !journal->isOpen()) {
+    statusLabel->setText("The meal journal could not be opened");
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  const JournalTotals totals =
+      journal->totals(fromEdit->date(), toEdit->date());
+  const qint64 elapsedMs = timer.elapsed();
+
+  const NutrientDefinitions &definitions =
+      FoodRepository::instance().nutrientDefinitions();
+  const int rows = static_cast<int>(totals.nutrientIds.size());
+  totalsTable->setRowCount(rows);
+  for (int i = 0; i < rows; ++i) {
+    const int index = definitions.indexOf(totals.nutrientIds[i]);
+    const double amount = totals.amounts[i];
+    totalsTable->setItem(
+        i, 0,
+        new QTableWidgetItem(index >= 0
+                                 ? definitions.at(index).description
+                                 : QString("Nutrient %1")
+                                       .arg(totals.nutrientIds[i])));
+    totalsTable->setItem(
+        i, 1, new QTableWidgetItem(QString::number(amount, 'f', 2)));
+    totalsTable->setItem(
+        i, 2,
+        new QTableWidgetItem(
+            QString::number(amount / std::max(1, totals.loggedDays), 'f', 2)));
+    totalsTable->setItem(
+        i, 3,
+        new QTableWidgetItem(index >= 0 ? definitions.at(index).unit
+                                        : QString()));
+  }
+  statusLabel->setText(QString("%1 entries on %2 of %3 days (%4 ms)")
+                           .arg(totals.entryCount)
+                           .arg(totals.loggedDays)
+                           .arg(totals.calendarDays)
+                           .arg(elapsedMs));
+}
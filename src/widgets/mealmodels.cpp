@@ -0,0 +1,285 @@
+#include "widgets/mealmodels.h"
+#include <QBrush>
+#include <QColor>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+
+// Values are rounded rather than formatted, so sorting stays numeric
+double rounded(double value, double scale) {
+  return std::round(value * scale) / scale;
+}
+
+// Empty text clears the value to 0
+bool parseAmount(const QVariant &value, double &amount) {
+  const QString text = value.toString().trimmed();
+  if (text.isEmpty()) {
+    amount = 0.0;
+    return true;
+  }
+  bool ok = false;
+  amount = text.toDouble(&ok);
+  return ok && amount >= 0;
+}
+
+QVariant headerName(const char *const *names, int count, int section) {
+  return section >= 0 && section < count ? QString(names[section])
+                                         : QVariant();
+}
+
+} // namespace
+
+MealItemsModel::MealItemsModel(QObject *parent)
+    : QAbstractTableModel(parent) {}
+
+void MealItemsModel::setKcalIndex(int index) {
+  m_kcalIndex = index;
+  if (!m_items.empty())
+    emit dataChanged(this->index(0, CaloriesColumn),
+                     this->index(rowCount() - 1, CaloriesColumn));
+}
+
+void MealItemsModel::append(std::vector<MealItem> items) {
+  if (items.empty())
+    return;
+  const int first = rowCount();
+  beginInsertRows(QModelIndex(), first,
+                  first + static_cast<int>(items.size()) - 1);
+  std::move(items.begin(), items.end(), std::back_inserter(m_items));
+  endInsertRows();
+}
+
+void MealItemsModel::remove(int row) {
+  beginRemoveRows(QModelIndex(), row, row);
+  m_items.erase(m_items.begin() + row);
+  endRemoveRows();
+}
+
+void MealItemsModel::clear() {
+  beginResetModel();
+  m_items.clear();
+  endResetModel();
+}
+
+void MealItemsModel::setGrams(const std::vector<double> &grams) {
+  const int count = std::min(rowCount(), static_cast<int>(grams.size()));
+  int runStart = -1;
+  for (int row = 0; row <= count; ++row) {
+    const bool changed = row < count && m_items[row].grams != grams[row];
+    if (changed) {
+      m_items[row].grams = grams[row];
+      if (runStart < 0)
+        runStart = row;
+    } else if (runStart >= 0) {
+      emit dataChanged(index(runStart, GramsColumn),
+                       index(row - 1, CaloriesColumn));
+      runStart = -1;
+    }
+  }
+}
+
+int MealItemsModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(m_items.size());
+}
+
+int MealItemsModel::columnCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant MealItemsModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid())
+    return QVariant();
+
+  const MealItem &item = m_items[index.row()];
+  switch (role) {
+  case Qt::DisplayRole:
+    if (index.column() == FoodColumn)
+      return item.name;
+    if (index.column() == GramsColumn)
+      return item.grams;
+    if (index.column() == CaloriesColumn)
+      return rounded(item.per100g.amount(m_kcalIndex) * item.grams / 100.0,
+                     10.0);
+    return QVariant();
+  case Qt::EditRole:
+    // As text, so the editor is a plain line edit
+    return index.column() == GramsColumn ? QString::number(item.grams)
+                                         : QVariant();
+  case Qt::ToolTipRole:
+    return item.note.isEmpty() ? QVariant() : item.note;
+  case Qt::BackgroundRole:
+    if (!item.doubtful)
+      return QVariant();
+    return QBrush(QColor(255, 236, 179));
+  default:
+    return QVariant();
+  }
+}
+
+QVariant MealItemsModel::headerData(int section, Qt::Orientation orientation,
+                                    int role) const {
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QAbstractTableModel::headerData(section, orientation, role);
+
+  static const char *const names[ColumnCount] = {"Food", "Grams",
+                                                 "Calories"};
+  return headerName(names, ColumnCount, section);
+}
+
+Qt::ItemFlags MealItemsModel::flags(const QModelIndex &index) const {
+  Qt::ItemFlags flags = QAbstractTableModel::flags(index);
+  if (index.isValid() && index.column() == GramsColumn)
+    flags |= Qt::ItemIsEditable;
+  return flags;
+}
+
+bool MealItemsModel::setData(const QModelIndex &index, const QVariant &value,
+                             int role) {
+  if (!index.isValid() || index.column() != GramsColumn ||
+      role != Qt::EditRole)
+    return false;
+
+  double grams = 0.0;
+  if (!parseAmount(value, grams))
+    return false;
+  MealItem &item = m_items[index.row()];
+  const double oldGrams = item.grams;
+  if (grams == oldGrams)
+    return true;
+  item.grams = grams;
+  emit dataChanged(index, index.siblingAtColumn(CaloriesColumn));
+  emit gramsEdited(index.row(), oldGrams);
+  return true;
+}
+
+MealTotalsModel::MealTotalsModel(const MealTotals &totals, QObject *parent)
+    : QAbstractTableModel(parent), m_totals(totals) {}
+
+void MealTotalsModel::setDefinitions(const NutrientDefinitions &definitions) {
+  beginResetModel();
+  m_definitions = &definitions;
+  m_targets.assign(definitions.size(), 0.0);
+  m_limits.assign(definitions.size(), 0.0);
+  for (int definition = 0; definition < definitions.size(); ++definition)
+    m_targets[definition] = definitions.at(definition).rda;
+  endResetModel();
+}
+
+void MealTotalsModel::totalsChanged(std::vector<int> definitions) {
+  std::sort(definitions.begin(), definitions.end());
+  definitions.erase(std::unique(definitions.begin(), definitions.end()),
+                    definitions.end());
+  const int count = rowCount();
+  size_t runStart = 0;
+  for (size_t i = 0; i < definitions.size(); ++i) {
+    const bool runEnds =
+        i + 1 == definitions.size() || definitions[i + 1] != definitions[i] + 1;
+    if (!runEnds)
+      continue;
+    // A run may stray past the table; repaint the part inside it
+    const int first = std::max(definitions[runStart], 0);
+    const int last = std::min(definitions[i], count - 1);
+    if (first <= last)
+      emit dataChanged(index(first, TotalColumn), index(last, RdaColumn));
+    runStart = i + 1;
+  }
+}
+
+int MealTotalsModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(m_targets.size());
+}
+
+int MealTotalsModel::columnCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant MealTotalsModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() ||
+      (role != Qt::DisplayRole && role != Qt::EditRole))
+    return QVariant();
+
+  const int definition = index.row();
+  const NutrientDefinition &def = m_definitions->at(definition);
+  if (role == Qt::EditRole) {
+    // As text, so the editor is a plain line edit
+    double value = 0.0;
+    if (index.column() == TargetColumn)
+      value = m_targets[definition];
+    else if (index.column() == LimitColumn)
+      value = m_limits[definition];
+    else
+      return QVariant();
+    return value > 0 ? QString::number(value) : QString();
+  }
+
+  switch (index.column()) {
+  case NameColumn:
+    return def.description;
+  case TotalColumn:
+    return rounded(m_totals.total(definition), 100.0);
+  case UnitColumn:
+    return def.unit;
+  case RdaColumn:
+    if (def.rda <= 0)
+      return QVariant();
+    return static_cast<int>(
+        std::lround(100.0 * m_totals.total(definition) / def.rda));
+  case TargetColumn:
+    return m_targets[definition] > 0 ? QVariant(m_targets[definition])
+                                     : QVariant();
+  case LimitColumn:
+    return m_limits[definition] > 0 ? QVariant(m_limits[definition])
+                                    : QVariant();
+  default:
+    return QVariant();
+  }
+}
+
+QVariant MealTotalsModel::headerData(int section, Qt::Orientation orientation,
+                                     int role) const {
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QAbstractTableModel::headerData(section, orientation, role);
+
+  static const char *const names[ColumnCount] = {
+      "Nutrient", "Total", "Unit", "% RDA", "Target", "Limit"};
+  return headerName(names, ColumnCount, section);
+}
+
+Qt::ItemFlags MealTotalsModel::flags(const QModelIndex &index) const {
+  Qt::ItemFlags flags = QAbstractTableModel::flags(index);
+  if (index.isValid() &&
+      (index.column() == TargetColumn || index.column() == LimitColumn))
+    flags |= Qt::ItemIsEditable;
+  return flags;
+}
+
+bool MealTotalsModel::setData(const QModelIndex &index, const QVariant &value,
+                              int role) {
+  if (!index.isValid() || role != Qt::EditRole)
+    return false;
+
+  double amount = 0.0;
+  if (index.column() == TargetColumn && parseAmount(value, amount))
+    m_targets[index.row()] = amount;
+  else if (index.column() == LimitColumn && parseAmount(value, amount))
+    m_limits[index.row()] = amount;
+  else
+    return false;
+  emit dataChanged(index, index);
+  return true;
+}
+
+ReportedNutrientsFilter::ReportedNutrientsFilter(QObject *parent)
+    : QSortFilterProxyModel(parent) {
+  // Refilter whichever columns a change touches
+  setFilterKeyColumn(-1);
+}
+
+bool ReportedNutrientsFilter::filterAcceptsRow(
+    int sourceRow, const QModelIndex &sourceParent) const {
+  Q_UNUSED(sourceParent);
+  const auto *totals = qobject_cast<const MealTotalsModel *>(sourceModel());
+  return totals != nullptr && totals->isReported(sourceRow);
+}
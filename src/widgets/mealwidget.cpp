@@ -1,98 +1,427 @@
 #include "widgets/mealwidget.h"
+#include <QDateTime>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QLabel>
+#include <QStringList>
 #include <QVBoxLayout>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 
 MealWidget::MealWidget(QWidget *parent) : QWidget(parent) {
   auto *layout = new QVBoxLayout(this);
 
-  // Items List
+  // Items List (only the grams can be edited)
   layout->addWidget(new QLabel("Meal Composition", this));
-  itemsTable = new QTableWidget(this);
-  itemsTable->setColumnCount(3);
-  itemsTable->setHorizontalHeaderLabels({"Food", "Grams", "Calories"});
-  itemsTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
-  layout->addWidget(itemsTable);
+  itemsModel = new MealItemsModel(this);
+  itemsProxy = new QSortFilterProxyModel(this);
+  itemsProxy->setSourceModel(itemsModel);
+  itemsView = new QTableView(this);
+  itemsView->setModel(itemsProxy);
+  itemsView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+  itemsView->setSortingEnabled(true);
+  itemsView->horizontalHeader()->setSectionResizeMode(
+      MealItemsModel::FoodColumn, QHeaderView::Stretch);
+  itemsView->setSelectionBehavior(QAbstractItemView::SelectRows);
+  itemsView->setSelectionMode(QAbstractItemView::SingleSelection);
+  connect(itemsModel, &MealItemsModel::gramsEdited, this,
+          &MealWidget::onGramsEdited);
+  layout->addWidget(itemsView);
 
   // Controls
+  auto *controlsLayout = new QHBoxLayout();
+  removeButton = new QPushButton("Remove Selected", this);
+  connect(removeButton, &QPushButton::clicked, this,
+          &MealWidget::removeSelected);
   clearButton = new QPushButton("Clear Meal", this);
   connect(clearButton, &QPushButton::clicked, this, &MealWidget::clearMeal);
-  layout->addWidget(clearButton);
+  optimizeButton = new QPushButton("Optimize Grams", this);
+  optimizeButton->setToolTip(
+      "Choose grams for each food to meet the targets without exceeding "
+      "the limits");
+  connect(optimizeButton, &QPushButton::clicked, this,
+          &MealWidget::optimizeGrams);
+  logDateEdit = new QDateEdit(QDate::currentDate(), this);
+  logDateEdit->setCalendarPopup(true);
+  logButton = new QPushButton("Log Meal", this);
+  logButton->setToolTip("Record this meal in the journal under the date");
+  logButton->setEnabled(false);
+  connect(logButton, &QPushButton::clicked, this, &MealWidget::logMeal);
+  importButton = new QPushButton("Import Recipe...", this);
+  importButton->setToolTip(
+      "Add the ingredients of a CSV file (ingredient, grams) to the meal");
+  connect(importButton, &QPushButton::clicked, this,
+          &MealWidget::importRecipe);
+  controlsLayout->addWidget(removeButton);
+  controlsLayout->addWidget(clearButton);
+  controlsLayout->addWidget(importButton);
+  controlsLayout->addStretch();
+  controlsLayout->addWidget(optimizeButton);
+  controlsLayout->addWidget(logDateEdit);
+  controlsLayout->addWidget(logButton);
+  layout->addLayout(controlsLayout);
+  statusLabel = new QLabel(this);
+  layout->addWidget(statusLabel);
 
   // Totals
   layout->addWidget(new QLabel("Total Nutrition", this));
-  totalsTable = new QTableWidget(this);
-  totalsTable->setColumnCount(3);
-  totalsTable->setHorizontalHeaderLabels({"Nutrient", "Total", "Unit"});
-  totalsTable->horizontalHeader()->setSectionResizeMode(0,
-                                                        QHeaderView::Stretch);
-  layout->addWidget(totalsTable);
+  // Rows follow definition order and are only shown once a food in the
+  // meal reports the nutrient, so an edit only repaints the rows it changes
+  totalsModel = new MealTotalsModel(totals, this);
+  auto *totalsFilter = new ReportedNutrientsFilter(this);
+  totalsFilter->setSourceModel(totalsModel);
+  totalsView = new QTableView(this);
+  totalsView->setModel(totalsFilter);
+  totalsView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+  totalsView->setSortingEnabled(true);
+  totalsView->horizontalHeader()->setSectionResizeMode(
+      MealTotalsModel::NameColumn, QHeaderView::Stretch);
+  layout->addWidget(totalsView);
+}
+
+MealWidget::~MealWidget() {
+  // The import and optimizer threads report back to this widget
+  if (importThread != nullptr)
+    importThread->wait();
+  if (optimizeThread != nullptr)
+    optimizeThread->wait();
 }
 
 void MealWidget::addFood(int foodId, const QString &foodName, double grams) {
-  std::vector<Nutrient> baseNutrients = repository.getFoodNutrients(foodId);
+  ensureTotals();
 
   MealItem item;
   item.foodId = foodId;
   item.name = foodName;
   item.grams = grams;
-  item.nutrients_100g = baseNutrients;
-
-  mealItems.push_back(item);
-
-  // Update Items Table
-  int row = itemsTable->rowCount();
-  itemsTable->insertRow(row);
-  itemsTable->setItem(row, 0, new QTableWidgetItem(foodName));
-  itemsTable->setItem(row, 1, new QTableWidgetItem(QString::number(grams)));
-
-  // Calculate Calories (ID 208 usually, or find by name?)
-  // repository returns IDs based on DB. 208 is KCAL in SR28.
-  double kcal = 0;
-  for (const auto &nut : baseNutrients) {
-    if (nut.id == 208) {
-      kcal = (nut.amount * grams) / 100.0;
-      break;
+  item.per100g = NutrientVector::fromNutrients(
+      FoodRepository::instance().getFoodNutrients(foodId), totals.size());
+
+  std::vector<MealItem> items;
+  items.push_back(std::move(item));
+  addItems(std::move(items));
+}
+
+void MealWidget::addItems(std::vector<MealItem> items) {
+  std::vector<char> touched(totals.size(), 0);
+  for (const MealItem &item : items) {
+    totals.addFood(item.per100g, item.grams);
+    for (int definition : item.per100g.reported)
+      touched[definition] = 1;
+  }
+  itemsModel->append(std::move(items));
+
+  std::vector<int> changed;
+  for (int definition = 0; definition < totals.size(); ++definition) {
+    if (touched[definition] != 0)
+      changed.push_back(definition);
+  }
+  totalsModel->totalsChanged(std::move(changed));
+}
+
+void MealWidget::importRecipe() {
+  if (importThread != nullptr)
+    return;
+  const QString path = QFileDialog::getOpenFileName(
+      this, "Import Recipe", QString(), "CSV files (*.csv);;All files (*)");
+  if (path.isEmpty())
+    return;
+
+  importButton->setEnabled(false);
+  statusLabel->setText(
+      QString("Importing %1...").arg(QFileInfo(path).fileName()));
+
+  // Nutrients are looked up on the import thread too, which matters when
+  // they are read from the database
+  auto imported = std::make_shared<ImportedRecipe>();
+  importThread = QThread::create([this, path, imported] {
+    QElapsedTimer timer;
+    timer.start();
+    FoodRepository &repository = FoodRepository::instance();
+    QFile file(path);
+    imported->ok = importRecipeCsv(
+        file, repository, imported->result, RecipeImportOptions(),
+        [this](int linesRead) {
+          QMetaObject::invokeMethod(
+              this,
+              [this, linesRead] {
+                statusLabel->setText(
+                    QString("Importing: %1 lines read").arg(linesRead));
+              },
+              Qt::QueuedConnection);
+        });
+
+    const int definitionCount = repository.nutrientDefinitions().size();
+    for (const ImportedIngredient &ingredient : imported->result.ingredients) {
+      if (ingredient.foodId >= 0 &&
+          imported->nutrients.count(ingredient.foodId) == 0) {
+        imported->nutrients[ingredient.foodId] = NutrientVector::fromNutrients(
+            repository.getFoodNutrients(ingredient.foodId), definitionCount);
+      }
     }
+    imported->elapsedMs = timer.elapsed();
+  });
+  importThread->setParent(this);
+  connect(importThread, &QThread::finished, this, [this, imported] {
+    importThread->deleteLater();
+    importThread = nullptr;
+    importButton->setEnabled(true);
+    addImported(*imported);
+  });
+  importThread->start();
+}
+
+void MealWidget::addImported(const ImportedRecipe &imported) {
+  if (!imported.ok) {
+    statusLabel->setText("Could not read the recipe file");
+    return;
   }
-  itemsTable->setItem(row, 2,
-                      new QTableWidgetItem(QString::number(kcal, 'f', 1)));
+  ensureTotals();
 
-  updateTotals();
+  // Low-confidence matches are added too, but stand out for checking
+  std::vector<MealItem> items;
+  int unmatched = 0;
+  for (const ImportedIngredient &ingredient : imported.result.ingredients) {
+    if (ingredient.foodId < 0) {
+      ++unmatched;
+      continue;
+    }
+    MealItem item;
+    item.foodId = ingredient.foodId;
+    item.name = ingredient.foodName;
+    item.grams = ingredient.grams;
+    item.per100g = imported.nutrients.at(ingredient.foodId);
+    item.note = QString("Line %1: \"%2\", match score %3")
+                    .arg(ingredient.lineNumber)
+                    .arg(ingredient.text)
+                    .arg(ingredient.score);
+    item.doubtful = ingredient.lowConfidence;
+    items.push_back(std::move(item));
+  }
+  const int added = static_cast<int>(items.size());
+  addItems(std::move(items));
+
+  QString report = QString("Imported %1 ingredients in %2 ms")
+                       .arg(added)
+                       .arg(imported.elapsedMs);
+  const int doubtfulCount = imported.result.lowConfidenceCount - unmatched;
+  if (doubtfulCount > 0)
+    report += QString(", %1 weak matches highlighted").arg(doubtfulCount);
+  if (unmatched > 0)
+    report += QString(", %1 not found").arg(unmatched);
+  if (!imported.result.problems.isEmpty()) {
+    report += QString(", %1 lines skipped")
+                  .arg(static_cast<int>(imported.result.problems.size()));
+    qWarning().noquote() << imported.result.problems.join('\n');
+  }
+  statusLabel->setText(report);
+}
+
+void MealWidget::setJournal(MealJournal *mealJournal) {
+  journal = mealJournal;
+  logButton->setEnabled(journal != nullptr && journal->isOpen());
+}
+
+void MealWidget::logMeal() {
+  if (journal == nullptr || itemsModel->items().empty())
+    return;
+
+  const NutrientDefinitions &definitions =
+      FoodRepository::instance().nutrientDefinitions();
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  std::vector<JournalEntry> entries;
+  for (const MealItem &item : itemsModel->items()) {
+    JournalEntry entry;
+    entry.day = logDateEdit->date();
+    entry.loggedAtMs = now;
+    entry.foodId = item.foodId;
+    entry.description = item.name;
+    entry.grams = item.grams;
+    for (int definition : item.per100g.reported) {
+      entry.nutrientIds.push_back(
+          static_cast<quint16>(definitions.at(definition).id));
+      entry.amounts.push_back(static_cast<float>(
+          item.per100g.amount(definition) * item.grams / 100.0));
+    }
+    entries.push_back(std::move(entry));
+  }
+
+  if (!journal->append(entries)) {
+    statusLabel->setText("Could not write to the meal journal");
+    return;
+  }
+  statusLabel->setText(QString("Logged %1 foods for %2")
+                           .arg(static_cast<int>(entries.size()))
+                           .arg(logDateEdit->date().toString(Qt::ISODate)));
+  emit mealLogged();
 }
 
 void MealWidget::clearMeal() {
-  mealItems.clear();
-  itemsTable->setRowCount(0);
-  updateTotals();
-}
-
-void MealWidget::updateTotals() {
-  std::map<int, double> totals; // id -> amount
-  std::map<int, QString> units;
-  std::map<int, QString> names;
-
-  for (const auto &item : mealItems) {
-    double scale = item.grams / 100.0;
-    for (const auto &nut : item.nutrients_100g) {
-      totals[nut.id] += nut.amount * scale;
-      names.try_emplace(nut.id, nut.description);
-      units.try_emplace(nut.id, nut.unit);
+  itemsModel->clear();
+  totals.reset(totals.size());
+  std::vector<int> all(totals.size());
+  std::iota(all.begin(), all.end(), 0);
+  totalsModel->totalsChanged(std::move(all));
+}
+
+void MealWidget::removeSelected() {
+  const int row = itemsProxy->mapToSource(itemsView->currentIndex()).row();
+  if (row < 0)
+    return;
+
+  const MealItem item = itemsModel->items()[row];
+  totals.removeFood(item.per100g, item.grams);
+  itemsModel->remove(row);
+  totalsModel->totalsChanged(item.per100g.reported);
+}
+
+void MealWidget::onGramsEdited(int row, double oldGrams) {
+  const MealItem &item = itemsModel->items()[row];
+  totals.changeGrams(item.per100g, oldGrams, item.grams);
+  totalsModel->totalsChanged(item.per100g.reported);
+}
+
+void MealWidget::ensureTotals() {
+  if (totalsModel->rowCount() > 0)
+    return;
+
+  // 208 is KCAL in SR28
+  const NutrientDefinitions &definitions =
+      FoodRepository::instance().nutrientDefinitions();
+  itemsModel->setKcalIndex(definitions.indexOf(208));
+  totals.reset(definitions.size());
+  totalsModel->setDefinitions(definitions);
+}
+
+bool MealProblem::sameAs(const MealProblem &other) const {
+  auto sameGoal = [](const NutrientGoal &a, const NutrientGoal &b) {
+    return a.definition == b.definition && a.target == b.target &&
+           a.upperLimit == b.upperLimit;
+  };
+  return foodIds == other.foodIds && grams == other.grams &&
+         std::equal(goals.begin(), goals.end(), other.goals.begin(),
+                    other.goals.end(), sameGoal);
+}
+
+MealProblem MealWidget::currentProblem() const {
+  MealProblem problem;
+  for (const MealItem &item : itemsModel->items()) {
+    problem.foodIds.push_back(item.foodId);
+    problem.foods.push_back(item.per100g);
+    problem.grams.push_back(item.grams);
+  }
+
+  // Only nutrients some food reports can be moved by changing grams
+  for (int definition = 0; definition < totals.size(); ++definition) {
+    if (!totals.isReported(definition))
+      continue;
+    problem.reported.push_back(definition);
+    NutrientGoal goal;
+    goal.definition = definition;
+    goal.target = totalsModel->target(definition);
+    goal.upperLimit = totalsModel->limit(definition);
+    if (goal.target > 0 || goal.upperLimit > 0)
+      problem.goals.push_back(goal);
+  }
+  return problem;
+}
+
+void MealWidget::optimizeGrams() {
+  if (optimizeThread != nullptr)
+    return;
+  auto problem = std::make_shared<MealProblem>(currentProblem());
+  if (problem->foods.empty())
+    return;
+  if (problem->goals.empty()) {
+    statusLabel->setText("Set a target or limit for a nutrient first");
+    return;
+  }
+
+  // The solve works on a copy of the meal, which stays editable meanwhile
+  struct Solved {
+    MealSolution solution;
+    qint64 elapsedMs = 0;
+  };
+  auto solved = std::make_shared<Solved>();
+  optimizeButton->setEnabled(false);
+  statusLabel->setText("Optimizing grams...");
+  optimizeThread = QThread::create([problem, solved] {
+    std::vector<const NutrientVector *> foods;
+    for (const NutrientVector &food : problem->foods)
+      foods.push_back(&food);
+    QElapsedTimer timer;
+    timer.start();
+    solved->solution = optimizeMeal(foods, problem->goals, problem->grams);
+    solved->elapsedMs = timer.elapsed();
+  });
+  optimizeThread->setParent(this);
+  connect(optimizeThread, &QThread::finished, this, [this, problem, solved] {
+    optimizeThread->deleteLater();
+    optimizeThread = nullptr;
+    optimizeButton->setEnabled(true);
+    // Grams solved for an older meal would undo the edits; solve again
+    if (!currentProblem().sameAs(*problem)) {
+      statusLabel->clear();
+      optimizeGrams();
+      return;
     }
+    applySolution(*problem, solved->solution, solved->elapsedMs);
+  });
+  optimizeThread->start();
+}
+
+void MealWidget::applySolution(const MealProblem &problem,
+                               const MealSolution &solution, qint64 elapsedMs) {
+  // Grams are shown to a tenth, so keep exactly what is shown
+  const std::vector<MealItem> &mealItems = itemsModel->items();
+  std::vector<double> solved(mealItems.size());
+  for (size_t row = 0; row < mealItems.size(); ++row) {
+    const MealItem &item = mealItems[row];
+    solved[row] = std::round(solution.grams[row] * 10.0) / 10.0;
+    totals.changeGrams(item.per100g, item.grams, solved[row]);
   }
+  itemsModel->setGrams(solved);
+  totalsModel->totalsChanged(problem.reported);
 
-  totalsTable->setRowCount(static_cast<int>(totals.size()));
-  int row = 0;
-  for (const auto &pair : totals) {
-    int nid = pair.first;
-    double amount = pair.second;
-
-    totalsTable->setItem(row, 0, new QTableWidgetItem(names[nid]));
-    totalsTable->setItem(row, 1,
-                         new QTableWidgetItem(QString::number(amount, 'f', 2)));
-    totalsTable->setItem(row, 2, new QTableWidgetItem(units[nid]));
-    row++;
+  // RDA coverage of the nutrients that were aimed at and have an RDA
+  const NutrientDefinitions &definitions =
+      FoodRepository::instance().nutrientDefinitions();
+  int covered = 0;
+  int withRda = 0;
+  double coverage = 0.0;
+  for (const NutrientGoal &goal : problem.goals) {
+    const double rda = definitions.at(goal.definition).rda;
+    if (goal.target <= 0 || rda <= 0)
+      continue;
+    const double percent = 100.0 * totals.total(goal.definition) / rda;
+    coverage += std::min(percent, 100.0);
+    covered += percent >= 100.0 ? 1 : 0;
+    ++withRda;
+  }
+  QString report = QString("Solved %1 foods x %2 goals in %3 ms")
+                       .arg(static_cast<int>(problem.foods.size()))
+                       .arg(static_cast<int>(problem.goals.size()))
+                       .arg(elapsedMs);
+  if (!solution.converged)
+    report += " (stopped before converging)";
+  if (withRda > 0) {
+    report += QString(". RDA coverage %1% on average, %2 of %3 nutrients met")
+                  .arg(coverage / withRda, 0, 'f', 0)
+                  .arg(covered)
+                  .arg(withRda);
+  }
+  if (!solution.exceededLimits.empty()) {
+    QStringList names;
+    for (int definition : solution.exceededLimits)
+      names << definitions.at(definition).description;
+    report += QString(". Still over the limit: %1").arg(names.join(", "));
+    qWarning() << "Meal optimizer left limits exceeded:" << names;
   }
+  statusLabel->setText(report);
 }
@@ -0,0 +1,47 @@
+#include "widgets/nutrientsmodel.h"
+
+NutrientsModel::NutrientsModel(QObject *parent)
+    : QAbstractTableModel(parent) {}
+
+void NutrientsModel::setNutrients(FoodNutrients nutrients) {
+  // Another food shares no rows with this one
+  beginResetModel();
+  m_definitions = &FoodRepository::instance().nutrientDefinitions();
+  m_nutrients = std::move(nutrients);
+  endResetModel();
+}
+
+int NutrientsModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : m_nutrients.size();
+}
+
+int NutrientsModel::columnCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant NutrientsModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || role != Qt::DisplayRole)
+    return QVariant();
+
+  const Nutrient nutrient = m_nutrients[index.row()];
+  switch (index.column()) {
+  case NameColumn:
+    return m_definitions->at(nutrient.index).description;
+  case AmountColumn:
+    return nutrient.amount;
+  case UnitColumn:
+    return m_definitions->at(nutrient.index).unit;
+  default:
+    return QVariant();
+  }
+}
+
+QVariant NutrientsModel::headerData(int section, Qt::Orientation orientation,
+                                    int role) const {
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QAbstractTableModel::headerData(section, orientation, role);
+
+  static const char *const names[ColumnCount] = {"Nutrient", "Amount", "Unit"};
+  return section >= 0 && section < ColumnCount ? QString(names[section])
+                                               : QVariant();
+}
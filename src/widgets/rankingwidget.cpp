@@ -0,0 +1,147 @@
+#include "widgets/rankingwidget.h"
+#include <QElapsedTimer>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QSignalBlocker>
+#include <QVBoxLayout>
+
+RankingWidget::RankingWidget(QWidget *parent) : QWidget(parent) {
+  auto *layout = new QVBoxLayout(this);
+
+  // Choices
+  auto *choicesLayout = new QHBoxLayout();
+  nutrientCombo = new QComboBox(this);
+  nutrientCombo->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+
+  basisCombo = new QComboBox(this);
+  basisCombo->addItem("per 100 g",
+                      static_cast<int>(NutrientBasis::Per100Grams));
+  basisCombo->addItem("per 100 kcal",
+                      static_cast<int>(NutrientBasis::Per100Kcal));
+
+  groupCombo = new QComboBox(this);
+  groupCombo->addItem("All groups", -1);
+
+  limitSpin = new QSpinBox(this);
+  limitSpin->setRange(10, 500);
+  limitSpin->setSingleStep(10);
+  limitSpin->setValue(50);
+  limitSpin->setPrefix("Top ");
+
+  choicesLayout->addWidget(nutrientCombo);
+  choicesLayout->addWidget(basisCombo);
+  choicesLayout->addWidget(groupCombo);
+  choicesLayout->addWidget(limitSpin);
+  choicesLayout->addStretch();
+  layout->addLayout(choicesLayout);
+
+  connect(nutrientCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+          this, &RankingWidget::performRanking);
+  connect(basisCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+          this, &RankingWidget::performRanking);
+  connect(groupCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+          this, &RankingWidget::performRanking);
+  connect(limitSpin, QOverload<int>::of(&QSpinBox::valueChanged), this,
+          &RankingWidget::performRanking);
+
+  // Results table
+  resultsTable = new QTableWidget(this);
+  resultsTable->setColumnCount(5);
+  resultsTable->setHorizontalHeaderLabels(
+      {"ID", "Description", "Group", "Amount", "Unit"});
+  resultsTable->horizontalHeader()->setSectionResizeMode(1,
+                                                         QHeaderView::Stretch);
+  resultsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+  resultsTable->setSelectionMode(QAbstractItemView::SingleSelection);
+  resultsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  connect(resultsTable, &QTableWidget::cellDoubleClicked, this,
+          &RankingWidget::onRowDoubleClicked);
+  layout->addWidget(resultsTable);
+
+  statusLabel = new QLabel(this);
+  layout->addWidget(statusLabel);
+}
+
+void RankingWidget::refresh() {
+  populateChoices();
+  performRanking();
+}
+
+void RankingWidget::populateChoices() {
+  FoodRepository &repository = FoodRepository::instance();
+
+  if (nutrientCombo->count() == 0) {
+    const QSignalBlocker blocker(nutrientCombo);
+    const NutrientDefinitions &definitions = repository.nutrientDefinitions();
+    for (int i = 0; i < definitions.size(); ++i) {
+      const NutrientDefinition &def = definitions.at(i);
+      nutrientCombo->addItem(
+          QString("%1 (%2)").arg(def.description, def.unit), def.id);
+    }
+    // Protein is a more useful first answer than whatever has the lowest id
+    const int protein = nutrientCombo->findData(203);
+    if (protein >= 0)
+      nutrientCombo->setCurrentIndex(protein);
+  }
+
+  auto snapshot = repository.snapshot();
+  if (groupCombo->count() == 1 && snapshot) {
+    const QSignalBlocker blocker(groupCombo);
+    const FoodGroups &groups = repository.foodGroups();
+    for (int groupId : snapshot->groupIds)
+      groupCombo->addItem(groups.name(groupId), groupId);
+  }
+}
+
+void RankingWidget::performRanking() {
+  FoodRepository &repository = FoodRepository::instance();
+  if (!repository.snapshot() || nutrientCombo->count() == 0) {
+    statusLabel->setText("Food data is still loading");
+    return;
+  }
+
+  NutrientRankingQuery query;
+  query.nutrientId = nutrientCombo->currentData().toInt();
+  query.basis = static_cast<NutrientBasis>(basisCombo->currentData().toInt());
+  query.foodGroupId = groupCombo->currentData().toInt();
+  query.limit = limitSpin->value();
+
+  QElapsedTimer timer;
+  timer.start();
+  const std::vector<RankedFood> ranked = repository.topFoodsByNutrient(query);
+  const qint64 elapsedMs = timer.elapsed();
+
+  const NutrientDefinitions &definitions = repository.nutrientDefinitions();
+  const FoodGroups &groups = repository.foodGroups();
+  const int index = definitions.indexOf(query.nutrientId);
+  const QString unit = index >= 0 ? definitions.at(index).unit : QString();
+
+  resultsTable->setHorizontalHeaderItem(
+      3, new QTableWidgetItem(basisCombo->currentText()));
+  resultsTable->setRowCount(0);
+  resultsTable->setRowCount(static_cast<int>(ranked.size()));
+  for (int i = 0; i < static_cast<int>(ranked.size()); ++i) {
+    const auto &food = ranked[i];
+    resultsTable->setItem(i, 0, new QTableWidgetItem(QString::number(food.id)));
+    resultsTable->setItem(i, 1, new QTableWidgetItem(food.description));
+    resultsTable->setItem(
+        i, 2, new QTableWidgetItem(groups.name(food.foodGroupId)));
+    resultsTable->setItem(i, 3,
+                          new QTableWidgetItem(QString::number(food.value)));
+    resultsTable->setItem(i, 4, new QTableWidgetItem(unit));
+  }
+  statusLabel->setText(
+      QString("%1 foods ranked in %2 ms")
+          .arg(static_cast<int>(ranked.size()))
+          .arg(elapsedMs));
+}
+
+void RankingWidget::onRowDoubleClicked(int row, int column) {
+  Q_UNUSED(column);
+  QTableWidgetItem *idItem = resultsTable->item(row, 0);
+  QTableWidgetItem *descItem = resultsTable->item(row, 1);
+
+  if (idItem != nullptr && descItem != nullptr) {
+    emit foodSelected(idItem->text().toInt(), descItem->text());
+  }
+}
@@ -2,7 +2,28 @@
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QMessageBox>
+#include <QSignalBlocker>
 #include <QVBoxLayout>
+#include <functional>
+#include <map>
+
+namespace {
+
+// Lets the match counts be fetched only when someone looks at them
+class GroupComboBox : public QComboBox {
+public:
+  using QComboBox::QComboBox;
+
+  std::function<void()> aboutToShowPopup;
+
+  void showPopup() override {
+    if (aboutToShowPopup)
+      aboutToShowPopup();
+    QComboBox::showPopup();
+  }
+};
+
+} // namespace
 
 SearchWidget::SearchWidget(QWidget *parent) : QWidget(parent) {
   auto *layout = new QVBoxLayout(this);
@@ -14,7 +35,7 @@ SearchWidget::SearchWidget(QWidget *parent) : QWidget(parent) {
 
   searchTimer = new QTimer(this);
   searchTimer->setSingleShot(true);
-  searchTimer->setInterval(600); // 600ms debounce
+  searchTimer->setInterval(50); // Just coalesces bursts; search is async
 
   connect(searchInput, &QLineEdit::textChanged, this,
           [=]() { searchTimer->start(); });
@@ -22,29 +43,64 @@ SearchWidget::SearchWidget(QWidget *parent) : QWidget(parent) {
   connect(searchInput, &QLineEdit::returnPressed, this,
           &SearchWidget::performSearch);
 
+  // Filled in with names once the data is loaded, and with match counts
+  // when the list is opened
+  auto *combo = new GroupComboBox(this);
+  combo->aboutToShowPopup = [this] { requestFacets(); };
+  groupCombo = combo;
+  groupCombo->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+  groupCombo->addItem("All groups", -1);
+  connect(groupCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+          this, &SearchWidget::performSearch);
+
   searchButton = new QPushButton("Search", this);
   connect(searchButton, &QPushButton::clicked, this,
           &SearchWidget::performSearch);
 
   searchLayout->addWidget(searchInput);
+  searchLayout->addWidget(groupCombo);
   searchLayout->addWidget(searchButton);
   layout->addLayout(searchLayout);
 
-  // Results table
-  resultsTable = new QTableWidget(this);
-  resultsTable->setColumnCount(7);
-  resultsTable->setHorizontalHeaderLabels(
-      {"ID", "Description", "Group", "Nutr", "Amino", "Flav", "Score"});
-
-  resultsTable->horizontalHeader()->setSectionResizeMode(1,
-                                                         QHeaderView::Stretch);
-  resultsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-  resultsTable->setSelectionMode(QAbstractItemView::SingleSelection);
-  resultsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
-  connect(resultsTable, &QTableWidget::cellDoubleClicked, this,
+  // Results table, sorted by score until a header is clicked
+  resultsModel = new FoodResultsModel(this);
+  resultsProxy = new QSortFilterProxyModel(this);
+  resultsProxy->setSourceModel(resultsModel);
+  resultsView = new QTableView(this);
+  resultsView->setModel(resultsProxy);
+  resultsView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+  resultsView->setSortingEnabled(true);
+
+  resultsView->horizontalHeader()->setSectionResizeMode(
+      FoodResultsModel::DescriptionColumn, QHeaderView::Stretch);
+  resultsView->setSelectionBehavior(QAbstractItemView::SelectRows);
+  resultsView->setSelectionMode(QAbstractItemView::SingleSelection);
+  resultsView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  connect(resultsView, &QTableView::doubleClicked, this,
           &SearchWidget::onRowDoubleClicked);
 
-  layout->addWidget(resultsTable);
+  layout->addWidget(resultsView);
+
+  // Searches run on a worker thread; stale ones are dropped mid-scan
+  searchWorker = new SearchWorker(FoodRepository::instance());
+  searchWorker->moveToThread(&searchThread);
+  connect(&searchThread, &QThread::finished, searchWorker,
+          &QObject::deleteLater);
+  connect(this, &SearchWidget::searchRequested, searchWorker,
+          &SearchWorker::search);
+  connect(this, &SearchWidget::facetsRequested, searchWorker,
+          &SearchWorker::countFacets);
+  connect(searchWorker, &SearchWorker::resultsReady, this,
+          &SearchWidget::onResultsReady);
+  connect(searchWorker, &SearchWorker::facetsReady, this,
+          &SearchWidget::onFacetsReady);
+  searchThread.start();
+}
+
+SearchWidget::~SearchWidget() {
+  searchWorker->nextGeneration(); // Cancel anything in flight
+  searchThread.quit();
+  searchThread.wait();
 }
 
 void SearchWidget::performSearch() {
@@ -52,34 +108,92 @@ void SearchWidget::performSearch() {
   if (query.length() < 2)
     return;
 
-  resultsTable->setRowCount(0);
-
-  std::vector<FoodItem> results = repository.searchFoods(query);
-
-  resultsTable->setRowCount(static_cast<int>(results.size()));
-  for (int i = 0; i < static_cast<int>(results.size()); ++i) {
-    const auto &item = results[i];
-    resultsTable->setItem(i, 0, new QTableWidgetItem(QString::number(item.id)));
-    resultsTable->setItem(i, 1, new QTableWidgetItem(item.description));
-    resultsTable->setItem(
-        i, 2, new QTableWidgetItem(QString::number(item.foodGroupId)));
-    resultsTable->setItem(
-        i, 3, new QTableWidgetItem(QString::number(item.nutrientCount)));
-    resultsTable->setItem(
-        i, 4, new QTableWidgetItem(QString::number(item.aminoCount)));
-    resultsTable->setItem(
-        i, 5, new QTableWidgetItem(QString::number(item.flavCount)));
-    resultsTable->setItem(i, 6,
-                          new QTableWidgetItem(QString::number(item.score)));
+  currentGeneration = searchWorker->nextGeneration();
+  currentQuery = query;
+  clearFacets();
+  emit searchRequested(currentGeneration, query,
+                       groupCombo->currentData().toInt());
+}
+
+void SearchWidget::requestFacets() {
+  populateGroups();
+  if (currentQuery.isEmpty() || facetsGeneration == currentGeneration)
+    return;
+  facetsGeneration = currentGeneration;
+  emit facetsRequested(currentGeneration, currentQuery);
+}
+
+void SearchWidget::clearFacets() {
+  if (facetsGeneration == 0)
+    return;
+  facetsGeneration = 0;
+  const FoodGroups &groups = FoodRepository::instance().foodGroups();
+  groupCombo->setItemText(0, "All groups");
+  for (int i = 1; i < groupCombo->count(); ++i)
+    groupCombo->setItemText(i, groups.name(groupCombo->itemData(i).toInt()));
+}
+
+void SearchWidget::onResultsReady(int generation,
+                                  const std::vector<FoodItem> &results,
+                                  bool isFinal) {
+  if (generation != currentGeneration)
+    return;
+
+  // More rows may come in while the scan runs
+  if (isFinal) {
+    resultsView->viewport()->unsetCursor();
+    populateGroups();
+  } else {
+    resultsView->viewport()->setCursor(Qt::BusyCursor);
   }
+
+  // A new search keeps no selection from the last one
+  if (generation != shownGeneration) {
+    shownGeneration = generation;
+    resultsView->clearSelection();
+  }
+  resultsModel->setResults(results);
 }
 
-void SearchWidget::onRowDoubleClicked(int row, int column) {
-  Q_UNUSED(column);
-  QTableWidgetItem *idItem = resultsTable->item(row, 0);
-  QTableWidgetItem *descItem = resultsTable->item(row, 1);
+void SearchWidget::onFacetsReady(int generation,
+                                 const std::vector<SearchFacet> &facets) {
+  if (generation != currentGeneration || generation != facetsGeneration)
+    return;
 
-  if (idItem != nullptr && descItem != nullptr) {
-    emit foodSelected(idItem->text().toInt(), descItem->text());
+  const FoodGroups &groups = FoodRepository::instance().foodGroups();
+  int total = 0;
+  std::map<int, int> counts;
+  for (const SearchFacet &facet : facets) {
+    counts[facet.foodGroupId] = facet.count;
+    total += facet.count;
+  }
+  groupCombo->setItemText(0, QString("All groups (%1)").arg(total));
+  for (int i = 1; i < groupCombo->count(); ++i) {
+    const int groupId = groupCombo->itemData(i).toInt();
+    auto it = counts.find(groupId);
+    groupCombo->setItemText(i, QString("%1 (%2)")
+                                   .arg(groups.name(groupId))
+                                   .arg(it != counts.end() ? it->second : 0));
   }
 }
+
+void SearchWidget::populateGroups() {
+  if (groupCombo->count() > 1)
+    return;
+  auto snapshot = FoodRepository::instance().snapshot();
+  if (!snapshot)
+    return;
+
+  const QSignalBlocker blocker(groupCombo);
+  const FoodGroups &groups = FoodRepository::instance().foodGroups();
+  for (int groupId : snapshot->groupIds)
+    groupCombo->addItem(groups.name(groupId), groupId);
+}
+
+void SearchWidget::onRowDoubleClicked(const QModelIndex &index) {
+  const QModelIndex source = resultsProxy->mapToSource(index);
+  if (!source.isValid())
+    return;
+  const FoodItem &item = resultsModel->food(source.row());
+  emit foodSelected(item.id, item.description);
+}
@@ -0,0 +1,51 @@
+#include "widgets/similarfoodsmodel.h"
+#include <cmath>
+
+SimilarFoodsModel::SimilarFoodsModel(QObject *parent)
+    : QAbstractTableModel(parent) {}
+
+void SimilarFoodsModel::setFoods(std::vector<SimilarFood> foods) {
+  // Another food's neighbours share no rows with these
+  beginResetModel();
+  m_groups = &FoodRepository::instance().foodGroups();
+  m_foods = std::move(foods);
+  endResetModel();
+}
+
+int SimilarFoodsModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(m_foods.size());
+}
+
+int SimilarFoodsModel::columnCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant SimilarFoodsModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || role != Qt::DisplayRole)
+    return QVariant();
+
+  const SimilarFood &food = m_foods[index.row()];
+  switch (index.column()) {
+  case DescriptionColumn:
+    return food.description;
+  case GroupColumn:
+    return m_groups != nullptr ? m_groups->name(food.foodGroupId) : QString();
+  case DistanceColumn:
+    // Rounded rather than formatted, so sorting stays numeric
+    return std::round(food.distance * 1000.0) / 1000.0;
+  default:
+    return QVariant();
+  }
+}
+
+QVariant SimilarFoodsModel::headerData(int section,
+                                       Qt::Orientation orientation,
+                                       int role) const {
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QAbstractTableModel::headerData(section, orientation, role);
+
+  static const char *const names[ColumnCount] = {"Description", "Group",
+                                                 "Distance"};
+  return section >= 0 && section < ColumnCount ? QString(names[section])
+                                               : QVariant();
+}
@@ -1,8 +1,20 @@
 #include "db/databasemanager.h"
 #include "db/foodrepository.h"
+#include "db/ftssearchbackend.h"
+#include "db/fuzzysearchbackend.h"
+#include "db/recipeimporter.h"
+#include "meal/mealoptimizer.h"
+#include "meal/mealtotals.h"
+#include <QBuffer>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QThread>
 #include <QtTest>
+#include <algorithm>
+#include <cmath>
 
 class TestFoodRepository : public QObject {
   Q_OBJECT
@@ -38,6 +50,681 @@ private slots:
     QVERIFY2(found, "Search results should contain 'Apple'");
   }
 
+  void testParallelSearchMatchesSerial() {
+    FoodRepository serial;
+    serial.setSearchThreadCount(1);
+    FoodRepository parallel;
+    parallel.setSearchThreadCount(8);
+
+    for (const QString &query : {"apple", "chiken brest", "ab", "raw"}) {
+      auto expected = serial.searchFoods(query);
+      auto actual = parallel.searchFoods(query);
+      QCOMPARE(actual.size(), expected.size());
+      for (size_t i = 0; i < expected.size(); ++i) {
+        QCOMPARE(actual[i].id, expected[i].id);
+        QCOMPARE(actual[i].score, expected[i].score);
+      }
+    }
+  }
+
+  void testSessionRefinesPrefixQueries() {
+    FoodRepository repo;
+    FoodRepository reference;
+    SearchSession session;
+    for (const QString &query : {"ch", "chi", "chick", "chicken"}) {
+      auto refined = repo.searchFoods(query, &session);
+      auto fresh = reference.searchFoods(query);
+      QCOMPARE(refined.size(), fresh.size());
+      for (size_t i = 0; i < fresh.size(); ++i)
+        QCOMPARE(refined[i].id, fresh[i].id);
+    }
+  }
+
+  void testResultCacheHitsNormalizedQueries() {
+    FoodRepository repo;
+    auto first = repo.searchFoods("Chicken, breast");
+    QCOMPARE(repo.resultCache().misses(), quint64(1));
+
+    auto second = repo.searchFoods("  chicken   breast ");
+    QCOMPARE(repo.resultCache().hits(), quint64(1));
+    QCOMPARE(second.size(), first.size());
+    for (size_t i = 0; i < first.size(); ++i)
+      QCOMPARE(second[i].id, first[i].id);
+  }
+
+  void testExactDescriptionWithPunctuationScores100() {
+    FoodRepository repo;
+    auto results = repo.searchFoods("beef, ground");
+    auto it = std::find_if(results.begin(), results.end(),
+                           [](const FoodItem &item) {
+                             return item.description.contains(',');
+                           });
+    if (it == results.end())
+      QSKIP("No food with a comma in its description");
+
+    // Commas are part of the description, so dropping them from the scored
+    // query would turn an exact match into a token match
+    const FoodItem food = *it;
+    auto exact = repo.searchFoods(food.description);
+    QVERIFY(!exact.empty());
+    QCOMPARE(exact.front().score, 100);
+    QCOMPARE(exact.front().description, food.description);
+  }
+
+  void testGroupFilterAndFacets_data() {
+    QTest::addColumn<bool>("fts");
+    QTest::newRow("fuzzy") << false;
+    QTest::newRow("fts5") << true;
+  }
+
+  void testGroupFilterAndFacets() {
+    QFETCH(bool, fts);
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    FoodRepository repo;
+    if (fts)
+      repo.setSearchBackend(
+          std::make_shared<FtsSearchBackend>(dir.filePath("fts.sqlite3")));
+
+    // A ranking cached without facets can't answer a search wanting them
+    repo.rankFoods("beef");
+    std::vector<SearchFacet> facets;
+    SearchScope everything;
+    everything.facets = &facets;
+    auto results = repo.rankFoods("beef", nullptr, nullptr, &everything);
+    if (results.empty())
+      QSKIP("No foods found to filter");
+    QVERIFY(!facets.empty());
+    QCOMPARE(repo.resultCache().hits(), quint64(0));
+    int total = 0;
+    for (const SearchFacet &f : facets)
+      total += f.count;
+    QVERIFY(total >= static_cast<int>(results.size()));
+
+    const int group = results.front().foodGroupId;
+    auto facet = std::find_if(
+        facets.begin(), facets.end(),
+        [group](const SearchFacet &f) { return f.foodGroupId == group; });
+    QVERIFY(facet != facets.end());
+    QVERIFY(!repo.foodGroups().name(group).isEmpty());
+
+    std::vector<SearchFacet> scopedFacets;
+    SearchScope scoped;
+    scoped.foodGroupId = group;
+    scoped.facets = &scopedFacets;
+    auto filtered = repo.rankFoods("beef", nullptr, nullptr, &scoped);
+    QCOMPARE(static_cast<int>(filtered.size()), std::min(facet->count, 100));
+    QCOMPARE(scopedFacets.size(), size_t(1));
+    QCOMPARE(scopedFacets.front().count, facet->count);
+
+    // The unfiltered ranking's foods of that group lead the filtered one
+    size_t next = 0;
+    for (const FoodItem &item : results) {
+      if (item.foodGroupId != group)
+        continue;
+      QVERIFY(next < filtered.size());
+      QCOMPARE(filtered[next++].id, item.id);
+    }
+    for (const FoodItem &item : filtered)
+      QCOMPARE(item.foodGroupId, group);
+  }
+
+  void testSharedSnapshotSurvivesConcurrentSearches() {
+    FoodRepository &repo = FoodRepository::instance();
+    QCOMPARE(&repo, &FoodRepository::instance());
+    repo.ensureCacheLoaded();
+    auto snapshot = repo.snapshot();
+    QVERIFY(snapshot != nullptr);
+    QVERIFY(snapshot->generation != 0);
+
+    auto expected = repo.rankFoods("cheddar cheese");
+    std::vector<std::vector<FoodItem>> actual(4);
+    std::vector<QThread *> threads;
+    for (auto &result : actual) {
+      threads.push_back(QThread::create(
+          [&repo, &result] { result = repo.rankFoods("cheddar cheese"); }));
+      threads.back()->start();
+    }
+    for (QThread *thread : threads) {
+      thread->wait();
+      delete thread;
+    }
+    for (const auto &result : actual) {
+      QCOMPARE(result.size(), expected.size());
+      for (size_t i = 0; i < expected.size(); ++i)
+        QCOMPARE(result[i].id, expected[i].id);
+    }
+    QCOMPARE(repo.snapshot(), snapshot);
+  }
+
+  void testNutrientStoreMatchesDatabase() {
+    FoodRepository eager;
+    FoodRepository lazy;
+    lazy.setLazyNutrients(true);
+
+    auto results = eager.searchFoods("cheese");
+    if (results.empty())
+      QSKIP("No foods found to compare nutrients");
+    QVERIFY(!eager.snapshot()->nutrients.isEmpty());
+
+    // Lazy searches batch their nutrient lookup through bound ids
+    auto lazyResults = lazy.searchFoods("cheese");
+    QCOMPARE(lazyResults.size(), results.size());
+    for (size_t i = 0; i < results.size(); ++i)
+      QCOMPARE(lazyResults[i].nutrients.size(), results[i].nutrients.size());
+
+    auto byId = [](const Nutrient &a, const Nutrient &b) {
+      return a.index < b.index;
+    };
+    for (const auto &item : results) {
+      const FoodNutrients lazyView = lazy.getFoodNutrients(item.id);
+      const FoodNutrients eagerView = eager.getFoodNutrients(item.id);
+      // Eager lookups read the store in place
+      QVERIFY(eagerView.row().amounts ==
+              eager.snapshot()->nutrients.row(item.id).amounts);
+      std::vector<Nutrient> expected(lazyView.begin(), lazyView.end());
+      std::vector<Nutrient> actual(eagerView.begin(), eagerView.end());
+      std::sort(expected.begin(), expected.end(), byId);
+      std::sort(actual.begin(), actual.end(), byId);
+      QCOMPARE(actual.size(), expected.size());
+      QCOMPARE(item.nutrients.size(), expected.size());
+      for (size_t i = 0; i < expected.size(); ++i) {
+        QCOMPARE(actual[i].index, expected[i].index);
+        QCOMPARE(actual[i].amount, expected[i].amount);
+      }
+    }
+  }
+
+  void testPresenceBitsMatchNutrients() {
+    FoodRepository eager;
+    FoodRepository lazy;
+    lazy.setLazyNutrients(true);
+
+    auto results = eager.searchFoods("soy");
+    auto lazyResults = lazy.rankFoods("soy");
+    QCOMPARE(lazyResults.size(), results.size());
+    const NutrientDefinitions &definitions = eager.nutrientDefinitions();
+    for (size_t i = 0; i < results.size(); ++i) {
+      const FoodItem &item = results[i];
+      int amino = 0;
+      int flav = 0;
+      for (const Nutrient &n : item.nutrients) {
+        const int id = definitions.at(n.index).id;
+        amino += id >= NutrientPresence::kFirstAminoAcidId &&
+                 id <= NutrientPresence::kLastAminoAcidId;
+        flav += id >= NutrientPresence::kFirstFlavonoidId &&
+                id <= NutrientPresence::kLastFlavonoidId;
+      }
+      QCOMPARE(item.nutrientCount, static_cast<int>(item.nutrients.size()));
+      QCOMPARE(item.aminoCount, amino);
+      QCOMPARE(item.flavCount, flav);
+      QCOMPARE(lazyResults[i].nutrientCount, item.nutrientCount);
+      QCOMPARE(lazyResults[i].aminoCount, amino);
+      QCOMPARE(lazyResults[i].flavCount, flav);
+    }
+
+    // Vitamin K and choline, checked against every food's own nutrients
+    const std::vector<int> ids = eager.foodsReporting({430, 421});
+    QCOMPARE(lazy.foodsReporting({430, 421}), ids);
+    const int vitaminK = definitions.indexOf(430);
+    const int choline = definitions.indexOf(421);
+    const FoodCorpus &corpus = eager.snapshot()->corpus;
+    std::vector<int> expected;
+    for (int idx = 0; idx < corpus.size(); ++idx) {
+      bool hasK = false;
+      bool hasCholine = false;
+      for (const Nutrient &n : eager.getFoodNutrients(corpus.id(idx))) {
+        hasK = hasK || n.index == vitaminK;
+        hasCholine = hasCholine || n.index == choline;
+      }
+      if (hasK && hasCholine)
+        expected.push_back(corpus.id(idx));
+    }
+    QCOMPARE(ids, expected);
+    QCOMPARE(eager.snapshot()->presence.countReportingAll(
+                 {vitaminK, choline}),
+             static_cast<int>(expected.size()));
+    QVERIFY(eager.foodsReporting({-1}).empty());
+  }
+
+  void testTopFoodsByNutrientMatchesSql() {
+    FoodRepository eager;
+    FoodRepository lazy;
+    lazy.setLazyNutrients(true);
+
+    NutrientRankingQuery query;
+    query.nutrientId = 203; // Protein
+    query.limit = 20;
+    auto top = eager.topFoodsByNutrient(query);
+    if (top.empty())
+      QSKIP("No protein values to rank");
+
+    QSqlQuery sql(DatabaseManager::instance().database());
+    QVERIFY(sql.exec("SELECT food_id, nutr_val FROM nut_data "
+                     "WHERE nutr_id = 203 ORDER BY nutr_val DESC, food_id "
+                     "LIMIT 20"));
+    for (const RankedFood &food : top) {
+      QVERIFY(sql.next());
+      QCOMPARE(food.id, sql.value(0).toInt());
+      QCOMPARE(food.amount, sql.value(1).toDouble());
+      QCOMPARE(food.value, food.amount);
+    }
+
+    // Per kcal, within one group, and the same again from the database
+    query.basis = NutrientBasis::Per100Kcal;
+    query.foodGroupId = top.front().foodGroupId;
+    auto perKcal = eager.topFoodsByNutrient(query);
+    auto lazyPerKcal = lazy.topFoodsByNutrient(query);
+    QVERIFY(!perKcal.empty());
+    QCOMPARE(lazyPerKcal.size(), perKcal.size());
+    for (size_t i = 0; i < perKcal.size(); ++i) {
+      QCOMPARE(perKcal[i].foodGroupId, query.foodGroupId);
+      QCOMPARE(lazyPerKcal[i].id, perKcal[i].id);
+      if (i > 0)
+        QVERIFY(perKcal[i - 1].value >= perKcal[i].value);
+      double kcal = 0;
+      for (const Nutrient &n : eager.getFoodNutrients(perKcal[i].id)) {
+        if (eager.nutrientDefinitions().at(n.index).id == 208)
+          kcal = n.amount;
+      }
+      QVERIFY(kcal > 0);
+      QCOMPARE(perKcal[i].value, perKcal[i].amount / kcal * 100.0);
+    }
+  }
+
+  void testSimilarFoodsAreClosestFirst() {
+    FoodRepository eager;
+    FoodRepository lazy;
+    lazy.setLazyNutrients(true);
+
+    auto results = eager.searchFoods("milk");
+    if (results.empty())
+      QSKIP("No food to compare with");
+
+    SimilarityQuery query;
+    query.foodId = results.front().id;
+    query.limit = 10;
+    auto similar = eager.similarFoods(query);
+    QVERIFY(!similar.empty());
+    QVERIFY(static_cast<int>(similar.size()) <= query.limit);
+    for (size_t i = 0; i < similar.size(); ++i) {
+      QVERIFY(similar[i].id != query.foodId);
+      if (i > 0)
+        QVERIFY(similar[i - 1].distance <= similar[i].distance);
+    }
+
+    // The full scan agrees where there is no index, and the database-built
+    // profiles match the in-memory ones
+    query.exact = true;
+    auto exact = eager.similarFoods(query);
+    auto fromDatabase = lazy.similarFoods(query);
+    QCOMPARE(fromDatabase.size(), exact.size());
+    for (size_t i = 0; i < exact.size(); ++i)
+      QCOMPARE(fromDatabase[i].id, exact[i].id);
+    if (eager.snapshot()->corpus.size() < NutrientProfiles::kIndexThreshold) {
+      for (size_t i = 0; i < exact.size(); ++i)
+        QCOMPARE(similar[i].id, exact[i].id);
+    }
+
+    // Per kcal, by amounts, within one group
+    query.basis = NutrientBasis::Per100Kcal;
+    query.metric = SimilarityMetric::Euclidean;
+    query.foodGroupId = results.front().foodGroupId;
+    for (const SimilarFood &food : eager.similarFoods(query))
+      QCOMPARE(food.foodGroupId, query.foodGroupId);
+  }
+
+  void testMealTotalsTrackEdits() {
+    FoodRepository repo;
+    auto results = repo.searchFoods("milk");
+    if (results.size() < 3)
+      QSKIP("Not enough foods to build a meal");
+
+    const int definitionCount = repo.nutrientDefinitions().size();
+    std::vector<NutrientVector> foods;
+    std::vector<double> grams;
+    MealTotals totals;
+    totals.reset(definitionCount);
+    for (int i = 0; i < 3; ++i) {
+      foods.push_back(
+          NutrientVector::fromNutrients(results[i].nutrients, definitionCount));
+      grams.push_back(50.0 * (i + 1));
+      totals.addFood(foods.back(), grams.back());
+    }
+    totals.changeGrams(foods[1], grams[1], 30.0);
+    grams[1] = 30.0;
+    totals.removeFood(foods[0], grams[0]);
+
+    // Same as summing what is left from scratch
+    for (int d = 0; d < definitionCount; ++d) {
+      double expected = 0.0;
+      bool reported = false;
+      for (int i = 1; i < 3; ++i) {
+        expected += foods[i].amount(d) * grams[i] / 100.0;
+        reported = reported || std::binary_search(foods[i].reported.begin(),
+                                                  foods[i].reported.end(), d);
+      }
+      QCOMPARE(totals.isReported(d), reported);
+      QVERIFY(qAbs(totals.total(d) - expected) <= 1e-9 * (1 + expected));
+    }
+  }
+
+  void testMealOptimizerMeetsTargets() {
+    FoodRepository repo;
+    std::vector<FoodItem> results;
+    for (const char *query : {"milk", "beef", "bean", "apple", "bread"}) {
+      for (FoodItem &food : repo.searchFoods(query)) {
+        if (results.size() < 50)
+          results.push_back(std::move(food));
+      }
+    }
+    if (results.size() < 50)
+      QSKIP("Not enough foods to build a meal");
+
+    // Targets a meal of 100 g of the first five foods reaches exactly, so
+    // the solver has something to find; limits everything else
+    const int definitionCount = repo.nutrientDefinitions().size();
+    std::vector<NutrientVector> vectors;
+    std::vector<const NutrientVector *> foods;
+    std::vector<double> grams(results.size(), 50.0);
+    for (const FoodItem &food : results)
+      vectors.push_back(
+          NutrientVector::fromNutrients(food.nutrients, definitionCount));
+    for (const NutrientVector &vector : vectors)
+      foods.push_back(&vector);
+    std::vector<NutrientGoal> goals;
+    for (int d = 0; d < definitionCount && goals.size() < 150; ++d) {
+      NutrientGoal goal{d};
+      for (int i = 0; i < 5; ++i)
+        goal.target += vectors[i].amount(d);
+      goal.upperLimit = goal.target > 0 ? 0.0 : 1.0;
+      goals.push_back(goal);
+    }
+
+    MealOptimizerOptions noSteps;
+    noSteps.maxIterations = 0;
+    const double initial = optimizeMeal(foods, goals, grams, noSteps).objective;
+
+    const MealSolution solution = optimizeMeal(foods, goals, grams);
+    QCOMPARE(solution.grams.size(), results.size());
+    for (double g : solution.grams)
+      QVERIFY(g >= 0.0 && g <= MealOptimizerOptions().maxGrams);
+    QVERIFY(solution.objective <= initial);
+    QVERIFY(solution.exceededLimits.empty());
+
+    // The targets can all be met without exceeding a limit, so the solution
+    // should do both
+    for (const NutrientGoal &goal : goals) {
+      double total = 0.0;
+      for (size_t i = 0; i < vectors.size(); ++i)
+        total += vectors[i].amount(goal.definition) * solution.grams[i] / 100;
+      if (goal.target > 0)
+        QVERIFY2(std::abs(total / goal.target - 1.0) < 0.02,
+                 qPrintable(QString("Definition %1: %2 for a target of %3")
+                                .arg(goal.definition)
+                                .arg(total)
+                                .arg(goal.target)));
+      if (goal.upperLimit > 0)
+        QVERIFY2(total <= goal.upperLimit * 1.001,
+                 qPrintable(QString("Definition %1: %2 over a limit of %3")
+                                .arg(goal.definition)
+                                .arg(total)
+                                .arg(goal.upperLimit)));
+    }
+  }
+
+  void testRecipeImportResolvesIngredients() {
+    FoodRepository repo;
+    repo.ensureCacheLoaded();
+    auto snap = repo.snapshot();
+    if (!snap || snap->corpus.size() < 200)
+      QSKIP("Not enough foods to import");
+
+    // A header, quoted descriptions, a bad line and a hopeless ingredient,
+    // then 2000 lines naming real foods
+    QByteArray csv = "Grams,Ingredient\n"
+                     "# comment\n"
+                     "100,\"Milk, whole\"\n"
+                     "lots,Butter\n"
+                     "50 g,qxzzv wqpt\n";
+    for (int i = 0; i < 2000; ++i) {
+      QString description = snap->corpus.description(i % 200);
+      description.replace('"', "\"\"");
+      csv += QString("%1,\"%2\"\n").arg(10 + i % 90).arg(description).toUtf8();
+    }
+    QBuffer buffer(&csv);
+
+    RecipeImportOptions options;
+    options.chunkLines = 256;
+    RecipeImportResult result;
+    int lastProgress = 0;
+    QVERIFY(importRecipeCsv(buffer, repo, result, options,
+                            [&](int lines) { lastProgress = lines; }));
+
+    QCOMPARE(static_cast<int>(result.ingredients.size()), 2002);
+    QCOMPARE(result.problems.size(), 1);
+    QVERIFY(result.problems.front().startsWith("Line 4:"));
+    QCOMPARE(lastProgress, 2005);
+
+    const ImportedIngredient &milk = result.ingredients[0];
+    QCOMPARE(milk.lineNumber, 3);
+    QCOMPARE(milk.text, QString("Milk, whole"));
+    QCOMPARE(milk.grams, 100.0);
+    QVERIFY(milk.foodId >= 0);
+    // Scored as written, comma included: only a description holding
+    // "milk, whole" is found, and scores 90 (100 if it is all of it)
+    QVERIFY(milk.foodName.contains("milk, whole", Qt::CaseInsensitive));
+    QCOMPARE(milk.score,
+             milk.foodName.compare("milk, whole", Qt::CaseInsensitive) == 0
+                 ? 100
+                 : 90);
+    QVERIFY(!milk.lowConfidence);
+    QCOMPARE(result.ingredients[1].foodId, -1);
+    QVERIFY(result.ingredients[1].lowConfidence);
+    QCOMPARE(result.ingredients[1].grams, 50.0);
+
+    // Exact descriptions are confident, and in file order
+    for (int i = 0; i < 2000; ++i) {
+      const ImportedIngredient &ingredient = result.ingredients[i + 2];
+      QCOMPARE(ingredient.lineNumber, i + 6);
+      QCOMPARE(ingredient.grams, 10.0 + i % 90);
+      QCOMPARE(ingredient.foodName, snap->corpus.description(i % 200));
+      QCOMPARE(ingredient.score, 100);
+      QVERIFY(!ingredient.lowConfidence);
+    }
+    QVERIFY(result.lowConfidenceCount >= 1);
+
+    // One thread resolves the same
+    QBuffer again(&csv);
+    options.threadCount = 1;
+    RecipeImportResult serial;
+    QVERIFY(importRecipeCsv(again, repo, serial, options));
+    QCOMPARE(serial.ingredients.size(), result.ingredients.size());
+    for (size_t i = 0; i < serial.ingredients.size(); ++i)
+      QCOMPARE(serial.ingredients[i].foodId, result.ingredients[i].foodId);
+
+    // FTS ranks its best hit 100 whatever it is; the confidence still comes
+    // from how well the food's description matches the text
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    FoodRepository fts;
+    fts.setSearchBackend(
+        std::make_shared<FtsSearchBackend>(dir.filePath("fts.sqlite3")));
+    QByteArray few = "100,\"Milk, whole\"\n"
+                     "50,qxzzv wqpt\n";
+    for (int i = 0; i < 20; ++i) {
+      QString description = snap->corpus.description(i);
+      description.replace('"', "\"\"");
+      few += QString("10,\"%1\"\n").arg(description).toUtf8();
+    }
+    QBuffer fewBuffer(&few);
+    RecipeImportResult ftsResult;
+    QVERIFY(importRecipeCsv(fewBuffer, fts, ftsResult, options));
+    QCOMPARE(static_cast<int>(ftsResult.ingredients.size()), 22);
+    QVERIFY(ftsResult.ingredients[0].score >= 90);
+    QVERIFY(!ftsResult.ingredients[0].lowConfidence);
+    QCOMPARE(ftsResult.ingredients[1].foodId, -1);
+    QVERIFY(ftsResult.ingredients[1].lowConfidence);
+    for (int i = 0; i < 20; ++i) {
+      const ImportedIngredient &ingredient = ftsResult.ingredients[i + 2];
+      QVERIFY(ingredient.foodId >= 0);
+      QVERIFY(!ingredient.lowConfidence);
+      if (ingredient.foodName == ingredient.text)
+        QCOMPARE(ingredient.score, 100);
+    }
+  }
+
+  void testConcurrentLoadsShareOneSnapshot() {
+    FoodRepository repo;
+    int finalSteps = 0;
+    std::shared_ptr<const FoodSnapshot> fromWorker;
+    QThread *worker = QThread::create([&] {
+      repo.ensureCacheLoaded([&finalSteps](int step, int stepCount,
+                                           const QString &) {
+        if (step == stepCount)
+          ++finalSteps;
+      });
+      fromWorker = repo.snapshot();
+    });
+    worker->start();
+    repo.ensureCacheLoaded();
+    worker->wait();
+    delete worker;
+
+    QVERIFY(fromWorker != nullptr);
+    QCOMPARE(repo.snapshot(), fromWorker);
+    QVERIFY(finalSteps <= 1);
+    QVERIFY(repo.loadTimings().foodLoadMs >= 0);
+  }
+
+  void testSnapshotFileIsMappedOnNextLoad() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("search-snapshot.bin");
+
+    FoodRepository built;
+    built.setSnapshotPath(path);
+    auto expected = built.searchFoods("cheddar cheese");
+    QVERIFY(built.snapshot()->mapping == nullptr);
+    QVERIFY(QFileInfo::exists(path));
+
+    FoodRepository mapped;
+    mapped.setSnapshotPath(path);
+    auto actual = mapped.searchFoods("cheddar cheese");
+    QVERIFY(mapped.snapshot()->mapping != nullptr);
+    QCOMPARE(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      QCOMPARE(actual[i].id, expected[i].id);
+      QCOMPARE(actual[i].description, expected[i].description);
+      QCOMPARE(actual[i].score, expected[i].score);
+      QCOMPARE(actual[i].nutrients.size(), expected[i].nutrients.size());
+    }
+
+    // A damaged file is rebuilt instead of used
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() / 2));
+    file.close();
+    FoodRepository rebuilt;
+    rebuilt.setSnapshotPath(path);
+    QCOMPARE(rebuilt.searchFoods("cheddar cheese").size(), expected.size());
+    QVERIFY(rebuilt.snapshot()->mapping == nullptr);
+  }
+
+  void testFtsBackendMatchesPrefixes() {
+    QCOMPARE(FtsSearchBackend::matchExpression("chick \"brea"),
+             QString("\"chick\"* \"\"\"brea\"*"));
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    FoodRepository repo;
+    repo.setSearchBackend(
+        std::make_shared<FtsSearchBackend>(dir.filePath("fts.sqlite3")));
+    QCOMPARE(repo.searchBackend()->name(), QString("fts5"));
+
+    auto results = repo.searchFoods("chedd chee");
+    QVERIFY2(!results.empty(), "Prefixes should match cheddar cheese");
+    QCOMPARE(results.front().score, 100);
+    for (const auto &item : results) {
+      QVERIFY(item.description.contains("chedd", Qt::CaseInsensitive));
+      QVERIFY(item.description.contains("chee", Qt::CaseInsensitive));
+    }
+    for (size_t i = 1; i < results.size(); ++i)
+      QVERIFY(results[i - 1].score >= results[i].score);
+
+    // A second backend picks up the index already on disk
+    FoodRepository again;
+    again.setSearchBackend(
+        std::make_shared<FtsSearchBackend>(dir.filePath("fts.sqlite3")));
+    QCOMPARE(again.searchFoods("chedd chee").size(), results.size());
+  }
+
+  void testFtsFailureFallsBackUncached() {
+    // A path below a plain file can never hold the index
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile blocker(dir.filePath("blocker"));
+    QVERIFY(blocker.open(QIODevice::WriteOnly));
+    blocker.close();
+    auto backend = std::make_shared<FtsSearchBackend>(
+        dir.filePath("blocker/fts.sqlite3"));
+
+    FoodRepository repo;
+    repo.setSearchBackend(backend);
+    repo.ensureCacheLoaded();
+    const std::shared_ptr<const FoodSnapshot> snap = repo.snapshot();
+    QVERIFY(snap != nullptr);
+    SearchRequest request;
+    request.snapshot = snap.get();
+    request.query = "cheddar";
+    std::vector<SearchMatch> matches;
+    QVERIFY(!backend->rank(request, matches));
+    QVERIFY(matches.empty());
+
+    // Searches still work, in memory, and nothing is cached
+    QVERIFY(!repo.searchFoods("cheddar").empty());
+    QVERIFY(!repo.searchFoods("cheddar").empty());
+    QCOMPARE(repo.resultCache().hits(), quint64(0));
+  }
+
+  void testCachedQueryIsReused() {
+    DatabaseManager &manager = DatabaseManager::instance();
+    const QString sql = "SELECT count(*) FROM food_des WHERE id > ?";
+    QSqlQuery *first = manager.cachedQuery(sql);
+    QVERIFY(first != nullptr);
+    QCOMPARE(manager.cachedQuery(sql), first);
+
+    int rows = 0;
+    QVERIFY(manager.forEachRowIn("SELECT id FROM food_des WHERE id IN (%1)",
+                                 {-1, -2, -3}, [&rows](const QSqlQuery &) {
+                                   ++rows;
+                                 }));
+    QCOMPARE(rows, 0);
+  }
+
+  void testEachThreadGetsItsOwnConnection() {
+    DatabaseManager &manager = DatabaseManager::instance();
+    const QString mainName = manager.database().connectionName();
+    QVERIFY(manager.settingsReport().contains("query_only=1"));
+
+    QString workerName;
+    int workerFoods = 0;
+    QThread *worker = QThread::create([&] {
+      QSqlDatabase db = manager.database();
+      workerName = db.connectionName();
+      QSqlQuery query("SELECT count(*) FROM food_des", db);
+      if (query.next())
+        workerFoods = query.value(0).toInt();
+    });
+    worker->start();
+    worker->wait();
+    delete worker;
+
+    QVERIFY(!workerName.isEmpty());
+    QVERIFY(workerName != mainName);
+    QVERIFY(workerFoods > 0);
+  }
+
   void testGetFoodNutrients() {
     FoodRepository repo;
     // Known ID for "Apples, raw, with skin" might be 9003 in SR28, but let's
@@ -51,6 +738,13 @@ private slots:
     auto nutrients = repo.getFoodNutrients(foodId);
     QVERIFY2(!nutrients.empty(),
              "Nutrients should not be empty for a valid food");
+
+    const NutrientDefinitions &definitions = repo.nutrientDefinitions();
+    for (const auto &nut : nutrients) {
+      QVERIFY(nut.index < definitions.size());
+      QCOMPARE(definitions.indexOf(definitions.at(nut.index).id),
+               int(nut.index));
+    }
   }
 };
 
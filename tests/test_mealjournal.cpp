@@ -0,0 +1,122 @@
+#include "db/mealjournal.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// The journal is a file of its own and needs no food database
+class TestMealJournal : public QObject {
+  Q_OBJECT
+
+private slots:
+  void testMealJournalSumsRangesAndSurvivesTornAppends() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("journal.bin");
+
+    // Two years of days with one entry each, 10 mg of nutrient 301 and a
+    // day number's worth of nutrient 208, logged out of order
+    const QDate start(2024, 1, 1);
+    std::vector<JournalEntry> entries;
+    for (int day = 729; day >= 0; --day) {
+      JournalEntry entry;
+      entry.day = start.addDays(day);
+      entry.foodId = 1001;
+      entry.description = "Butter";
+      entry.grams = 14.0;
+      entry.nutrientIds = {301, 208};
+      entry.amounts = {10.0F, static_cast<float>(day)};
+      entries.push_back(entry);
+    }
+    {
+      MealJournal journal;
+      QVERIFY(journal.open(path));
+      QVERIFY(journal.append(entries));
+      QCOMPARE(journal.entryCount(), 730);
+    }
+
+    // A crash halfway through an append leaves a partial record behind
+    {
+      QFile file(path);
+      QVERIFY(file.open(QIODevice::Append));
+      file.write(QByteArray(13, '\x7f'));
+    }
+
+    MealJournal journal;
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.entryCount(), 730);
+    QCOMPARE(journal.firstDay(), start);
+    QCOMPARE(journal.lastDay(), start.addDays(729));
+
+    // Days 10..19, plus an extra entry on day 15 appended after the repair
+    JournalEntry extra = entries.back();
+    extra.day = start.addDays(15);
+    QVERIFY(journal.append({extra}));
+    const JournalTotals totals =
+        journal.totals(start.addDays(10), start.addDays(19));
+    QCOMPARE(totals.calendarDays, 10);
+    QCOMPARE(totals.loggedDays, 10);
+    QCOMPARE(totals.entryCount, 11);
+    QCOMPARE(totals.nutrientIds, std::vector<int>({301, 208}));
+    QCOMPARE(totals.amounts[0], 110.0);
+    QCOMPARE(totals.amounts[1], 145.0); // 10 + ... + 19; the extra adds 0
+
+    // The repaired file reads back the same, extra entry included
+    journal.close();
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.entryCount(), 731);
+    QCOMPARE(journal.totals(start, start.addDays(729)).amounts[0], 7310.0);
+  }
+
+  void testMealJournalKeepsRecordsAfterDamage() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("journal.bin");
+
+    // Three records, remembering where each one ends
+    std::vector<qint64> ends;
+    {
+      MealJournal journal;
+      QVERIFY(journal.open(path));
+      for (int day = 0; day < 3; ++day) {
+        JournalEntry entry;
+        entry.day = QDate(2024, 1, 1).addDays(day);
+        entry.foodId = 1001;
+        entry.description = "Butter";
+        entry.grams = 14.0;
+        entry.nutrientIds = {301};
+        entry.amounts = {10.0F};
+        QVERIFY(journal.append({entry}));
+        ends.push_back(QFileInfo(path).size());
+      }
+    }
+
+    // Garble the last byte of one record
+    auto damage = [&path](qint64 offset) {
+      QFile file(path);
+      QVERIFY(file.open(QIODevice::ReadWrite));
+      QVERIFY(file.seek(offset));
+      char byte = 0;
+      QVERIFY(file.getChar(&byte));
+      QVERIFY(file.seek(offset));
+      QVERIFY(file.putChar(static_cast<char>(byte ^ 0x5a)));
+    };
+
+    // The middle one: later history is at stake, so the file stays as it is
+    damage(ends[1] - 1);
+    MealJournal journal;
+    QVERIFY(!journal.open(path));
+    QVERIFY(!journal.isOpen());
+    QCOMPARE(QFileInfo(path).size(), ends[2]);
+
+    // The last one can only be a torn append, and is cut off
+    damage(ends[1] - 1);
+    damage(ends[2] - 1);
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.entryCount(), 2);
+    QCOMPARE(QFileInfo(path).size(), ends[1]);
+  }
+};
+
+QTEST_GUILESS_MAIN(TestMealJournal)
+#include "test_mealjournal.moc"
@@ -0,0 +1,142 @@
+#include "meal/mealoptimizer.h"
+#include <QElapsedTimer>
+#include <QtTest>
+#include <cmath>
+#include <random>
+
+namespace {
+
+constexpr int kFoodCount = 50;
+constexpr int kNutrientCount = 150;
+
+// A meal shaped like the USDA data: each nutrient has a unit scale from
+// micrograms to hundreds of grams, and each food reports about 60% of them.
+// The targets are what 50-150 g of each of the first five foods provide, so
+// they can all be met. Nutrients those five do not report are limited to 1
+// unit, and every fifth nutrient with a target also gets a limit 10% above
+// it.
+struct SyntheticMeal {
+  std::vector<NutrientVector> vectors;
+  std::vector<NutrientGoal> goals;
+
+  explicit SyntheticMeal(unsigned seed) {
+    std::mt19937 random(seed);
+    std::vector<double> scale(kNutrientCount);
+    for (double &s : scale)
+      s = std::pow(10.0, static_cast<int>(random() % 6) - 3);
+    vectors.resize(kFoodCount);
+    for (NutrientVector &food : vectors) {
+      food.amounts.assign(kNutrientCount, 0.0);
+      for (int d = 0; d < kNutrientCount; ++d) {
+        if (random() % 100 >= 60)
+          continue;
+        food.amounts[d] = scale[d] * (1 + random() % 1000) / 10.0;
+        food.reported.push_back(d);
+      }
+    }
+    std::vector<double> grams(5);
+    for (double &g : grams)
+      g = 50.0 + random() % 100;
+    for (int d = 0; d < kNutrientCount; ++d) {
+      NutrientGoal goal{d};
+      for (int i = 0; i < 5; ++i)
+        goal.target += vectors[i].amount(d) * grams[i] / 100.0;
+      if (goal.target <= 0)
+        goal.upperLimit = 1.0;
+      else if (d % 5 == 0)
+        goal.upperLimit = goal.target * 1.1;
+      goals.push_back(goal);
+    }
+  }
+
+  [[nodiscard]] std::vector<const NutrientVector *> foods() const {
+    std::vector<const NutrientVector *> pointers;
+    for (const NutrientVector &vector : vectors)
+      pointers.push_back(&vector);
+    return pointers;
+  }
+
+  [[nodiscard]] double total(int definition,
+                             const std::vector<double> &grams) const {
+    double sum = 0.0;
+    for (size_t i = 0; i < vectors.size(); ++i)
+      sum += vectors[i].amount(definition) * grams[i] / 100.0;
+    return sum;
+  }
+};
+
+} // namespace
+
+// The optimizer works on nutrient vectors alone and needs no food database
+class TestMealOptimizer : public QObject {
+  Q_OBJECT
+
+private slots:
+  void testRealisticMealSolvesInBoundedTime_data() {
+    QTest::addColumn<unsigned>("seed");
+    QTest::newRow("seed 1") << 1U;
+    QTest::newRow("seed 2") << 2U;
+    QTest::newRow("seed 3") << 3U;
+  }
+
+  void testRealisticMealSolvesInBoundedTime() {
+    QFETCH(unsigned, seed);
+    const SyntheticMeal meal(seed);
+    const std::vector<double> start(kFoodCount, 100.0);
+
+    QElapsedTimer timer;
+    timer.start();
+    const MealSolution solution = optimizeMeal(meal.foods(), meal.goals, start);
+    const qint64 elapsedMs = timer.elapsed();
+
+    QVERIFY(solution.converged);
+    QVERIFY(solution.iterations < MealOptimizerOptions().maxIterations);
+    QVERIFY(solution.exceededLimits.empty());
+    for (double g : solution.grams)
+      QVERIFY(g >= 0.0 && g <= MealOptimizerOptions().maxGrams);
+    for (const NutrientGoal &goal : meal.goals) {
+      const double total = meal.total(goal.definition, solution.grams);
+      if (goal.target > 0)
+        QVERIFY2(std::abs(total / goal.target - 1.0) < 0.01,
+                 qPrintable(QString("Definition %1: %2 for a target of %3")
+                                .arg(goal.definition)
+                                .arg(total)
+                                .arg(goal.target)));
+      if (goal.upperLimit > 0)
+        QVERIFY2(total <= goal.upperLimit * 1.001,
+                 qPrintable(QString("Definition %1: %2 over a limit of %3")
+                                .arg(goal.definition)
+                                .arg(total)
+                                .arg(goal.upperLimit)));
+    }
+#ifdef QT_NO_DEBUG
+    QVERIFY2(elapsedMs < 50, qPrintable(QString("%1 ms").arg(elapsedMs)));
+#else
+    Q_UNUSED(elapsedMs);
+#endif
+  }
+
+  void testLimitsAreEnforcedOrReported() {
+    // One food, with a target it can only reach by doubling the limit
+    NutrientVector food;
+    food.amounts = {10.0};
+    food.reported = {0};
+    const std::vector<NutrientGoal> goals = {{0, 20.0, 10.0}};
+
+    // The first round alone leaves the limit a little exceeded
+    MealOptimizerOptions oneRound;
+    oneRound.limitRounds = 0;
+    const MealSolution soft = optimizeMeal({&food}, goals, {0.0}, oneRound);
+    QVERIFY(soft.grams[0] > 100.1);
+    QCOMPARE(soft.exceededLimits, std::vector<int>({0}));
+
+    // Later rounds push it back under
+    const MealSolution hard = optimizeMeal({&food}, goals, {0.0});
+    QVERIFY(hard.grams[0] <= 100.1);
+    QVERIFY(hard.grams[0] > 99.0);
+    QVERIFY(hard.exceededLimits.empty());
+  }
+};
+
+QTEST_GUILESS_MAIN(TestMealOptimizer)
+#include "test_mealoptimizer.moc"
@@ -0,0 +1,267 @@
+#include "db/nutrientdefinitions.h"
+#include "meal/mealtotals.h"
+#include "widgets/foodresultsmodel.h"
+#include "widgets/mealmodels.h"
+#include "widgets/similarfoodsmodel.h"
+#include <QAbstractItemModelTester>
+#include <QSignalSpy>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QtTest>
+
+namespace {
+
+FoodItem foodItem(int id, int score) {
+  return {id, QString("Food %1").arg(id), 100, 10, 0, 0, score, {}};
+}
+
+std::vector<FoodItem> foods(const std::vector<int> &ids) {
+  std::vector<FoodItem> results;
+  for (int id : ids)
+    results.push_back(foodItem(id, 100 - id));
+  return results;
+}
+
+// Rows and columns of each dataChanged the spy saw
+QList<QList<int>> changedRanges(const QSignalSpy &spy) {
+  QList<QList<int>> ranges;
+  for (const QList<QVariant> &arguments : spy) {
+    const auto topLeft = arguments.at(0).value<QModelIndex>();
+    const auto bottomRight = arguments.at(1).value<QModelIndex>();
+    ranges.append({topLeft.row(), topLeft.column(), bottomRight.row(),
+                   bottomRight.column()});
+  }
+  return ranges;
+}
+
+QList<int> rowRange(const QList<QVariant> &arguments) {
+  return {arguments.at(1).toInt(), arguments.at(2).toInt()};
+}
+
+MealItem mealItem(int foodId, double grams) {
+  NutrientVector per100g;
+  per100g.amounts = {0.0, 50.0};
+  per100g.reported = {1};
+  return {foodId, QString("Food %1").arg(foodId), grams, per100g};
+}
+
+} // namespace
+
+class TestModels : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase() {
+    // Six nutrients, from an in-memory nutr_def
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "test_models");
+    db.setDatabaseName(":memory:");
+    QVERIFY(db.open());
+    QSqlQuery query(db);
+    QVERIFY(query.exec("CREATE TABLE nutr_def (id INTEGER PRIMARY KEY, "
+                       "nutr_desc TEXT, unit TEXT, rda REAL)"));
+    for (int id = 1; id <= 6; ++id)
+      QVERIFY(query.exec(QString("INSERT INTO nutr_def VALUES "
+                                 "(%1, 'Nutrient %1', 'g', %2)")
+                             .arg(id)
+                             .arg(id * 10)));
+    QVERIFY(m_definitions.load(db));
+    QCOMPARE(m_definitions.size(), 6);
+  }
+
+  void cleanupTestCase() {
+    QSqlDatabase::database("test_models").close();
+    QSqlDatabase::removeDatabase("test_models");
+  }
+
+  void testFoodResultsChangeOnlyTheirRows() {
+    FoodResultsModel model;
+    QAbstractItemModelTester tester(
+        &model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+    QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+    QSignalSpy reset(&model, &QAbstractItemModel::modelReset);
+
+    model.setResults(foods({1, 2, 3, 4, 5}));
+    QCOMPARE(model.rowCount(), 5);
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(rowRange(inserted.takeFirst()), QList<int>({0, 4}));
+
+    // Shrinking removes only the tail
+    model.setResults(foods({1, 2, 3}));
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(rowRange(removed.takeFirst()), QList<int>({3, 4}));
+    QCOMPARE(changed.count(), 0);
+
+    // Growing inserts only the new tail
+    model.setResults(foods({1, 2, 3, 4, 5, 6}));
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(rowRange(inserted.takeFirst()), QList<int>({3, 5}));
+    QCOMPARE(changed.count(), 0);
+
+    // A swap in the middle repaints just the two rows
+    model.setResults(foods({1, 2, 4, 3, 5, 6}));
+    QCOMPARE(changedRanges(changed),
+             QList<QList<int>>(
+                 {{2, 0, 3, FoodResultsModel::ColumnCount - 1}}));
+    changed.clear();
+    QCOMPARE(model.food(2).id, 4);
+    QCOMPARE(model.food(3).id, 3);
+    QCOMPARE(model.index(2, FoodResultsModel::IdColumn).data().toInt(), 4);
+
+    // A new score for the same food is a change too
+    std::vector<FoodItem> rescored = foods({1, 2, 4, 3, 5, 6});
+    rescored[5].score = 1;
+    model.setResults(std::move(rescored));
+    QCOMPARE(changedRanges(changed),
+             QList<QList<int>>(
+                 {{5, 0, 5, FoodResultsModel::ColumnCount - 1}}));
+
+    model.setResults({});
+    QCOMPARE(model.rowCount(), 0);
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(inserted.count(), 0);
+    QCOMPARE(reset.count(), 0);
+  }
+
+  void testSimilarFoodsReplaceTheirRows() {
+    SimilarFoodsModel model;
+    QAbstractItemModelTester tester(
+        &model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    QSignalSpy reset(&model, &QAbstractItemModel::modelReset);
+
+    model.setFoods({{7, "Butter, salted", 100, 0.12345},
+                    {9, "Butter, whipped", 100, 0.5}});
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(reset.count(), 1);
+    QCOMPARE(model.food(1).id, 9);
+    QCOMPARE(
+        model.index(0, SimilarFoodsModel::DescriptionColumn).data().toString(),
+        QString("Butter, salted"));
+    QCOMPARE(
+        model.index(0, SimilarFoodsModel::DistanceColumn).data().toDouble(),
+        0.123);
+
+    model.setFoods({});
+    QCOMPARE(model.rowCount(), 0);
+    QCOMPARE(reset.count(), 2);
+  }
+
+  void testMealItemsSetGramsRepaintsChangedRuns() {
+    MealItemsModel model;
+    QAbstractItemModelTester tester(
+        &model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    model.setKcalIndex(1);
+    model.append({mealItem(1, 100), mealItem(2, 100), mealItem(3, 100),
+                  mealItem(4, 100), mealItem(5, 100)});
+    QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+    QSignalSpy edited(&model, &MealItemsModel::gramsEdited);
+
+    model.setGrams({100, 150, 20, 100, 75});
+    QCOMPARE(changedRanges(changed),
+             QList<QList<int>>({{1, MealItemsModel::GramsColumn, 2,
+                                 MealItemsModel::CaloriesColumn},
+                                {4, MealItemsModel::GramsColumn, 4,
+                                 MealItemsModel::CaloriesColumn}}));
+    QCOMPARE(edited.count(), 0);
+    QCOMPARE(model.items()[1].grams, 150.0);
+    QCOMPARE(model.index(2, MealItemsModel::CaloriesColumn).data().toDouble(),
+             10.0);
+
+    // Nothing new, nothing repainted; extra grams are ignored
+    changed.clear();
+    model.setGrams({100, 150, 20, 100, 75, 500});
+    QCOMPARE(changed.count(), 0);
+    QCOMPARE(model.rowCount(), 5);
+
+    // Fewer grams than rows leave the rest alone
+    model.setGrams({10});
+    QCOMPARE(changedRanges(changed),
+             QList<QList<int>>({{0, MealItemsModel::GramsColumn, 0,
+                                 MealItemsModel::CaloriesColumn}}));
+    QCOMPARE(model.items()[4].grams, 75.0);
+  }
+
+  void testMealTotalsRepaintAdjacentRunsOnce() {
+    MealTotals totals;
+    totals.reset(m_definitions.size());
+    MealTotalsModel model(totals);
+    QAbstractItemModelTester tester(
+        &model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    model.setDefinitions(m_definitions);
+    QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+
+    // Unsorted, with duplicates
+    model.totalsChanged({4, 1, 2, 1, 5, 2});
+    QCOMPARE(changedRanges(changed),
+             QList<QList<int>>({{1, MealTotalsModel::TotalColumn, 2,
+                                 MealTotalsModel::RdaColumn},
+                                {4, MealTotalsModel::TotalColumn, 5,
+                                 MealTotalsModel::RdaColumn}}));
+
+    // Indices outside the table only trim the run they are part of
+    changed.clear();
+    model.totalsChanged({7, 5, 6, -1, 0, 3});
+    QCOMPARE(changedRanges(changed),
+             QList<QList<int>>({{0, MealTotalsModel::TotalColumn, 0,
+                                 MealTotalsModel::RdaColumn},
+                                {3, MealTotalsModel::TotalColumn, 3,
+                                 MealTotalsModel::RdaColumn},
+                                {5, MealTotalsModel::TotalColumn, 5,
+                                 MealTotalsModel::RdaColumn}}));
+
+    changed.clear();
+    model.totalsChanged({});
+    QCOMPARE(changed.count(), 0);
+  }
+
+  void testReportedNutrientsFollowTheMeal() {
+    MealTotals totals;
+    totals.reset(m_definitions.size());
+    MealTotalsModel model(totals);
+    model.setDefinitions(m_definitions);
+    ReportedNutrientsFilter filter;
+    filter.setSourceModel(&model);
+    QAbstractItemModelTester tester(
+        &filter, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    QCOMPARE(filter.rowCount(), 0);
+    QSignalSpy inserted(&filter, &QAbstractItemModel::rowsInserted);
+    QSignalSpy removed(&filter, &QAbstractItemModel::rowsRemoved);
+
+    NutrientVector food;
+    food.amounts = {0.0, 5.0, 0.0, 2.0, 0.0, 0.0};
+    food.reported = {1, 3};
+    totals.addFood(food, 200);
+    model.totalsChanged(food.reported);
+    QCOMPARE(filter.rowCount(), 2);
+    QCOMPARE(inserted.count(), 2);
+    QCOMPARE(removed.count(), 0);
+    QCOMPARE(filter.mapToSource(filter.index(0, 0)).row(), 1);
+    QCOMPARE(filter.mapToSource(filter.index(1, 0)).row(), 3);
+    QCOMPARE(filter.index(1, MealTotalsModel::TotalColumn).data().toDouble(),
+             4.0);
+
+    // Still reported by another food, so the rows stay
+    NutrientVector other;
+    other.amounts = {0.0, 1.0, 0.0, 0.0, 0.0, 0.0};
+    other.reported = {1};
+    totals.addFood(other, 100);
+    totals.removeFood(food, 200);
+    model.totalsChanged({1, 3});
+    QCOMPARE(filter.rowCount(), 1);
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(filter.mapToSource(filter.index(0, 0)).row(), 1);
+
+    totals.removeFood(other, 100);
+    model.totalsChanged(other.reported);
+    QCOMPARE(filter.rowCount(), 0);
+    QCOMPARE(removed.count(), 2);
+  }
+
+private:
+  NutrientDefinitions m_definitions;
+};
+
+QTEST_GUILESS_MAIN(TestModels)
+#include "test_models.moc"
@@ -0,0 +1,160 @@
+#include "db/foodsnapshot.h"
+#include "db/fuzzysearchbackend.h"
+#include "utils/string_utils.h"
+#include <QtTest>
+#include <algorithm>
+
+namespace {
+
+FoodSnapshot makeSnapshot(const QStringList &descriptions, int foodGroupId) {
+  FoodSnapshot snap;
+  snap.generation = 1;
+  for (int i = 0; i < descriptions.size(); ++i)
+    snap.corpus.append(i + 1, descriptions[i], foodGroupId);
+  snap.buildSearchIndex();
+  return snap;
+}
+
+// Every food scoring above 40, best first, scored one at a time
+std::vector<SearchMatch> fullScan(const FoodSnapshot &snap,
+                                  const QString &query, size_t maxResults) {
+  std::vector<SearchMatch> expected;
+  for (int idx = 0; idx < snap.corpus.size(); ++idx) {
+    const int score =
+        Utils::calculateFuzzyScore(query, snap.corpus.description(idx));
+    if (score > 40)
+      expected.push_back({idx, snap.corpus.id(idx), score});
+  }
+  std::sort(expected.begin(), expected.end(),
+            [](const SearchMatch &a, const SearchMatch &b) {
+              return a.score != b.score ? a.score > b.score : a.id < b.id;
+            });
+  if (expected.size() > maxResults)
+    expected.resize(maxResults);
+  return expected;
+}
+
+} // namespace
+
+// Searches over small made-up corpora, which need no food database
+class TestSearch : public QObject {
+  Q_OBJECT
+
+private slots:
+  void testIndexedSearchMatchesFullScan() {
+    const FoodSnapshot snap = makeSnapshot(
+        {"Beef, ground, raw", "Candies, chocolate, dark",
+         "Chocolate, baking, unsweetened", "Cocoa, dry powder",
+         "Chocolate milk, reduced fat", "Cheese, cheddar"},
+        100);
+
+    // Typos every third letter share no trigram with "chocolate"
+    for (const QString &query : {"cxocxlaxe", "chocolate", "cheddar"}) {
+      const std::vector<SearchMatch> expected = fullScan(snap, query, 100);
+      QVERIFY(!expected.empty());
+
+      FuzzySearchBackend backend;
+      SearchRequest request;
+      request.snapshot = &snap;
+      request.query = query;
+      std::vector<SearchMatch> matches;
+      QVERIFY(backend.rank(request, matches));
+      QCOMPARE(matches.size(), expected.size());
+      for (size_t i = 0; i < expected.size(); ++i) {
+        QCOMPARE(matches[i].id, expected[i].id);
+        QCOMPARE(matches[i].score, expected[i].score);
+      }
+    }
+  }
+
+  void testSessionMatchesFreshSearchAfterTypo() {
+    const FoodSnapshot snap = makeSnapshot(
+        {"Beef", "Beef, ground, raw", "Bread, white", "Butter, salted"}, 100);
+
+    // "bx" leaves "Beef" far below the threshold, "bxef" above it
+    FuzzySearchBackend backend;
+    SearchSession session;
+    for (const QString &query : {"bx", "bxe", "bxef", "bxef g"}) {
+      SearchRequest request;
+      request.snapshot = &snap;
+      request.query = query;
+      std::vector<SearchMatch> fresh;
+      QVERIFY(backend.rank(request, fresh));
+
+      request.session = &session;
+      std::vector<SearchMatch> refined;
+      QVERIFY(backend.rank(request, refined));
+      QCOMPARE(refined.size(), fresh.size());
+      for (size_t i = 0; i < fresh.size(); ++i) {
+        QCOMPARE(refined[i].id, fresh[i].id);
+        QCOMPARE(refined[i].score, fresh[i].score);
+      }
+    }
+    QVERIFY(Utils::calculateFuzzyScore("bxef", "Beef") > 40);
+  }
+
+  void testPrunedPassMatchesFullScan_data() {
+    QTest::addColumn<QString>("query");
+    QTest::addColumn<int>("maxResults");
+    QTest::addColumn<int>("facetCount");
+    // Seven foods contain "chocolate"; "Chxcxlxte" scores 66 but shares
+    // two of its trigrams, too few to be a candidate of the pruned pass
+    QTest::newRow("pruned") << "chocolate" << 5 << 7;
+    QTest::newRow("all strong") << "chocolate" << 7 << 7;
+    QTest::newRow("too few strong") << "chocolate" << 8 << 8;
+    QTest::newRow("nothing strong") << "cxocxlaxe" << 3 << 7;
+  }
+
+  void testPrunedPassMatchesFullScan() {
+    QFETCH(QString, query);
+    QFETCH(int, maxResults);
+    QFETCH(int, facetCount);
+
+    QStringList descriptions = {"Chocolate, dark, 45% cacao",
+                                "Chocolate, dark, 60% cacao",
+                                "Chocolate, dark, 70% cacao",
+                                "Chocolate, dark, 85% cacao",
+                                "Candies, milk chocolate",
+                                "Chocolate milk, reduced fat",
+                                "Chocolate syrup",
+                                "Chxcxlxte bar, imitation",
+                                "Cocoa, dry powder"};
+    for (int lean = 70; lean < 100; lean += 2)
+      descriptions << QString("Beef, ground, %1% lean").arg(lean);
+    descriptions << "Cheese, cheddar" << "Apples, raw" << "Bread, white"
+                 << "Butter, salted" << "Rice, brown, cooked";
+    const FoodSnapshot snap = makeSnapshot(descriptions, 1900);
+
+    // The index only narrows at a strict threshold
+    std::vector<int> candidates;
+    const Utils::FuzzyQuery chocolate = Utils::prepareFuzzyQuery("chocolate");
+    QVERIFY(!snap.collectCandidates(chocolate, 40, candidates));
+    QVERIFY(snap.collectCandidates(chocolate, 80, candidates));
+    QCOMPARE(candidates, std::vector<int>({0, 1, 2, 3, 4, 5, 6}));
+
+    FuzzySearchBackend backend;
+    SearchRequest request;
+    request.snapshot = &snap;
+    request.query = query;
+    request.maxResults = maxResults;
+    std::vector<SearchFacet> facets;
+    request.facets = &facets;
+    std::vector<SearchMatch> matches;
+    QVERIFY(backend.rank(request, matches));
+
+    // The best matches never change; facets only count what was scored
+    const std::vector<SearchMatch> expected =
+        fullScan(snap, query, static_cast<size_t>(maxResults));
+    QCOMPARE(matches.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      QCOMPARE(matches[i].id, expected[i].id);
+      QCOMPARE(matches[i].score, expected[i].score);
+    }
+    QCOMPARE(static_cast<int>(facets.size()), 1);
+    QCOMPARE(facets.front().foodGroupId, 1900);
+    QCOMPARE(facets.front().count, facetCount);
+  }
+};
+
+QTEST_GUILESS_MAIN(TestSearch)
+#include "test_search.moc"
@@ -0,0 +1,226 @@
+#include "utils/simd_search.h"
+#include "utils/string_utils.h"
+#include <QRandomGenerator>
+#include <QtTest>
+#include <algorithm>
+
+class TestStringUtils : public QObject {
+  Q_OBJECT
+
+private slots:
+  void testLevenshteinKnownValues() {
+    QCOMPARE(Utils::fastLevenshteinDistance("kitten", "sitting"), 3);
+    QCOMPARE(Utils::fastLevenshteinDistance("", "abc"), 3);
+    QCOMPARE(Utils::fastLevenshteinDistance("beef", "beef"), 0);
+    QCOMPARE(Utils::fastLevenshteinDistance(QString::fromUtf8("jalapeño"),
+                                            QString::fromUtf8("jalapeno")),
+             1);
+  }
+
+  void testFastMatchesReference() {
+    // Random strings over small alphabets (with some non-ASCII) exercise
+    // plenty of matches and both sides of the 64 character limit
+    QRandomGenerator rng(42);
+    for (int iter = 0; iter < 5000; ++iter) {
+      const int alphabet = 2 + rng.bounded(6);
+      auto randomString = [&](int len) {
+        QString s;
+        for (int i = 0; i < len; ++i) {
+          const int c = rng.bounded(alphabet);
+          s += (rng.bounded(8) == 0) ? QChar(0x00e0 + c) : QChar('a' + c);
+        }
+        return s;
+      };
+      const QString a = randomString(rng.bounded(80));
+      const QString b = randomString(rng.bounded(80));
+
+      const int expected = Utils::levenshteinDistance(a, b);
+      QCOMPARE(Utils::fastLevenshteinDistance(a, b), expected);
+
+      const int budget = rng.bounded(40);
+      QCOMPARE(Utils::boundedLevenshteinDistance(a, b, budget),
+               std::min(expected, budget + 1));
+    }
+  }
+
+  void testAsciiContainsMatchesQByteArray() {
+    // Whichever kernel the CPU gets, it must be one of the known ones
+    QVERIFY(QStringList({"avx2", "sse2", "scalar"})
+                .contains(Utils::asciiContainsKernel()));
+    QRandomGenerator rng(7);
+    for (int iter = 0; iter < 20000; ++iter) {
+      auto randomBytes = [&](int len) {
+        QByteArray s;
+        for (int i = 0; i < len; ++i)
+          s += static_cast<char>('a' + rng.bounded(3));
+        return s;
+      };
+      const QByteArray haystack = randomBytes(rng.bounded(100));
+      const QByteArray needle = randomBytes(rng.bounded(1, 8));
+      QCOMPARE(Utils::asciiContains(haystack.constData(),
+                                    static_cast<int>(haystack.size()),
+                                    needle.constData(),
+                                    static_cast<int>(needle.size())),
+               haystack.contains(needle));
+    }
+  }
+
+  void testFuzzyScoreThreshold() {
+    QCOMPARE(Utils::calculateFuzzyScore("apple", "Apples, raw"), 90);
+    QCOMPARE(Utils::calculateFuzzyScore("chiken brest", "Chicken, breast"),
+             Utils::calculateFuzzyScore("chiken brest", "Chicken, breast", 40));
+    QVERIFY(Utils::calculateFuzzyScore("zzz", "Beef, ground", 40) <= 40);
+  }
+
+  void testUnicodeSpacesSeparateTokens() {
+    std::vector<Utils::TokenSpan> spans;
+    const QString text = QString::fromUtf8("beef\u00a0ground\u2003raw");
+    Utils::appendTokenSpans(text.constData(), static_cast<int>(text.length()),
+                            spans);
+    QCOMPARE(spans.size(), size_t(3));
+    QCOMPARE(spans[1].start, quint16(5));
+    QCOMPARE(spans[1].length, quint16(6));
+
+    // Each query token finds its own target token
+    QCOMPARE(Utils::calculateFuzzyScore("ground beef",
+                                        QString::fromUtf8("Beef,\u00a0ground")),
+             95);
+  }
+
+  void testMinSharedTrigramsIsALowerBound() {
+    auto sharedTrigrams = [](const QString &query, const QString &target) {
+      std::vector<quint64> queryKeys;
+      std::vector<quint64> targetKeys;
+      const Utils::FuzzyQuery q = Utils::prepareFuzzyQuery(query);
+      for (const Utils::TokenSpan &token : q.tokens)
+        Utils::appendTrigramKeys(q.text.constData() + token.start,
+                                 token.length, queryKeys);
+      const Utils::FuzzyQuery t = Utils::prepareFuzzyQuery(target);
+      for (const Utils::TokenSpan &token : t.tokens)
+        Utils::appendTrigramKeys(t.text.constData() + token.start,
+                                 token.length, targetKeys);
+      std::sort(queryKeys.begin(), queryKeys.end());
+      queryKeys.erase(std::unique(queryKeys.begin(), queryKeys.end()),
+                      queryKeys.end());
+      return static_cast<int>(std::count_if(
+          queryKeys.begin(), queryKeys.end(), [&](quint64 key) {
+            return std::find(targetKeys.begin(), targetKeys.end(), key) !=
+                   targetKeys.end();
+          }));
+    };
+
+    // Typos every third letter leave no trigram but still match
+    QVERIFY(Utils::calculateFuzzyScore("cxocxlaxe", "Chocolate, dark") > 40);
+    QCOMPARE(sharedTrigrams("cxocxlaxe", "Chocolate, dark"), 0);
+    QCOMPARE(Utils::minSharedTrigrams(
+                 Utils::prepareFuzzyQuery("cxocxlaxe"), 40),
+             0);
+
+    // Random edits of random queries never share fewer than the bound
+    QRandomGenerator rng(11);
+    const QString alphabet = "abcde";
+    int checked = 0;
+    for (int iter = 0; iter < 20000; ++iter) {
+      QString query;
+      const int tokenCount = 1 + rng.bounded(3);
+      for (int t = 0; t < tokenCount; ++t) {
+        if (t > 0)
+          query += ' ';
+        const int length = 1 + rng.bounded(10);
+        for (int i = 0; i < length; ++i)
+          query += alphabet[rng.bounded(5)];
+      }
+      QString target = query;
+      const int edits = rng.bounded(5);
+      for (int e = 0; e < edits; ++e) {
+        const int length = static_cast<int>(target.length());
+        const int pos = rng.bounded(length + 1);
+        const QChar c = alphabet[rng.bounded(5)];
+        if (pos == length || rng.bounded(3) == 0)
+          target.insert(pos, c);
+        else if (rng.bounded(2) == 0)
+          target[pos] = c;
+        else
+          target.remove(pos, 1);
+      }
+
+      const Utils::FuzzyQuery prepared = Utils::prepareFuzzyQuery(query);
+      for (int threshold : {40, 80}) {
+        if (Utils::calculateFuzzyScore(query, target) <= threshold)
+          continue;
+        ++checked;
+        QVERIFY2(sharedTrigrams(query, target) >=
+                     Utils::minSharedTrigrams(prepared, threshold),
+                 qPrintable(query + " / " + target));
+      }
+    }
+    QVERIFY(checked > 1000);
+    QVERIFY(Utils::minSharedTrigrams(Utils::prepareFuzzyQuery("strawberries"),
+                                     80) > 0);
+  }
+
+  void testMaxExtendedScoreIsAnUpperBound() {
+    // One typo, then a correct ending: "beef" jumps from 5 to 75
+    const Utils::FuzzyQuery bx = Utils::prepareFuzzyQuery("bx");
+    const Utils::FuzzyQuery bxef = Utils::prepareFuzzyQuery("bxef");
+    QVERIFY(Utils::calculateFuzzyScore("bx", "Beef") <= 20);
+    QVERIFY(Utils::calculateFuzzyScore("bxef", "Beef") > 40);
+    QVERIFY(Utils::maxExtendedScore(bx, bxef, 20) > 40);
+    // A long token gaining one letter can't get far
+    QVERIFY(Utils::maxExtendedScore(Utils::prepareFuzzyQuery("strawb"),
+                                    Utils::prepareFuzzyQuery("strawbe"),
+                                    20) <= 40);
+
+    QRandomGenerator rng(13);
+    const QString alphabet = "abcd";
+    auto randomText = [&](int tokenCount, int maxLength) {
+      QString text;
+      for (int t = 0; t < tokenCount; ++t) {
+        if (t > 0)
+          text += ' ';
+        const int length = 1 + rng.bounded(maxLength);
+        for (int i = 0; i < length; ++i)
+          text += alphabet[rng.bounded(4)];
+      }
+      return text;
+    };
+    int checked = 0;
+    for (int iter = 0; iter < 20000; ++iter) {
+      const QString before = randomText(1 + rng.bounded(2), 7);
+      QString after = before;
+      if (rng.bounded(2) == 0)
+        after += ' ';
+      after += randomText(1 + rng.bounded(2), 4);
+      const QString target = randomText(1 + rng.bounded(3), 8);
+
+      for (int scoreBefore : {20, 40}) {
+        if (Utils::calculateFuzzyScore(before, target) > scoreBefore)
+          continue;
+        ++checked;
+        QVERIFY2(Utils::calculateFuzzyScore(after, target) <=
+                     Utils::maxExtendedScore(
+                         Utils::prepareFuzzyQuery(before),
+                         Utils::prepareFuzzyQuery(after), scoreBefore),
+                 qPrintable(before + " / " + after + " / " + target));
+      }
+    }
+    QVERIFY(checked > 1000);
+  }
+
+  void testSplitCsvRecord() {
+    QStringList fields;
+    QVERIFY(Utils::splitCsvRecord("Egg,50", fields));
+    QCOMPARE(fields, QStringList({"Egg", "50"}));
+    QVERIFY(Utils::splitCsvRecord("\"Milk, whole\",244,", fields));
+    QCOMPARE(fields, QStringList({"Milk, whole", "244", ""}));
+    QVERIFY(Utils::splitCsvRecord("\"5\"\" pizza\",120", fields));
+    QCOMPARE(fields, QStringList({"5\" pizza", "120"}));
+    // A quoted field running past the line break
+    QVERIFY(!Utils::splitCsvRecord("\"Beans,", fields));
+    QVERIFY(Utils::splitCsvRecord("\"Beans,\nbaked\",130", fields));
+    QCOMPARE(fields, QStringList({"Beans,\nbaked", "130"}));
+  }
+};
+
+QTEST_MAIN(TestStringUtils)
+#include "test_string_utils.moc"